@@ -4,6 +4,7 @@ using System.Diagnostics;
 using System.IO;
 using System.Linq;
 using System.Runtime.InteropServices;
+using OpenTK.Mathematics;
 
 namespace Octopus.Player.Core
 {
@@ -111,6 +112,93 @@ namespace Octopus.Player.Core
             return uint.TryParse(sequencingField, out frameNumber) ? Error.None : Error.BadFrameIndex;
         }
 
+        // Frames whose thumbnails are taken in one native batch, enough to keep every thread busy while bounding the compressed data held at once
+        private const int ThumbnailBatchFrames = 64;
+
+        // Monochrome thumbnails of frameCount lossy frames from firstFrame, for a timeline, written back to back to dataOut.
+        // Each has a 16-bit sample per 8x8 block of its frame, taken from the DC terms of its strips or tiles without decoding them.
+        // Frames that can't be read, or are laid out unlike the first, are left as they are and reported by the returned error.
+        public Error DecodeLossyThumbnails(uint firstFrame, uint frameCount, byte[] dataOut, out Vector2i thumbnailDimensions)
+        {
+            thumbnailDimensions = Vector2i.Zero;
+            var framePathError = GetFramePath(firstFrame, out var firstFramePath);
+            if (framePathError != Error.None)
+                return framePathError;
+
+            // Every frame of the batch shares the strips or tiles of the first
+            int segmentsPerFrame, segmentsAcross;
+            Vector2i segmentDimensions;
+            uint bitDepth;
+            try
+            {
+                using var reader = new IO.DNG.Reader(firstFramePath);
+                if (!reader.Valid || !reader.IsLossy)
+                    return Error.NotImplmeneted;
+                segmentsPerFrame = reader.SegmentCount;
+                segmentsAcross = reader.SegmentsAcross;
+                segmentDimensions = reader.SegmentDimensions;
+                bitDepth = reader.BitDepth;
+            }
+            catch
+            {
+                return Error.BadFile;
+            }
+            thumbnailDimensions = Decoders.Jpeg.LossyThumbnailDimensions(segmentsPerFrame, segmentsAcross, segmentDimensions);
+            var thumbnailSizeBytes = thumbnailDimensions.X * thumbnailDimensions.Y * sizeof(ushort);
+            Debug.Assert(dataOut.Length >= thumbnailSizeBytes * frameCount, "Data output buffer too small");
+
+            var result = Error.None;
+            var segmentOffsets = new ulong[ThumbnailBatchFrames * segmentsPerFrame];
+            var segmentSizes = new uint[ThumbnailBatchFrames * segmentsPerFrame];
+            var compressedData = new byte[1];
+            for (uint batchFrame = 0; batchFrame < frameCount; batchFrame += ThumbnailBatchFrames)
+            {
+                var batchFrameCount = (int)Math.Min(frameCount - batchFrame, (uint)ThumbnailBatchFrames);
+                var compressedSizeBytes = 0;
+                Array.Clear(segmentSizes, 0, segmentSizes.Length);
+                for (int i = 0; i < batchFrameCount; i++)
+                {
+                    var frameError = GetFramePath(firstFrame + batchFrame + (uint)i, out var framePath);
+                    if (frameError == Error.None && !System.IO.File.Exists(framePath))
+                        frameError = Error.FrameNotPresent;
+                    if (frameError == Error.None)
+                    {
+                        try
+                        {
+                            using var reader = new IO.DNG.Reader(framePath);
+                            if (!reader.Valid || reader.SegmentCount != segmentsPerFrame || reader.SegmentDimensions != segmentDimensions)
+                                frameError = Error.BadFrame;
+                            else
+                            {
+                                frameError = reader.ReadCompressedSegments(ref compressedData, ref compressedSizeBytes, segmentOffsets, segmentSizes,
+                                    i * segmentsPerFrame);
+                            }
+                        }
+                        catch
+                        {
+                            frameError = Error.BadFile;
+                        }
+                    }
+
+                    // Frames without data are skipped by the decoder
+                    if (frameError != Error.None)
+                    {
+                        Array.Clear(segmentSizes, i * segmentsPerFrame, segmentsPerFrame);
+                        if (result == Error.None)
+                            result = frameError;
+                    }
+                }
+
+                // The segments of the whole batch are spread across the decoder's thread pool
+                var batchError = Decoders.Jpeg.DecodeLossyThumbnails(compressedData, segmentOffsets, segmentSizes, batchFrameCount * segmentsPerFrame, dataOut,
+                    (int)batchFrame * thumbnailSizeBytes, segmentsPerFrame, segmentsAcross, segmentDimensions, bitDepth);
+                if (result == Error.None)
+                    result = batchError;
+            }
+
+            return result;
+        }
+
         private bool FolderHasDNG(string folder)
         {
             try
@@ -1,4 +1,5 @@
 ﻿using System;
+using System.Diagnostics;
 using System.Runtime.InteropServices;
 using OpenTK.Mathematics;
 
@@ -6,27 +7,290 @@ namespace Octopus.Player.Core.Decoders
 {
 	public static class Jpeg
 	{
+		// Should match C++ 'enum class eLosslessBackend' in 'LosslessJpeg.h'
+		public enum LosslessBackend : uint
+		{
+			Auto,
+			DngSdk,
+			LibJpegTurbo
+		}
+
+		// Persistent native lossless decoder memory, reused by every decode on the owning thread
+		public sealed class LosslessContext : SafeHandle
+		{
+			[ThreadStatic]
+			private static LosslessContext threadContext;
+
+			// Context for the calling thread, created on first use
+			public static LosslessContext ForCurrentThread
+			{
+				get
+				{
+					if (threadContext == null)
+						threadContext = new LosslessContext();
+					return threadContext;
+				}
+			}
+
+			public LosslessContext()
+				: base(IntPtr.Zero, true)
+			{
+				SetHandle(CreateLosslessContext());
+			}
+
+			public override bool IsInvalid { get { return handle == IntPtr.Zero; } }
+
+			protected override bool ReleaseHandle()
+			{
+				DestroyLosslessContext(handle);
+				return true;
+			}
+		}
+
+		// Persistent native lossy decompressor, reused by every decode on the owning thread
+		public sealed class LossyContext : SafeHandle
+		{
+			[ThreadStatic]
+			private static LossyContext threadContext;
+
+			// Context for the calling thread, created on first use
+			public static LossyContext ForCurrentThread
+			{
+				get
+				{
+					if (threadContext == null)
+						threadContext = new LossyContext();
+					return threadContext;
+				}
+			}
+
+			public LossyContext()
+				: base(IntPtr.Zero, true)
+			{
+				SetHandle(CreateLossyContext());
+			}
+
+			public override bool IsInvalid { get { return handle == IntPtr.Zero; } }
+
+			protected override bool ReleaseHandle()
+			{
+				DestroyLossyContext(handle);
+				return true;
+			}
+		}
+
+		// Should match C++ 'struct sJpegInfo' in 'LossyJpeg.h'
+		[StructLayout(LayoutKind.Sequential)]
+		public struct JpegInfo
+		{
+			public uint Width;
+			public uint Height;
+			public uint Components;
+			public uint Precision;
+			private uint lossy;
+
+			// 12 or 16-bit DCT based, as opposed to lossless
+			public bool Lossy { get { return lossy != 0; } }
+		}
+
+		[DllImport("Jpeg")]
+		public static extern uint DecodeLosslessInputPaddingBytes();
+
+		[DllImport("Jpeg")]
+		private static extern IntPtr CreateLosslessContext();
+
+		[DllImport("Jpeg")]
+		private static extern void DestroyLosslessContext(IntPtr context);
+
+		// Forces a lossless backend, overriding the OCTOPUS_LOSSLESS_JPEG_BACKEND environment variable
+		[DllImport("Jpeg")]
+		public static extern void SetLosslessBackend(LosslessBackend backend);
+
+		// Forgets the automatically chosen lossless backends, the first frames of the next clip are timed again
+		[DllImport("Jpeg")]
+		public static extern void ResetLosslessBackendSelection();
+
+		[DllImport("Jpeg")]
+		private static extern Error DecodeLossless(LosslessContext context, IntPtr out16Bit, uint outputStrideBytes, uint originX, uint originY, IntPtr inCompressed,
+			uint compressedSizeBytes, uint width, uint height, uint bitDepth, [In, Out] RawStatistics statistics);
+
+		[DllImport("Jpeg")]
+		private static extern Error DecodeLosslessDraft(LosslessContext context, IntPtr out16Bit, uint outputStrideBytes, uint originX, uint originY, IntPtr inCompressed,
+			uint compressedSizeBytes, uint width, uint height, uint bitDepth);
+
+		[DllImport("Jpeg")]
+		private static extern Error DecodeLosslessTiles(LosslessContext context, IntPtr out16Bit, uint outputStrideBytes, IntPtr inCompressed, ulong[] tileOffsets,
+			uint[] tileSizeBytes, uint tileCount, uint tilesAcross, uint tileWidth, uint tileHeight, uint bitDepth, [MarshalAs(UnmanagedType.U1)] bool draft,
+			[Out] Error[] tileErrors, [In, Out] RawStatistics statistics);
+
+		[DllImport("Jpeg")]
+		private static extern Error DecodeLosslessTilesRegion(LosslessContext context, IntPtr out16Bit, uint outputStrideBytes, IntPtr inCompressed, ulong[] tileOffsets,
+			uint[] tileSizeBytes, uint tileCount, uint tilesAcross, uint tileWidth, uint tileHeight, uint bitDepth, [MarshalAs(UnmanagedType.U1)] bool draft,
+			uint regionX, uint regionY, uint regionWidth, uint regionHeight, [MarshalAs(UnmanagedType.U1)] bool fillOutside, ushort fillValue, [Out] Error[] tileErrors);
+
 		[DllImport("Jpeg")]
-		private static extern Error DecodeLossless(IntPtr out16Bit, IntPtr inCompressed, uint compressedSizeBytes, uint width, uint height, uint bitDepth);
+		private static extern uint LosslessCheckpointIndexSizeBytes(IntPtr inCompressed, uint compressedSizeBytes);
+
+		[DllImport("Jpeg")]
+		private static extern Error DecodeLosslessIndexing(LosslessContext context, IntPtr out16Bit, uint outputStrideBytes, uint originX, uint originY, IntPtr inCompressed,
+			uint compressedSizeBytes, uint width, uint height, uint bitDepth, byte[] index, uint indexSizeBytes, [In, Out] RawStatistics statistics);
+
+		[DllImport("Jpeg")]
+		private static extern Error DecodeLosslessIndexed(LosslessContext context, IntPtr out16Bit, uint outputStrideBytes, uint originX, uint originY, IntPtr inCompressed,
+			uint compressedSizeBytes, uint width, uint height, uint bitDepth, byte[] index, uint indexSizeBytes, [In, Out] RawStatistics statistics);
 
         [DllImport("Jpeg")]
         private static extern bool IsLossy(IntPtr inCompressed, uint compressedSizeBytes);
 
         [DllImport("Jpeg")]
-        private static extern Error DecodeLossy(IntPtr out16Bit, IntPtr inCompressed, uint compressedSizeBytes, uint width, uint height, uint bitDepth);
+        private static extern IntPtr CreateLossyContext();
+
+        [DllImport("Jpeg")]
+        private static extern void DestroyLossyContext(IntPtr context);
+
+        [DllImport("Jpeg")]
+        [return: MarshalAs(UnmanagedType.U1)]
+        private static extern bool ReadJpegInfo(LossyContext context, IntPtr inCompressed, uint compressedSizeBytes, out JpegInfo info);
+
+        [DllImport("Jpeg")]
+        private static extern Error DecodeLossy(LossyContext context, IntPtr out16Bit, uint outputStrideBytes, uint originX, uint originY, IntPtr inCompressed,
+            uint compressedSizeBytes, uint width, uint height, uint bitDepth, [In, Out] RawStatistics statistics, IntPtr info);
+
+        [DllImport("Jpeg")]
+        private static extern Error DecodeLossyDraft(LossyContext context, IntPtr out16Bit, uint outputStrideBytes, uint originX, uint originY, IntPtr inCompressed,
+            uint compressedSizeBytes, uint width, uint height, uint bitDepth);
+
+        [DllImport("Jpeg")]
+        private static extern Error DecodeLossyRegion(LossyContext context, IntPtr out16Bit, uint outputStrideBytes, uint originX, uint originY, IntPtr inCompressed,
+            uint compressedSizeBytes, uint width, uint height, uint bitDepth, uint regionX, uint regionY, uint regionWidth, uint regionHeight);
+
+        [DllImport("Jpeg")]
+        private static extern Error DecodeLossyThumbnails(IntPtr out16Bit, IntPtr inCompressed, ulong[] segmentOffsets, uint[] segmentSizeBytes, uint segmentCount,
+            uint segmentsPerFrame, uint segmentsAcross, uint segmentWidth, uint segmentHeight, uint bitDepth, [Out] Error[] segmentErrors);
+
+        // Decodes an image of the given dimensions to dataOutOrigin of an output image with rows dataOutStrideBytes apart.
+        // The samples are added to statistics, if given, as they are decoded.
+        public static Error DecodeLossless(LosslessContext context, byte[] compressedData, int compressedSizeBytes, int compressedDataOffset, byte[] dataOut,
+            int dataOutStrideBytes, in Vector2i dataOutOrigin, in Vector2i dimensions, uint bitDepth, RawStatistics statistics = null)
+        {
+            unsafe
+            {
+                fixed (byte* pCompressedData = &compressedData[compressedDataOffset], pDataOut = &dataOut[0])
+                {
+                    return DecodeLossless(context, new IntPtr(pDataOut), (uint)dataOutStrideBytes, (uint)dataOutOrigin.X, (uint)dataOutOrigin.Y,
+                        new IntPtr(pCompressedData), (uint)compressedSizeBytes, (uint)dimensions.X, (uint)dimensions.Y, bitDepth, statistics);
+                }
+            }
+        }
+
+        // Decodes a Bayer image of the given dimensions binned to half width and height, dataOutOrigin and dataOutStrideBytes are in the draft image
+        public static Error DecodeLosslessDraft(LosslessContext context, byte[] compressedData, int compressedSizeBytes, int compressedDataOffset, byte[] dataOut,
+            int dataOutStrideBytes, in Vector2i dataOutOrigin, in Vector2i dimensions, uint bitDepth)
+        {
+            unsafe
+            {
+                fixed (byte* pCompressedData = &compressedData[compressedDataOffset], pDataOut = &dataOut[0])
+                {
+                    return DecodeLosslessDraft(context, new IntPtr(pDataOut), (uint)dataOutStrideBytes, (uint)dataOutOrigin.X, (uint)dataOutOrigin.Y,
+                        new IntPtr(pCompressedData), (uint)compressedSizeBytes, (uint)dimensions.X, (uint)dimensions.Y, bitDepth);
+                }
+            }
+        }
 
-        public static Error DecodeLossless(byte[] compressedData, int compressedSizeBytes, int compressedDataOffset, byte[] dataOut, int dataOutOffset,
-            in Vector2i dimensions, uint bitDepth)
+        // Decodes all tiles of a frame in one call, each tile is written to its place in dataOut.
+        // Tiles are ordered left to right then top to bottom, with tilesAcross tiles per row.
+        // With draft set each tile is binned to half width and height, dataOutStrideBytes is then that of the draft image.
+        // Statistics, if given, gather the full resolution samples, draft or not.
+        public static Error DecodeLosslessTiles(LosslessContext context, byte[] compressedData, ulong[] tileOffsets, uint[] tileSizeBytes, byte[] dataOut,
+            int dataOutStrideBytes, int tilesAcross, in Vector2i tileDimensions, uint bitDepth, bool draft = false, Error[] tileErrors = null,
+            RawStatistics statistics = null)
         {
+            Debug.Assert(tileOffsets.Length == tileSizeBytes.Length);
+            Debug.Assert(tileErrors == null || tileErrors.Length >= tileOffsets.Length);
             unsafe
             {
-                fixed (byte* pCompressedData = &compressedData[compressedDataOffset], pDataOut = &dataOut[dataOutOffset])
+                fixed (byte* pCompressedData = &compressedData[0], pDataOut = &dataOut[0])
                 {
-                    return DecodeLossless(new IntPtr(pDataOut), new IntPtr(pCompressedData), (uint)compressedSizeBytes, (uint)dimensions.X, (uint)dimensions.Y, bitDepth);
+                    return DecodeLosslessTiles(context, new IntPtr(pDataOut), (uint)dataOutStrideBytes, new IntPtr(pCompressedData), tileOffsets, tileSizeBytes,
+                        (uint)tileOffsets.Length, (uint)tilesAcross, (uint)tileDimensions.X, (uint)tileDimensions.Y, bitDepth, draft, tileErrors, statistics);
                 }
             }
         }
-        
+
+        // As DecodeLosslessTiles, but only the tiles intersecting region (origin xy, size zw, in full resolution pixels) are decoded.
+        // The other tiles are left untouched, or set to fillValue when one is given. Only the compressed data of decoded tiles is read.
+        public static Error DecodeLosslessTilesRegion(LosslessContext context, byte[] compressedData, ulong[] tileOffsets, uint[] tileSizeBytes, byte[] dataOut,
+            int dataOutStrideBytes, int tilesAcross, in Vector2i tileDimensions, uint bitDepth, in Vector4i region, bool draft = false, ushort? fillValue = null,
+            Error[] tileErrors = null)
+        {
+            Debug.Assert(tileOffsets.Length == tileSizeBytes.Length);
+            Debug.Assert(tileErrors == null || tileErrors.Length >= tileOffsets.Length);
+            unsafe
+            {
+                fixed (byte* pCompressedData = &compressedData[0], pDataOut = &dataOut[0])
+                {
+                    return DecodeLosslessTilesRegion(context, new IntPtr(pDataOut), (uint)dataOutStrideBytes, new IntPtr(pCompressedData), tileOffsets, tileSizeBytes,
+                        (uint)tileOffsets.Length, (uint)tilesAcross, (uint)tileDimensions.X, (uint)tileDimensions.Y, bitDepth, draft, (uint)region.X, (uint)region.Y,
+                        (uint)region.Z, (uint)region.W, fillValue.HasValue, fillValue.GetValueOrDefault(), tileErrors);
+                }
+            }
+        }
+
+        // As DecodeLossless, also returning a checkpoint index of the image for later DecodeLosslessIndexed calls, null if none could be made
+        public static Error DecodeLosslessIndexing(LosslessContext context, byte[] compressedData, int compressedSizeBytes, int compressedDataOffset, byte[] dataOut,
+            int dataOutStrideBytes, in Vector2i dataOutOrigin, in Vector2i dimensions, uint bitDepth, out byte[] index, RawStatistics statistics = null)
+        {
+            index = null;
+            unsafe
+            {
+                fixed (byte* pCompressedData = &compressedData[compressedDataOffset], pDataOut = &dataOut[0])
+                {
+                    var indexSizeBytes = LosslessCheckpointIndexSizeBytes(new IntPtr(pCompressedData), (uint)compressedSizeBytes);
+                    if (indexSizeBytes == 0)
+                    {
+                        return DecodeLossless(context, new IntPtr(pDataOut), (uint)dataOutStrideBytes, (uint)dataOutOrigin.X, (uint)dataOutOrigin.Y,
+                            new IntPtr(pCompressedData), (uint)compressedSizeBytes, (uint)dimensions.X, (uint)dimensions.Y, bitDepth, statistics);
+                    }
+
+                    var newIndex = new byte[indexSizeBytes];
+                    var error = DecodeLosslessIndexing(context, new IntPtr(pDataOut), (uint)dataOutStrideBytes, (uint)dataOutOrigin.X, (uint)dataOutOrigin.Y,
+                        new IntPtr(pCompressedData), (uint)compressedSizeBytes, (uint)dimensions.X, (uint)dimensions.Y, bitDepth, newIndex, indexSizeBytes,
+                        statistics);
+                    if (error == Error.None)
+                        index = newIndex;
+                    return error;
+                }
+            }
+        }
+
+        // As DecodeLossless, decoding bands of rows in parallel from a checkpoint index made by DecodeLosslessIndexing.
+        // An index made from other data is ignored.
+        public static Error DecodeLosslessIndexed(LosslessContext context, byte[] compressedData, int compressedSizeBytes, int compressedDataOffset, byte[] dataOut,
+            int dataOutStrideBytes, in Vector2i dataOutOrigin, in Vector2i dimensions, uint bitDepth, byte[] index, RawStatistics statistics = null)
+        {
+            unsafe
+            {
+                fixed (byte* pCompressedData = &compressedData[compressedDataOffset], pDataOut = &dataOut[0])
+                {
+                    return DecodeLosslessIndexed(context, new IntPtr(pDataOut), (uint)dataOutStrideBytes, (uint)dataOutOrigin.X, (uint)dataOutOrigin.Y,
+                        new IntPtr(pCompressedData), (uint)compressedSizeBytes, (uint)dimensions.X, (uint)dimensions.Y, bitDepth, index, (uint)index.Length,
+                        statistics);
+                }
+            }
+        }
+
+        // Reads the headers of a stream, false if they can't be read
+        public static bool ReadInfo(LossyContext context, byte[] compressedData, int compressedSizeBytes, out JpegInfo info)
+        {
+            unsafe
+            {
+                fixed (byte* pCompressedData = &compressedData[0])
+                {
+                    return ReadJpegInfo(context, new IntPtr(pCompressedData), (uint)compressedSizeBytes, out info);
+                }
+            }
+        }
+
         public static bool IsLossy(byte[] compressedData, int compressedSizeBytes)
         {
             unsafe
@@ -38,14 +302,69 @@ namespace Octopus.Player.Core.Decoders
             }
         }
 
-        public static Error DecodeLossy(byte[] compressedData, int compressedSizeBytes, int compressedDataOffset, byte[] dataOut, int dataOutOffset,
-            in Vector2i dimensions, uint bitDepth)
+        // Decodes an image of the given dimensions to dataOutOrigin of an output image with rows dataOutStrideBytes apart.
+        // The samples are added to statistics, if given, as they are decoded.
+        public static Error DecodeLossy(LossyContext context, byte[] compressedData, int compressedSizeBytes, int compressedDataOffset, byte[] dataOut,
+            int dataOutStrideBytes, in Vector2i dataOutOrigin, in Vector2i dimensions, uint bitDepth, RawStatistics statistics = null)
+        {
+            unsafe
+            {
+                fixed (byte* pCompressedData = &compressedData[compressedDataOffset], pDataOut = &dataOut[0])
+                {
+                    return DecodeLossy(context, new IntPtr(pDataOut), (uint)dataOutStrideBytes, (uint)dataOutOrigin.X, (uint)dataOutOrigin.Y,
+                        new IntPtr(pCompressedData), (uint)compressedSizeBytes, (uint)dimensions.X, (uint)dimensions.Y, bitDepth, statistics, IntPtr.Zero);
+                }
+            }
+        }
+
+        // As DecodeLossy, but only decodes region (origin xy, size zw, in pixels of the image being decoded) and a few columns either side of it
+        public static Error DecodeLossyRegion(LossyContext context, byte[] compressedData, int compressedSizeBytes, int compressedDataOffset, byte[] dataOut,
+            int dataOutStrideBytes, in Vector2i dataOutOrigin, in Vector2i dimensions, uint bitDepth, in Vector4i region)
+        {
+            unsafe
+            {
+                fixed (byte* pCompressedData = &compressedData[compressedDataOffset], pDataOut = &dataOut[0])
+                {
+                    return DecodeLossyRegion(context, new IntPtr(pDataOut), (uint)dataOutStrideBytes, (uint)dataOutOrigin.X, (uint)dataOutOrigin.Y,
+                        new IntPtr(pCompressedData), (uint)compressedSizeBytes, (uint)dimensions.X, (uint)dimensions.Y, bitDepth, (uint)region.X, (uint)region.Y,
+                        (uint)region.Z, (uint)region.W);
+                }
+            }
+        }
+
+        // Decodes a Bayer image of the given dimensions binned to half width and height, dataOutOrigin and dataOutStrideBytes are in the draft image
+        public static Error DecodeLossyDraft(LossyContext context, byte[] compressedData, int compressedSizeBytes, int compressedDataOffset, byte[] dataOut,
+            int dataOutStrideBytes, in Vector2i dataOutOrigin, in Vector2i dimensions, uint bitDepth)
+        {
+            unsafe
+            {
+                fixed (byte* pCompressedData = &compressedData[compressedDataOffset], pDataOut = &dataOut[0])
+                {
+                    return DecodeLossyDraft(context, new IntPtr(pDataOut), (uint)dataOutStrideBytes, (uint)dataOutOrigin.X, (uint)dataOutOrigin.Y,
+                        new IntPtr(pCompressedData), (uint)compressedSizeBytes, (uint)dimensions.X, (uint)dimensions.Y, bitDepth);
+                }
+            }
+        }
+
+        // Dimensions of the thumbnail DecodeLossyThumbnails makes of a frame of segmentsPerFrame strips or tiles, segmentsAcross to a row
+        public static Vector2i LossyThumbnailDimensions(int segmentsPerFrame, int segmentsAcross, in Vector2i segmentDimensions)
+        {
+            return new Vector2i(segmentsAcross * ((segmentDimensions.X + 7) / 8), (segmentsPerFrame / segmentsAcross) * ((segmentDimensions.Y + 7) / 8));
+        }
+
+        // Monochrome thumbnails of a batch of lossy frames from the DC term of every 8x8 block, written back to back from dataOutOffset.
+        // The segmentsPerFrame strips or tiles of each frame follow one another, a frame missing from the batch has segments of size 0.
+        public static Error DecodeLossyThumbnails(byte[] compressedData, ulong[] segmentOffsets, uint[] segmentSizeBytes, int segmentCount, byte[] dataOut,
+            int dataOutOffset, int segmentsPerFrame, int segmentsAcross, in Vector2i segmentDimensions, uint bitDepth, Error[] segmentErrors = null)
         {
+            Debug.Assert(segmentOffsets.Length >= segmentCount && segmentSizeBytes.Length >= segmentCount);
+            Debug.Assert(segmentErrors == null || segmentErrors.Length >= segmentCount);
             unsafe
             {
-                fixed (byte* pCompressedData = &compressedData[compressedDataOffset], pDataOut = &dataOut[dataOutOffset])
+                fixed (byte* pCompressedData = &compressedData[0], pDataOut = &dataOut[dataOutOffset])
                 {
-                    return DecodeLossy(new IntPtr(pDataOut), new IntPtr(pCompressedData), (uint)compressedSizeBytes, (uint)dimensions.X, (uint)dimensions.Y, bitDepth);
+                    return DecodeLossyThumbnails(new IntPtr(pDataOut), new IntPtr(pCompressedData), segmentOffsets, segmentSizeBytes, (uint)segmentCount,
+                        (uint)segmentsPerFrame, (uint)segmentsAcross, (uint)segmentDimensions.X, (uint)segmentDimensions.Y, bitDepth, segmentErrors);
                 }
             }
         }
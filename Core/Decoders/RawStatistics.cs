@@ -0,0 +1,97 @@
+﻿using System;
+using System.Runtime.InteropServices;
+
+namespace Octopus.Player.Core.Decoders
+{
+	// Statistics of the raw samples of a frame, gathered by the native decoders as they write the samples.
+	// Channels are the four positions of a 2x2 CFA quad, channel (y & 1) * 2 + (x & 1) of the full resolution frame.
+	// Passed to the decoders by reference, null gathers nothing. Decodes add to the statistics, Reset them before each frame.
+	[StructLayout(LayoutKind.Sequential)]
+	public sealed class RawStatistics
+	{
+		public const int Channels = 4;
+		public const int Bins = 64;
+
+		// Should match C++ 'struct sRawStatistics' in 'RawStatistics.h'
+		[StructLayout(LayoutKind.Sequential)]
+		private unsafe struct Values
+		{
+			public uint whiteLevel;
+			public uint histogramShift;
+			public fixed ushort minimum[Channels];
+			public fixed ushort maximum[Channels];
+			public fixed ulong samples[Channels];
+			public fixed ulong clipped[Channels];
+			public fixed uint histogram[Channels * Bins];
+		}
+
+		private Values values;
+
+		public RawStatistics(uint whiteLevel, uint bitDepth)
+		{
+			Reset(whiteLevel, bitDepth);
+		}
+
+		// Empty statistics with the white level and histogram bins of other, to gather part of a frame on its own thread and Merge later
+		public RawStatistics(RawStatistics other)
+		{
+			Reset(other.values.whiteLevel, 0);
+			values.histogramShift = other.values.histogramShift;
+		}
+
+		public uint WhiteLevel { get { return values.whiteLevel; } }
+
+		// Histogram bin i counts samples from i << HistogramShift, the last bin also counts everything above it
+		public int HistogramShift { get { return (int)values.histogramShift; } }
+
+		public unsafe ushort Minimum(int channel) { return values.minimum[channel]; }
+		public unsafe ushort Maximum(int channel) { return values.maximum[channel]; }
+		public unsafe ulong Samples(int channel) { return values.samples[channel]; }
+
+		// Samples at or above the white level
+		public unsafe ulong Clipped(int channel) { return values.clipped[channel]; }
+
+		public unsafe uint Histogram(int channel, int bin) { return values.histogram[channel * Bins + bin]; }
+
+		public float ClippedFraction(int channel)
+		{
+			var samples = Samples(channel);
+			return samples > 0 ? (float)Clipped(channel) / samples : 0.0f;
+		}
+
+		// Empties the statistics, keeping the white level and histogram bins
+		public unsafe void Clear()
+		{
+			for (int channel = 0; channel < Channels; channel++)
+			{
+				values.minimum[channel] = ushort.MaxValue;
+				values.maximum[channel] = 0;
+				values.samples[channel] = 0;
+				values.clipped[channel] = 0;
+			}
+			for (int i = 0; i < Channels * Bins; i++)
+				values.histogram[i] = 0;
+		}
+
+		// Empties the statistics of a frame with the given white level, the histogram spanning the range of bitDepth samples
+		public void Reset(uint whiteLevel, uint bitDepth)
+		{
+			values.whiteLevel = whiteLevel;
+			values.histogramShift = bitDepth > 6 ? bitDepth - 6 : 0;
+			Clear();
+		}
+
+		public unsafe void Merge(RawStatistics other)
+		{
+			for (int channel = 0; channel < Channels; channel++)
+			{
+				values.minimum[channel] = Math.Min(values.minimum[channel], other.values.minimum[channel]);
+				values.maximum[channel] = Math.Max(values.maximum[channel], other.values.maximum[channel]);
+				values.samples[channel] += other.values.samples[channel];
+				values.clipped[channel] += other.values.clipped[channel];
+			}
+			for (int i = 0; i < Channels * Bins; i++)
+				values.histogram[i] += other.values.histogram[i];
+		}
+	}
+}
@@ -16,6 +16,43 @@ namespace Octopus.Player.Core.Decoders
 
 		[DllImport("Unpack")]
 		public static extern void Unpack14to16Bit(IntPtr out16Bit, IntPtr in14Bit, uint sizeBytes);
+
+		// As the above, adding the samples to statistics as they are unpacked. The samples are those of a width wide frame,
+		// the first being sample firstSample of the frame counting row by row.
+		[DllImport("Unpack")]
+		public static extern void Unpack10to16BitStatistics(IntPtr out16Bit, IntPtr in10Bit, uint sizeBytes, uint width, ulong firstSample,
+			[In, Out] RawStatistics statistics);
+
+		[DllImport("Unpack")]
+		public static extern void Unpack12to16BitStatistics(IntPtr out16Bit, IntPtr in12Bit, uint sizeBytes, uint width, ulong firstSample,
+			[In, Out] RawStatistics statistics);
+
+		[DllImport("Unpack")]
+		public static extern void Unpack14to16BitStatistics(IntPtr out16Bit, IntPtr in14Bit, uint sizeBytes, uint width, ulong firstSample,
+			[In, Out] RawStatistics statistics);
+
+		// Statistics of samples that need no unpacking
+		[DllImport("Unpack")]
+		public static extern void RawStatistics8Bit(IntPtr in8Bit, uint sizeBytes, uint width, ulong firstSample, [In, Out] RawStatistics statistics);
+
+		[DllImport("Unpack")]
+		public static extern void RawStatistics16Bit(IntPtr in16Bit, uint sizeBytes, uint width, ulong firstSample, [In, Out] RawStatistics statistics);
+
+		// Draft unpacking bins whole frames of width x height samples to a half width, half height Bayer mosaic
+		[DllImport("Unpack")]
+		public static extern void Unpack8to8BitDraft(IntPtr out8Bit, uint outputStrideBytes, IntPtr in8Bit, uint width, uint height);
+
+		[DllImport("Unpack")]
+		public static extern void Unpack10to16BitDraft(IntPtr out16Bit, uint outputStrideBytes, IntPtr in10Bit, uint width, uint height);
+
+		[DllImport("Unpack")]
+		public static extern void Unpack12to16BitDraft(IntPtr out16Bit, uint outputStrideBytes, IntPtr in12Bit, uint width, uint height);
+
+		[DllImport("Unpack")]
+		public static extern void Unpack14to16BitDraft(IntPtr out16Bit, uint outputStrideBytes, IntPtr in14Bit, uint width, uint height);
+
+		[DllImport("Unpack")]
+		public static extern void Unpack16to16BitDraft(IntPtr out16Bit, uint outputStrideBytes, IntPtr in16Bit, uint width, uint height);
 	}
 }
 
@@ -101,13 +101,41 @@ namespace Octopus.Player.Core.IO.DNG
             }
         }
 
-        public Error DecodeImageData(byte[] dataOut, bool isLossy)
+        // With draft set the image is binned to a half width, half height Bayer mosaic of DraftDimensions.
+        // With a region (origin xy, size zw, in padded image pixels) only the strips and tiles overlapping it are decoded,
+        // DecodedRegion is then the part of dataOut that was written.
+        public Error DecodeImageData(byte[] dataOut, bool isLossy, bool draft = false, Vector4i? region = null)
         {
-            CachedIsTiled = false;
             Valid = false;
+            DecodedRegion = null;
+            Statistics = (RawStatisticsEnabled && !draft && !region.HasValue) ? new RawStatistics(WhiteLevel, BitDepth) : null;
 
             // Get offsets to the strip/tile data
-            TiffValueCollection<ulong> offsets, byteCounts;
+            if (!ReadSegmentOffsets(out var offsets, out var byteCounts))
+                return Error.BadImageData;
+            Valid = true;
+
+            if (region.HasValue)
+                DecodedRegion = SegmentBounds(region.Value, offsets.Count);
+
+            if (draft)
+                return DecodeDraftImageData(ref offsets, ref byteCounts, dataOut, isLossy, region);
+
+            switch (Compression)
+            {
+                case Compression.Jpeg:
+                    return DecodeCompressedImageDataMulticore(ref offsets, ref byteCounts, dataOut, isLossy, region);
+                case Compression.None:
+                    return DecodeUncompressedImageData(ref offsets, ref byteCounts, dataOut, region);
+                default:
+                    return Error.NotImplmeneted;
+            }
+        }
+
+        // Offsets and sizes of the strips or tiles of the image data, false if there are none
+        private bool ReadSegmentOffsets(out TiffValueCollection<ulong> offsets, out TiffValueCollection<ulong> byteCounts)
+        {
+            CachedIsTiled = false;
             if (ImageDataIfd.Contains(TiffTag.TileOffsets))
             {
                 CachedIsTiled = true;
@@ -122,23 +150,72 @@ namespace Octopus.Player.Core.IO.DNG
                 CachedStripCount = (uint)offsets.Count;
             }
             else
+            {
+                offsets = byteCounts = default;
+                return false;
+            }
+            return offsets.Count == byteCounts.Count;
+        }
+
+        // Reads the compressed strips or tiles of the frame back to back from compressedSizeBytes into compressedData, growing it when they don't fit,
+        // for a batch of frames given to Jpeg.DecodeLossyThumbnails. Their offsets and sizes are written from firstSegment of segmentOffsets and segmentSizes.
+        public Error ReadCompressedSegments(ref byte[] compressedData, ref int compressedSizeBytes, ulong[] segmentOffsets, uint[] segmentSizes, int firstSegment)
+        {
+            if (Compression != Compression.Jpeg)
+                return Error.NotImplmeneted;
+            if (!ReadSegmentOffsets(out var offsets, out var byteCounts) || firstSegment + offsets.Count > segmentOffsets.Length)
                 return Error.BadImageData;
-            if (offsets.Count != byteCounts.Count)
+
+            long totalByteCount = compressedSizeBytes;
+            foreach (var count in byteCounts)
+                totalByteCount += (long)count;
+            if (totalByteCount > int.MaxValue)
                 return Error.BadImageData;
-            Valid = true;
-            
+            if (totalByteCount > compressedData.Length)
+                Array.Resize(ref compressedData, (int)Math.Min(Math.Max(totalByteCount, 2L * compressedData.Length), int.MaxValue));
+
+            try
+            {
+                using var contentReader = Tiff.CreateContentReader();
+                for (int i = 0; i < offsets.Count; i++)
+                {
+                    var byteCount = (int)byteCounts[i];
+                    contentReader.Read((long)offsets[i], compressedData.AsMemory(compressedSizeBytes, byteCount));
+                    segmentOffsets[firstSegment + i] = (ulong)compressedSizeBytes;
+                    segmentSizes[firstSegment + i] = (uint)byteCount;
+                    compressedSizeBytes += byteCount;
+                }
+            }
+            catch
+            {
+                return Error.BadImageData;
+            }
+            return Error.None;
+        }
+
+        private Error DecodeDraftImageData(ref TiffValueCollection<ulong> offsets, ref TiffValueCollection<ulong> byteCounts, byte[] dataOut, bool isLossy,
+            Vector4i? region)
+        {
+            // Binning works on whole 2x2 CFA quads
+            if (PhotometricInterpretation != PhotometricInterpretation.ColorFilterArray || CFARepeatPatternDimensions != new Vector2i(2, 2))
+                return Error.NotImplmeneted;
+
             switch (Compression)
             {
                 case Compression.Jpeg:
-                    return DecodeCompressedImageDataMulticore(ref offsets, ref byteCounts, dataOut, isLossy);
+                    return isLossy ? DecodeCompressedImageDataMulticore(ref offsets, ref byteCounts, dataOut, true, region, true)
+                        : DecodeLosslessImageDataMulticore(ref offsets, ref byteCounts, dataOut, region, true);
                 case Compression.None:
-                    return DecodeUncompressedImageData(ref offsets, ref byteCounts, dataOut);
+                    // Uncompressed drafts bin the whole frame in one pass
+                    DecodedRegion = null;
+                    return IsTiled ? Error.NotImplmeneted : DecodeUncompressedDraftImageData(ref offsets, ref byteCounts, dataOut);
                 default:
                     return Error.NotImplmeneted;
             }
         }
 
-        private Error DecodeUncompressedImageData(ref TiffValueCollection<ulong> offsets, ref TiffValueCollection<ulong> byteCounts, byte[] dataOut)
+        private Error DecodeUncompressedImageData(ref TiffValueCollection<ulong> offsets, ref TiffValueCollection<ulong> byteCounts, byte[] dataOut,
+            Vector4i? region = null)
         {
             using var contentReader = Tiff.CreateContentReader();
             var offsetsCount = offsets.Count;
@@ -156,9 +233,16 @@ namespace Octopus.Player.Core.IO.DNG
                     {
                         var expectedRemainingData = expectedDataSize - dataOutOffset;
                         var segmentSizeBytes = Math.Min((int)byteCounts[i], (int)expectedRemainingData);
+                        if (!SegmentInRegion(i, region))
+                        {
+                            dataOutOffset += segmentSizeBytes;
+                            continue;
+                        }
                         try
                         {
                             contentReader.Read((long)offsets[i], dataOut.AsMemory(dataOutOffset, segmentSizeBytes));
+                            if (Statistics != null)
+                                GatherStatistics(dataOut, dataOutOffset, segmentSizeBytes);
                             dataOutOffset += segmentSizeBytes;
                         }
                         catch
@@ -178,6 +262,12 @@ namespace Octopus.Player.Core.IO.DNG
                     {
                         var expectedRemainingData = expectedDataSize - packedDataOffset;
                         var segmentSizeBytes = Math.Min((int)expectedRemainingData, (int)byteCounts[i]);
+                        if (!SegmentInRegion(i, region))
+                        {
+                            packedDataOffset += segmentSizeBytes;
+                            dataOutOffset += (segmentSizeBytes * (int)DecodedBitDepth) / (int)BitDepth;
+                            continue;
+                        }
                         byte[] packedData = System.Buffers.ArrayPool<byte>.Shared.Rent(segmentSizeBytes + inputOffset);
                         try
                         {
@@ -186,16 +276,27 @@ namespace Octopus.Player.Core.IO.DNG
                             {
                                 fixed(byte* pDataOut = &dataOut[dataOutOffset], pPackedData = &packedData[inputOffset])
                                 {
+                                    var width = (uint)PaddedDimensions.X;
+                                    var firstSample = (ulong)dataOutOffset / 2;
                                     switch (BitDepth)
                                     {
                                         case 10:
-                                            Unpack.Unpack10to16Bit(new IntPtr(pDataOut), new IntPtr(pPackedData), (uint)segmentSizeBytes);
+                                            if (Statistics != null)
+                                                Unpack.Unpack10to16BitStatistics(new IntPtr(pDataOut), new IntPtr(pPackedData), (uint)segmentSizeBytes, width, firstSample, Statistics);
+                                            else
+                                                Unpack.Unpack10to16Bit(new IntPtr(pDataOut), new IntPtr(pPackedData), (uint)segmentSizeBytes);
                                             break;
                                         case 12:
-                                            Unpack.Unpack12to16Bit(new IntPtr(pDataOut), new IntPtr(pPackedData), (uint)segmentSizeBytes);
+                                            if (Statistics != null)
+                                                Unpack.Unpack12to16BitStatistics(new IntPtr(pDataOut), new IntPtr(pPackedData), (uint)segmentSizeBytes, width, firstSample, Statistics);
+                                            else
+                                                Unpack.Unpack12to16Bit(new IntPtr(pDataOut), new IntPtr(pPackedData), (uint)segmentSizeBytes);
                                             break;
                                         case 14:
-                                            Unpack.Unpack14to16Bit(new IntPtr(pDataOut), new IntPtr(pPackedData), (uint)segmentSizeBytes);
+                                            if (Statistics != null)
+                                                Unpack.Unpack14to16BitStatistics(new IntPtr(pDataOut), new IntPtr(pPackedData), (uint)segmentSizeBytes, width, firstSample, Statistics);
+                                            else
+                                                Unpack.Unpack14to16Bit(new IntPtr(pDataOut), new IntPtr(pPackedData), (uint)segmentSizeBytes);
                                             break;
                                     }
                                 }
@@ -224,43 +325,142 @@ namespace Octopus.Player.Core.IO.DNG
             return Error.None;
         }
 
-        private Error DecodeCompressedImageDataMulticore(ref TiffValueCollection<ulong> offsets, ref TiffValueCollection<ulong> byteCounts, byte[] dataOut, bool isLossy)
+        private Error DecodeUncompressedDraftImageData(ref TiffValueCollection<ulong> offsets, ref TiffValueCollection<ulong> byteCounts, byte[] dataOut)
+        {
+            using var contentReader = Tiff.CreateContentReader();
+            var expectedDataSize = (PaddedDimensions.Area() * (int)BitDepth) / 8;
+            var expectedDataOutSize = (DraftDimensions.Area() * (int)DecodedBitDepth) / 8;
+            Debug.Assert(dataOut.Length >= expectedDataOutSize, "Data output buffer too small");
+
+            // Strips are whole rows, so read them back to back and bin the frame in one pass
+            var inputOffset = BitDepth == 12 ? (int)Unpack.Unpack12InputOffsetBytes() : 0;
+            byte[] packedData = System.Buffers.ArrayPool<byte>.Shared.Rent(expectedDataSize + inputOffset);
+            try
+            {
+                var packedDataOffset = 0;
+                for (int i = 0; i < offsets.Count && packedDataOffset < expectedDataSize; i++)
+                {
+                    var segmentSizeBytes = Math.Min((int)byteCounts[i], expectedDataSize - packedDataOffset);
+                    contentReader.Read((long)offsets[i], packedData.AsMemory(inputOffset + packedDataOffset, segmentSizeBytes));
+                    packedDataOffset += segmentSizeBytes;
+                }
+                if (packedDataOffset != expectedDataSize)
+                    return Error.BadImageData;
+
+                unsafe
+                {
+                    fixed (byte* pDataOut = &dataOut[0], pPackedData = &packedData[inputOffset])
+                    {
+                        var pOut = new IntPtr(pDataOut);
+                        var pIn = new IntPtr(pPackedData);
+                        var strideBytes = (uint)DraftStrideBytes;
+                        var width = (uint)PaddedDimensions.X;
+                        var height = (uint)PaddedDimensions.Y;
+                        switch (BitDepth)
+                        {
+                            case 8:
+                                Unpack.Unpack8to8BitDraft(pOut, strideBytes, pIn, width, height);
+                                break;
+                            case 10:
+                                Unpack.Unpack10to16BitDraft(pOut, strideBytes, pIn, width, height);
+                                break;
+                            case 12:
+                                Unpack.Unpack12to16BitDraft(pOut, strideBytes, pIn, width, height);
+                                break;
+                            case 14:
+                                Unpack.Unpack14to16BitDraft(pOut, strideBytes, pIn, width, height);
+                                break;
+                            case 16:
+                                Unpack.Unpack16to16BitDraft(pOut, strideBytes, pIn, width, height);
+                                break;
+                            default:
+                                return Error.NotImplmeneted;
+                        }
+                    }
+                }
+            }
+            catch
+            {
+                return Error.BadImageData;
+            }
+            finally
+            {
+                System.Buffers.ArrayPool<byte>.Shared.Return(packedData);
+            }
+
+            return Error.None;
+        }
+
+        // Lossy drafts are binned to the half width, half height Bayer mosaic of DraftDimensions as they are decoded
+        private Error DecodeCompressedImageDataMulticore(ref TiffValueCollection<ulong> offsets, ref TiffValueCollection<ulong> byteCounts, byte[] dataOut, bool isLossy,
+            Vector4i? region = null, bool draft = false)
         {
+            // Lossy strips and tiles are cropped to the region, so only the region itself is known to be written
+            if (isLossy && !draft && region.HasValue)
+            {
+                var min = Vector2i.ComponentMax(region.Value.Xy, Vector2i.Zero);
+                var max = Vector2i.ComponentMin(region.Value.Xy + region.Value.Zw, PaddedDimensions);
+                DecodedRegion = max.X > min.X && max.Y > min.Y ? new Vector4i(min, max - min) : new Vector4i(0, 0, 0, 0);
+            }
+
             // Use single threaded version if there is only one segment
             if (offsets.Count <= 1)
-                return DecodeCompressedImageData(ref offsets, ref byteCounts, dataOut, isLossy);
+                return DecodeCompressedImageData(ref offsets, ref byteCounts, dataOut, isLossy, draft, region);
+
+            // Lossless frames are decoded in a single native call, which spreads the tiles over its own threads
+            if (!isLossy)
+                return DecodeLosslessImageDataMulticore(ref offsets, ref byteCounts, dataOut, region);
 
             using var contentReader = Tiff.CreateContentReader();
-            var expectedDataOutSize = (PaddedDimensions.Area() * DecodedBitDepth) / 8;
+            var expectedDataOutSize = ((draft ? DraftDimensions : PaddedDimensions).Area() * DecodedBitDepth) / 8;
             Debug.Assert(dataOut.Length >= expectedDataOutSize, "Data output buffer too small");
 
             // Reserve temporary memory for all segments to run concurrently
+            // Each segment is followed by zeroed padding for the lossless decoder's bit reader
+            var paddingBytes = (int)Jpeg.DecodeLosslessInputPaddingBytes();
             int totalCompressedDataSize = 0;
             foreach (var count in byteCounts)
-                totalCompressedDataSize += (int)count;
+                totalCompressedDataSize += (int)count + paddingBytes;
             byte[] compressedData = System.Buffers.ArrayPool<byte>.Shared.Rent(totalCompressedDataSize);
 
-            // Read and decode each segment as a new task
+            // Read and decode each segment as a new task, each gathering its own statistics
             Error lastError = Error.None;
-            Task[] tasks = new Task[offsets.Count];
+            var tasks = new List<Task>(offsets.Count);
+            var segmentStatistics = new List<RawStatistics>(offsets.Count);
             int taskMemoryOffset = 0;
-            for (int i = 0; i < tasks.Length; i++)
+            for (int i = 0; i < offsets.Count; i++)
             {
+                if (!SegmentInRegion(i, region))
+                    continue;
                 var segmentIndex = i;
                 var offset = (long)offsets[segmentIndex];
                 int byteCount = (int)byteCounts[segmentIndex];
                 var taskMemoryStart = taskMemoryOffset;
-                taskMemoryOffset += byteCount;
-                tasks[i] = Task.Factory.StartNew((Object obj) =>
+                taskMemoryOffset += byteCount + paddingBytes;
+                var statistics = Statistics != null ? new RawStatistics(Statistics) : null;
+                if (statistics != null)
+                    segmentStatistics.Add(statistics);
+                tasks.Add(Task.Factory.StartNew((Object obj) =>
                 {
                     try
                     {
                         contentReader.Read(offset, compressedData.AsMemory(taskMemoryStart, byteCount));
-                        var segmentDimensions = IsTiled ? TileDimensions : (PaddedDimensions / new Vector2i(1, (int)StripCount));
-                        var dataOutOffset = ((segmentDimensions.Area() * (int)DecodedBitDepth) / 8) * segmentIndex;
+                        Array.Clear(compressedData, taskMemoryStart + byteCount, paddingBytes);
+                        var segmentDimensions = SegmentDimensions;
+                        var segmentOrigin = SegmentOrigin(segmentIndex, segmentDimensions);
 
-                        var decodeError = isLossy ? Jpeg.DecodeLossy(compressedData, byteCount, taskMemoryStart, dataOut, dataOutOffset, segmentDimensions, BitDepth)
-                            : Jpeg.DecodeLossless(compressedData, byteCount, taskMemoryStart, dataOut, dataOutOffset, segmentDimensions, BitDepth);
+                        Error decodeError;
+                        if (draft)
+                        {
+                            decodeError = Jpeg.DecodeLossyDraft(Jpeg.LossyContext.ForCurrentThread, compressedData, byteCount, taskMemoryStart, dataOut, DraftStrideBytes,
+                                segmentOrigin / 2, segmentDimensions, BitDepth);
+                        }
+                        else
+                        {
+                            decodeError = isLossy ? DecodeLossySegment(compressedData, byteCount, taskMemoryStart, dataOut, segmentOrigin, segmentDimensions, region, statistics)
+                                : Jpeg.DecodeLossless(Jpeg.LosslessContext.ForCurrentThread, compressedData, byteCount, taskMemoryStart, dataOut, DecodedStrideBytes,
+                                    segmentOrigin, segmentDimensions, BitDepth, statistics);
+                        }
 
                         if (decodeError != Error.None)
                             lastError = decodeError;
@@ -269,32 +469,146 @@ namespace Octopus.Player.Core.IO.DNG
                     {
                         lastError = Error.BadImageData;
                     }
-                }, segmentIndex);
+                }, segmentIndex));
             }
 
             // Wait for all tasks
-            Task.WaitAll(tasks);
+            Task.WaitAll(tasks.ToArray());
             foreach (var task in tasks)
                 task.Dispose();
+            foreach (var statistics in segmentStatistics)
+                Statistics.Merge(statistics);
 
             // Done with temporary data
             System.Buffers.ArrayPool<byte>.Shared.Return(compressedData);
             return lastError;
         }
 
-        private Error DecodeCompressedImageData(ref TiffValueCollection<ulong> offsets, ref TiffValueCollection<ulong> byteCounts, byte[] dataOut, bool isLossy)
+        private Error DecodeLosslessImageDataMulticore(ref TiffValueCollection<ulong> offsets, ref TiffValueCollection<ulong> byteCounts, byte[] dataOut,
+            Vector4i? region = null, bool draft = false)
+        {
+            using var contentReader = Tiff.CreateContentReader();
+            var expectedDataOutSize = ((draft ? DraftDimensions : PaddedDimensions).Area() * DecodedBitDepth) / 8;
+            Debug.Assert(dataOut.Length >= expectedDataOutSize, "Data output buffer too small");
+
+            // Lay out every segment back to back, each followed by zeroed padding for the decoder's bit reader
+            var paddingBytes = (int)Jpeg.DecodeLosslessInputPaddingBytes();
+            var segmentOffsets = new ulong[offsets.Count];
+            var segmentSizes = new uint[offsets.Count];
+            int totalCompressedDataSize = 0;
+            for (int i = 0; i < offsets.Count; i++)
+            {
+                segmentOffsets[i] = (ulong)totalCompressedDataSize;
+                segmentSizes[i] = (uint)byteCounts[i];
+                totalCompressedDataSize += (int)byteCounts[i] + paddingBytes;
+            }
+            byte[] compressedData = System.Buffers.ArrayPool<byte>.Shared.Rent(totalCompressedDataSize);
+
+            try
+            {
+                for (int i = 0; i < offsets.Count; i++)
+                {
+                    if (!SegmentInRegion(i, region))
+                        continue;
+                    contentReader.Read((long)offsets[i], compressedData.AsMemory((int)segmentOffsets[i], (int)segmentSizes[i]));
+                    Array.Clear(compressedData, (int)segmentOffsets[i] + (int)segmentSizes[i], paddingBytes);
+                }
+
+                var segmentDimensions = SegmentDimensions;
+                Debug.Assert(draft || (segmentDimensions.Area() * (int)DecodedBitDepth) / 8 * offsets.Count == expectedDataOutSize);
+                if (region.HasValue)
+                {
+                    return Jpeg.DecodeLosslessTilesRegion(Jpeg.LosslessContext.ForCurrentThread, compressedData, segmentOffsets, segmentSizes, dataOut,
+                        draft ? DraftStrideBytes : DecodedStrideBytes, PaddedDimensions.X / segmentDimensions.X, segmentDimensions, BitDepth, region.Value, draft);
+                }
+                return Jpeg.DecodeLosslessTiles(Jpeg.LosslessContext.ForCurrentThread, compressedData, segmentOffsets, segmentSizes, dataOut,
+                    draft ? DraftStrideBytes : DecodedStrideBytes, PaddedDimensions.X / segmentDimensions.X, segmentDimensions, BitDepth, draft, null, Statistics);
+            }
+            catch
+            {
+                return Error.BadImageData;
+            }
+            finally
+            {
+                System.Buffers.ArrayPool<byte>.Shared.Return(compressedData);
+            }
+        }
+
+        // Decodes a lossy strip or tile, only the part of it inside region when one is given
+        private Error DecodeLossySegment(byte[] compressedData, int byteCount, int compressedDataOffset, byte[] dataOut, in Vector2i segmentOrigin,
+            in Vector2i segmentDimensions, Vector4i? region, RawStatistics statistics)
+        {
+            if (region.HasValue)
+            {
+                var min = Vector2i.ComponentMax(region.Value.Xy, segmentOrigin);
+                var max = Vector2i.ComponentMin(region.Value.Xy + region.Value.Zw, segmentOrigin + segmentDimensions);
+                if (max.X <= min.X || max.Y <= min.Y)
+                    return Error.None;
+                if (min != segmentOrigin || max != segmentOrigin + segmentDimensions)
+                {
+                    return Jpeg.DecodeLossyRegion(Jpeg.LossyContext.ForCurrentThread, compressedData, byteCount, compressedDataOffset, dataOut, DecodedStrideBytes,
+                        segmentOrigin, segmentDimensions, BitDepth, new Vector4i(min - segmentOrigin, max - min));
+                }
+            }
+            return Jpeg.DecodeLossy(Jpeg.LossyContext.ForCurrentThread, compressedData, byteCount, compressedDataOffset, dataOut, DecodedStrideBytes, segmentOrigin,
+                segmentDimensions, BitDepth, statistics);
+        }
+
+        // Decodes a single strip lossless frame from its checkpoint index, or makes the index if the frame doesn't have one yet
+        private Error DecodeLosslessIndexed(byte[] compressedData, int byteCount, byte[] dataOut, in Vector2i segmentOrigin, in Vector2i segmentDimensions)
+        {
+            var indexPath = CheckpointIndexPath;
+            byte[] index = null;
+            try
+            {
+                if (File.Exists(indexPath))
+                    index = File.ReadAllBytes(indexPath);
+            }
+            catch
+            {
+                index = null;
+            }
+
+            if (index != null)
+            {
+                return Jpeg.DecodeLosslessIndexed(Jpeg.LosslessContext.ForCurrentThread, compressedData, byteCount, 0, dataOut, DecodedStrideBytes, segmentOrigin,
+                    segmentDimensions, BitDepth, index, Statistics);
+            }
+
+            var decodeError = Jpeg.DecodeLosslessIndexing(Jpeg.LosslessContext.ForCurrentThread, compressedData, byteCount, 0, dataOut, DecodedStrideBytes,
+                segmentOrigin, segmentDimensions, BitDepth, out index, Statistics);
+            if (decodeError == Error.None && index != null)
+            {
+                try
+                {
+                    Directory.CreateDirectory(Path.GetDirectoryName(indexPath));
+                    File.WriteAllBytes(indexPath, index);
+                }
+                catch
+                {
+                    // Read only media, the frame is decoded without an index
+                }
+            }
+            return decodeError;
+        }
+
+        // Only lossy frames are decoded as drafts or regions here, lossless drafts go through DecodeLosslessImageDataMulticore
+        private Error DecodeCompressedImageData(ref TiffValueCollection<ulong> offsets, ref TiffValueCollection<ulong> byteCounts, byte[] dataOut, bool isLossy,
+            bool draft = false, Vector4i? region = null)
         {
+            Debug.Assert(!draft || isLossy);
             using var contentReader = Tiff.CreateContentReader();
             var offsetsCount = offsets.Count;
-            var expectedDataOutSize = (PaddedDimensions.Area() * DecodedBitDepth) / 8;
+            var expectedDataOutSize = ((draft ? DraftDimensions : PaddedDimensions).Area() * DecodedBitDepth) / 8;
             Debug.Assert(dataOut.Length >= expectedDataOutSize, "Data output buffer too small");
             int dataOutOffset = 0;
 
-            // Reserve temporary memory large enough for largest segment
+            // Reserve temporary memory large enough for largest segment plus the lossless decoder's zeroed padding
+            var paddingBytes = (int)Jpeg.DecodeLosslessInputPaddingBytes();
             int largestByteCount = 0;
             foreach (var count in byteCounts)
                 largestByteCount = Math.Max(largestByteCount, (int)count);
-            byte[] compressedData = System.Buffers.ArrayPool<byte>.Shared.Rent(largestByteCount);
+            byte[] compressedData = System.Buffers.ArrayPool<byte>.Shared.Rent(largestByteCount + paddingBytes);
 
             // Read and decode each segment
             try
@@ -304,12 +618,28 @@ namespace Octopus.Player.Core.IO.DNG
                     var offset = (long)offsets[i];
                     int byteCount = (int)byteCounts[i];
                     contentReader.Read(offset, compressedData.AsMemory(0, byteCount));
-                    var segmentDimensions = IsTiled ? TileDimensions : (PaddedDimensions / new Vector2i(1, (int)StripCount));
+                    Array.Clear(compressedData, byteCount, paddingBytes);
+                    var segmentDimensions = SegmentDimensions;
 
-                    var decodeError = isLossy ? Jpeg.DecodeLossy(compressedData, byteCount, 0, dataOut, dataOutOffset, segmentDimensions, BitDepth)
-                            : Jpeg.DecodeLossless(compressedData, byteCount, 0, dataOut, dataOutOffset, segmentDimensions, BitDepth);
+                    var segmentOrigin = SegmentOrigin(i, segmentDimensions);
+
+                    Error decodeError;
+                    if (draft)
+                    {
+                        decodeError = Jpeg.DecodeLossyDraft(Jpeg.LossyContext.ForCurrentThread, compressedData, byteCount, 0, dataOut, DraftStrideBytes, segmentOrigin / 2,
+                            segmentDimensions, BitDepth);
+                    }
+                    else if (isLossy)
+                        decodeError = DecodeLossySegment(compressedData, byteCount, 0, dataOut, segmentOrigin, segmentDimensions, region, Statistics);
+                    else if (CheckpointIndex && offsetsCount == 1)
+                        decodeError = DecodeLosslessIndexed(compressedData, byteCount, dataOut, segmentOrigin, segmentDimensions);
+                    else
+                    {
+                        decodeError = Jpeg.DecodeLossless(Jpeg.LosslessContext.ForCurrentThread, compressedData, byteCount, 0, dataOut, DecodedStrideBytes,
+                            segmentOrigin, segmentDimensions, BitDepth, Statistics);
+                    }
 
-                    dataOutOffset += (segmentDimensions.Area() * (int)DecodedBitDepth) / 8;
+                    dataOutOffset += ((draft ? segmentDimensions / 2 : segmentDimensions).Area() * (int)DecodedBitDepth) / 8;
                     if (decodeError != Error.None)
                         return decodeError;
                 }
@@ -330,6 +660,92 @@ namespace Octopus.Player.Core.IO.DNG
             return Error.None;
         }
 
+        // Bytes between rows of the decoded image, compressed strips and tiles are decoded straight to their place in it
+        private int DecodedStrideBytes { get { return (PaddedDimensions.X * (int)DecodedBitDepth) / 8; } }
+
+        // Draft images bin every 4x4 block of the mosaic to one 2x2 quad
+        public Vector2i DraftDimensions { get { return PaddedDimensions / 2; } }
+
+        private int DraftStrideBytes { get { return (DraftDimensions.X * (int)DecodedBitDepth) / 8; } }
+
+        // Part of the padded image written by the last DecodeImageData with a region (origin xy, size zw), null when the whole image was decoded
+        public Vector4i? DecodedRegion { get; private set; }
+
+        // When set, single strip lossless frames keep a checkpoint index beside the clip, from which their later decodes run in parallel.
+        // Meant for frames decoded again and again, the index of a frame holds a few of its rows.
+        public bool CheckpointIndex { get; set; }
+
+        // When set, full resolution decodes of the whole frame gather the statistics of its raw samples as they are decoded
+        public bool RawStatisticsEnabled { get; set; }
+
+        // Statistics of the frame last decoded by DecodeImageData, null when none were gathered
+        public RawStatistics Statistics { get; private set; }
+
+        // Adds uncompressed 8 or 16-bit samples, already in dataOut, to the statistics
+        private void GatherStatistics(byte[] dataOut, int dataOutOffset, int sizeBytes)
+        {
+            unsafe
+            {
+                fixed (byte* pDataOut = &dataOut[dataOutOffset])
+                {
+                    if (BitDepth == 8)
+                        Unpack.RawStatistics8Bit(new IntPtr(pDataOut), (uint)sizeBytes, (uint)PaddedDimensions.X, (ulong)dataOutOffset, Statistics);
+                    else
+                        Unpack.RawStatistics16Bit(new IntPtr(pDataOut), (uint)sizeBytes, (uint)PaddedDimensions.X, (ulong)dataOutOffset / 2, Statistics);
+                }
+            }
+        }
+
+        // Indexes are kept in a hidden folder of the clip, named after their frame
+        private string CheckpointIndexPath
+        {
+            get { return Path.Combine(Path.GetDirectoryName(FilePath), ".checkpoints", Path.GetFileName(FilePath) + ".ljci"); }
+        }
+
+        // Dimensions of each strip or tile
+        public Vector2i SegmentDimensions { get { return IsTiled ? TileDimensions : (PaddedDimensions / new Vector2i(1, (int)StripCount)); } }
+
+        // Strips or tiles of the image data, SegmentsAcross to a row. Reading them also settles whether the image data is tiled.
+        public int SegmentCount { get { return ReadSegmentOffsets(out var offsets, out _) ? offsets.Count : 0; } }
+
+        public int SegmentsAcross { get { return PaddedDimensions.X / SegmentDimensions.X; } }
+
+        // Whether a strip or tile overlaps region, every segment does when there is no region
+        private bool SegmentInRegion(int segmentIndex, in Vector4i? region)
+        {
+            if (!region.HasValue)
+                return true;
+            var segmentDimensions = SegmentDimensions;
+            var segmentOrigin = SegmentOrigin(segmentIndex, segmentDimensions);
+            var regionValue = region.Value;
+            return segmentOrigin.X < regionValue.X + regionValue.Z && regionValue.X < segmentOrigin.X + segmentDimensions.X
+                && segmentOrigin.Y < regionValue.Y + regionValue.W && regionValue.Y < segmentOrigin.Y + segmentDimensions.Y;
+        }
+
+        // Bounds of the strips and tiles overlapping region, clamped to the padded image
+        private Vector4i SegmentBounds(in Vector4i region, int segmentCount)
+        {
+            var segmentDimensions = SegmentDimensions;
+            var min = PaddedDimensions;
+            var max = Vector2i.Zero;
+            for (int i = 0; i < segmentCount; i++)
+            {
+                if (!SegmentInRegion(i, region))
+                    continue;
+                var segmentOrigin = SegmentOrigin(i, segmentDimensions);
+                min = Vector2i.ComponentMin(min, segmentOrigin);
+                max = Vector2i.ComponentMax(max, Vector2i.ComponentMin(segmentOrigin + segmentDimensions, PaddedDimensions));
+            }
+            return max.X > min.X && max.Y > min.Y ? new Vector4i(min, max - min) : new Vector4i(0, 0, 0, 0);
+        }
+
+        // Position of a strip or tile in the decoded image, segments run left to right then top to bottom
+        private Vector2i SegmentOrigin(int segmentIndex, in Vector2i segmentDimensions)
+        {
+            var segmentsAcross = PaddedDimensions.X / segmentDimensions.X;
+            return new Vector2i((segmentIndex % segmentsAcross) * segmentDimensions.X, (segmentIndex / segmentsAcross) * segmentDimensions.Y);
+        }
+
         public Vector2i Dimensions
         {
             get
@@ -529,7 +945,7 @@ namespace Octopus.Player.Core.IO.DNG
                             contentReader.Read((long)offset, compressedData.AsMemory(0, (int)byteCount));
                         }
 
-                        CachedIsLossy = Jpeg.IsLossy(compressedData, (int)byteCount);
+                        CachedIsLossy = Jpeg.ReadInfo(Jpeg.LossyContext.ForCurrentThread, compressedData, (int)byteCount, out var info) && info.Lossy;
                     }
                     else
                         CachedIsLossy = false;
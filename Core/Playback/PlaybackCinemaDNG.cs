@@ -154,6 +154,9 @@ namespace Octopus.Player.Core.Playback
             LastDisplayedFrame = FirstFrame;
             var cinemaDNGMetadata = (IO.DNG.MetadataCinemaDNG)cinemaDNGClip.Metadata;
 
+            // Lossless backends are chosen per clip, by timing its first frames
+            Decoders.Jpeg.ResetLosslessBackendSelection();
+
             // Attempt to decode first frame as preview, if that fails bail out
             var gpuFormat = clip.Metadata.DecodedBitDepth <= 8 ? GPU.Format.R8 : GPU.Format.R16;
             var gpuDisplayFormat = GPU.Format.RGBA8;
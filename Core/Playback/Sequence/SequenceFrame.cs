@@ -1,5 +1,6 @@
 ﻿using Octopus.Player.Core.Maths;
 using Octopus.Player.GPU.Render;
+using OpenTK.Mathematics;
 using System;
 using System.Diagnostics;
 
@@ -17,10 +18,10 @@ namespace Octopus.Player.Core.Playback
 #if SEQUENCE_FRAME_DEBUG
 		private volatile static int count = 0;
 #endif
-		public SequenceFrame(GPU.Compute.IContext computeContext, GPU.Compute.IQueue computeQueue, IClip clip, GPU.Format format)
+		public SequenceFrame(GPU.Compute.IContext computeContext, GPU.Compute.IQueue computeQueue, IClip clip, GPU.Format format, Vector2i? dimensions = null)
 		{
             ComputeQueue = computeQueue;
-            decodedImageGpu = computeContext.CreateImage(clip.Metadata.PaddedDimensions, format, GPU.Compute.MemoryDeviceAccess.ReadOnly, GPU.Compute.MemoryHostAccess.WriteOnly);
+            decodedImageGpu = computeContext.CreateImage(dimensions.GetValueOrDefault(clip.Metadata.PaddedDimensions), format, GPU.Compute.MemoryDeviceAccess.ReadOnly, GPU.Compute.MemoryHostAccess.WriteOnly);
 
 #if SEQUENCE_FRAME_DEBUG
 			count++;
@@ -12,10 +12,37 @@ namespace Octopus.Player.Core.Playback
     {
         private IO.DNG.Reader DNGReader { get; set; }
 
+        // Draft frames decode a half width, half height Bayer mosaic and are processed to a half size output
+        public bool Draft { get; private set; }
+
+        // Part of the padded frame (origin xy, size zw, full resolution pixels) needed by the next decode, such as the visible part of a zoomed view.
+        // Strips and tiles outside it are neither decoded nor uploaded, when null the default crop is used.
+        public Vector4i? Region { get; set; }
+
+        // Keeps checkpoint indexes of single strip lossless frames beside the clip, so frames decoded repeatedly, such as those of a loop
+        // or a region being inspected, decode in parallel after the first time
+        public bool CheckpointIndex { get; set; }
+
+        // Gathers the raw sample statistics of full resolution decodes, for exposure tools such as clipping warnings.
+        // Statistics are of the whole frame, so the default crop isn't applied to the decode, a Region still is and then gathers none.
+        public bool RawStatisticsEnabled { get; set; }
+
+        // Statistics of the last decode, null when none were gathered
+        public Decoders.RawStatistics RawStatistics { get; private set; }
+
+        // Debayering reads one CFA quad beyond the pixels it outputs
+        private const int RegionApronPixels = 2;
+
+        // SequenceStream creates its frame pool through reflection with these four arguments, which doesn't fill in optional parameters
         public SequenceFrameDNG(GPU.Compute.IContext computeContext, GPU.Compute.IQueue computeQueue, IClip clip, GPU.Format format)
-            : base(computeContext, computeQueue, clip, format)
+            : this(computeContext, computeQueue, clip, format, false)
         {
+        }
 
+        public SequenceFrameDNG(GPU.Compute.IContext computeContext, GPU.Compute.IQueue computeQueue, IClip clip, GPU.Format format, bool draft)
+            : base(computeContext, computeQueue, clip, format, draft ? clip.Metadata.PaddedDimensions / 2 : (Vector2i?)null)
+        {
+            Draft = draft;
         }
 
         Error TryDecode(IClip clip, byte[] workingBuffer = null)
@@ -38,6 +65,7 @@ namespace Octopus.Player.Core.Playback
                 return Error.FrameNotPresent;
 
             // Create a new DNG reader for this frame
+            RawStatistics = null;
             if (DNGReader != null)
                 DNGReader.Dispose();
             DNGReader = null;
@@ -48,6 +76,8 @@ namespace Octopus.Player.Core.Playback
                 DNGReader = null;
                 return Error.BadFrame;
             }
+            DNGReader.CheckpointIndex = CheckpointIndex;
+            DNGReader.RawStatisticsEnabled = RawStatisticsEnabled;
 
             // Read timecode
             if ( DNGReader.ContainsTimeCode )
@@ -62,16 +92,36 @@ namespace Octopus.Player.Core.Playback
                     var bytesPerPixel = clip.Metadata.BitDepth <= 8 ? 1 : 2;
 
                     // Decode and copy to GPU
-                    Debug.Assert(decodedImageGpu != null && decodedImageGpu.Dimensions == clip.Metadata.PaddedDimensions);
-                    var decodedImage = System.Buffers.ArrayPool<byte>.Shared.Rent(bytesPerPixel * clip.Metadata.PaddedDimensions.Area());
-                    decodeDataError = DNGReader.DecodeImageData(decodedImage, dngMetadata.IsLossy);
+                    Debug.Assert(decodedImageGpu != null && decodedImageGpu.Dimensions == (Draft ? DNGReader.DraftDimensions : clip.Metadata.PaddedDimensions));
+                    var decodedImage = System.Buffers.ArrayPool<byte>.Shared.Rent(bytesPerPixel * decodedImageGpu.Dimensions.Area());
+                    var decodeRegion = (RawStatisticsEnabled && !Region.HasValue) ? null : DecodeRegion(dngMetadata);
+                    decodeDataError = DNGReader.DecodeImageData(decodedImage, dngMetadata.IsLossy, Draft, decodeRegion);
+                    if (decodeDataError == Error.None)
+                        RawStatistics = DNGReader.Statistics;
                     try
                     {
                         if (decodeDataError == Error.None)
                         {
+                            // Compressed tiles are decoded in place, so only uncompressed tiles need uploading one at a time
+                            // Strips and tiles outside the decoded region are left as they are on the GPU
                             var metadata = (IO.DNG.MetadataCinemaDNG)clip.Metadata;
-                            if (metadata.TileCount > 0)
-                                ForEachTile(metadata, (origin, size, offset) => { ComputeQueue.ModifyImage(decodedImageGpu, origin, size, decodedImage, offset); });
+                            var decodedRegion = DNGReader.DecodedRegion;
+                            if (metadata.TileCount > 0 && DNGReader.Compression == IO.DNG.Compression.None && !Draft)
+                            {
+                                ForEachTile(metadata, (origin, size, offset) =>
+                                {
+                                    if (!decodedRegion.HasValue || Intersects(decodedRegion.Value, new Vector4i(origin, size)))
+                                        ComputeQueue.ModifyImage(decodedImageGpu, origin, size, decodedImage, offset);
+                                });
+                            }
+                            else if (decodedRegion.HasValue)
+                            {
+                                var uploadRegion = Draft ? decodedRegion.Value / 2 : decodedRegion.Value;
+                                var rowPitchBytes = bytesPerPixel * decodedImageGpu.Dimensions.X;
+                                if (uploadRegion.Z > 0 && uploadRegion.W > 0)
+                                    ComputeQueue.ModifyImage(decodedImageGpu, uploadRegion.Xy, uploadRegion.Zw, decodedImage,
+                                        (uint)(uploadRegion.Y * rowPitchBytes + uploadRegion.X * bytesPerPixel), (uint)rowPitchBytes);
+                            }
                             else
                                 ComputeQueue.ModifyImage(decodedImageGpu, Vector2i.Zero, decodedImageGpu.Dimensions, decodedImage);
                         }
@@ -111,6 +161,22 @@ namespace Octopus.Player.Core.Playback
             return result;
         }
 
+        // Region handed to the reader, grown by the debayer apron and clamped to the padded frame
+        private Vector4i? DecodeRegion(IO.DNG.MetadataCinemaDNG metadata)
+        {
+            var region = Region.HasValue ? Region : metadata.DefaultCrop;
+            if (!region.HasValue)
+                return null;
+            var min = Vector2i.ComponentMax(region.Value.Xy - new Vector2i(RegionApronPixels), Vector2i.Zero);
+            var max = Vector2i.ComponentMin(region.Value.Xy + region.Value.Zw + new Vector2i(RegionApronPixels), metadata.PaddedDimensions);
+            return new Vector4i(min, Vector2i.ComponentMax(max - min, Vector2i.Zero));
+        }
+
+        private static bool Intersects(in Vector4i a, in Vector4i b)
+        {
+            return a.X < b.X + b.Z && b.X < a.X + a.Z && a.Y < b.Y + b.W && b.Y < a.Y + a.W;
+        }
+
         private void ForEachTile(IO.DNG.MetadataCinemaDNG metadata, Action<Vector2i, Vector2i, uint> action)
         {
             uint dataOffset = 0;
@@ -211,8 +277,8 @@ namespace Octopus.Player.Core.Playback
                 if ( output.Texture != null)
                     queue.AcquireTextureObject(renderContext, output);
 
-                // Run the kernel 4 pixels at a time
-                var launchOffset = (metadata.DefaultCrop.HasValue ? metadata.DefaultCrop.Value.Xy : Vector2i.Zero) / 2;
+                // Run the kernel 4 pixels at a time, draft frames are already binned to half size
+                var launchOffset = (metadata.DefaultCrop.HasValue ? metadata.DefaultCrop.Value.Xy : Vector2i.Zero) / (Draft ? 4 : 2);
                 var launchDimensions = output.Dimensions / 2;
                 program.Run2D(queue, kernel, launchDimensions, launchOffset);
 
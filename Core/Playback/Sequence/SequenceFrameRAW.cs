@@ -1,4 +1,5 @@
-﻿using System;
+﻿using OpenTK.Mathematics;
+using System;
 
 namespace Octopus.Player.Core.Playback
 {
@@ -6,8 +7,8 @@ namespace Octopus.Player.Core.Playback
     {
         public bool Processed { get; protected set; }
 
-        public SequenceFrameRAW(GPU.Compute.IContext computeContext, GPU.Compute.IQueue computeQueue, IClip clip, GPU.Format format)
-            : base(computeContext, computeQueue, clip, format)
+        public SequenceFrameRAW(GPU.Compute.IContext computeContext, GPU.Compute.IQueue computeQueue, IClip clip, GPU.Format format, Vector2i? dimensions = null)
+            : base(computeContext, computeQueue, clip, format, dimensions)
 		{
 
 		}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace Octopus::Player::Decoders
+{
+    // Draft decoding bins every 4x4 block of a Bayer mosaic to a single 2x2 CFA quad, each output sample
+    // being the average of the four input samples of the same colour. The output is a half width,
+    // half height mosaic with the same CFA pattern. Rows and columns past the last whole block are dropped.
+    template<typename T>
+    inline void BinBayerDraft(uint8_t* pOut, size_t outputStrideBytes, const uint8_t* pIn, size_t inputStrideBytes, uint32_t width, uint32_t height)
+    {
+        for (uint32_t y = 0; y + 4 <= height; y += 4)
+        {
+            const T* pRow0 = (const T*)(pIn + y * inputStrideBytes);
+            const T* pRow1 = (const T*)(pIn + (y + 1) * inputStrideBytes);
+            const T* pRow2 = (const T*)(pIn + (y + 2) * inputStrideBytes);
+            const T* pRow3 = (const T*)(pIn + (y + 3) * inputStrideBytes);
+            T* pOut0 = (T*)(pOut + (y / 2) * outputStrideBytes);
+            T* pOut1 = (T*)(pOut + (y / 2 + 1) * outputStrideBytes);
+
+            for (uint32_t x = 0; x + 4 <= width; x += 4)
+            {
+                const auto o = x / 2;
+                pOut0[o] = (T)(((uint32_t)pRow0[x] + pRow0[x + 2] + pRow2[x] + pRow2[x + 2] + 2) >> 2);
+                pOut0[o + 1] = (T)(((uint32_t)pRow0[x + 1] + pRow0[x + 3] + pRow2[x + 1] + pRow2[x + 3] + 2) >> 2);
+                pOut1[o] = (T)(((uint32_t)pRow1[x] + pRow1[x + 2] + pRow3[x] + pRow3[x + 2] + 2) >> 2);
+                pOut1[o + 1] = (T)(((uint32_t)pRow1[x + 1] + pRow1[x + 3] + pRow3[x + 1] + pRow3[x + 3] + 2) >> 2);
+            }
+        }
+    }
+}
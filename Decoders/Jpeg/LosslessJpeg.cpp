@@ -3,15 +3,36 @@
 // Adapted from Adobe DNG SDK 1.5.1: https://github.com/shahminfikri/dng_sdk_1.5.1_-_gpr_sdk_1.0.0/blob/master/dng_sdk/dng_lossless_jpeg.cpp
 
 #include "JpegMarker.h"
+#include "LosslessJpegTurbo.h"
+#include "../Draft.h"
+#include "../RawStatistics.h"
+#include "../ThreadPool.h"
 
 #include <assert.h>
+#include <float.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
 #include <vector>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
 #ifdef _MSC_VER
 #define FORCE_INLINE __forceinline
 
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
+#include <intrin.h>
 
 BOOL APIENTRY DllMain(HMODULE hModule, DWORD  ul_reason_for_call, LPVOID lpReserved )
 {
@@ -33,6 +54,14 @@ BOOL APIENTRY DllMain(HMODULE hModule, DWORD  ul_reason_for_call, LPVOID lpReser
 #endif
 #endif
 
+// Compressed input must be followed by this many readable (zeroed) bytes, the bit reader
+// loads whole words and may read past the end of the entropy coded segment.
+#define LOSSLESS_INPUT_PADDING_BYTES 16
+
+// Zeroed bytes after the unstuffed entropy coded segment, covers the bit reader's word
+// loads and the unstuffing prepass' whole vector stores
+#define LOSSLESS_ENTROPY_PADDING_BYTES 64
+
 namespace Octopus::Player::Decoders::Jpeg
 {
 	static FORCE_INLINE void ThrowBadFormat()
@@ -40,6 +69,55 @@ namespace Octopus::Player::Decoders::Jpeg
 		// Note: Exceptions removed for performance
 	}
 
+	// Number of trailing zero bits, x must be non-zero
+	static FORCE_INLINE int32_t CountTrailingZeros(uint32_t x)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanForward(&index, x);
+		return (int32_t)index;
+#else
+		return __builtin_ctz(x);
+#endif
+	}
+
+	// Number of leading zero bits, x must be non-zero
+	static FORCE_INLINE int32_t CountLeadingZeros(uint32_t x)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanReverse(&index, x);
+		return 31 - (int32_t)index;
+#else
+		return __builtin_clz(x);
+#endif
+	}
+
+	// Converts a big endian (stream order) word to native order
+	static FORCE_INLINE uint64_t ByteSwap(uint64_t x)
+	{
+#ifdef _MSC_VER
+		return _byteswap_uint64(x);
+#else
+		return __builtin_bswap64(x);
+#endif
+	}
+
+	// Width of the multi-symbol Huffman lookup table index
+	// A single lookup resolves the code length, the extra bit count and, when the code and
+	// its extra bits both fit in the index, the sign extended difference.
+	constexpr int32_t kHuffLookupBits = 12;
+
+	// Lookup table entry layout
+	// bits 0-4: bits to consume (0 = code longer than kHuffLookupBits)
+	// bits 5-9: difference magnitude category (SSSS)
+	// bit 10: difference resolved, bits to consume includes the extra bits
+	// bits 16-31: signed difference (when resolved)
+	constexpr int32_t kHuffLookupLengthMask = 0x1f;
+	constexpr int32_t kHuffLookupCategoryShift = 5;
+	constexpr int32_t kHuffLookupResolved = 1 << 10;
+	constexpr int32_t kHuffLookupDiffShift = 16;
+
 	struct sHuffmanTable
 	{
 		/*
@@ -57,32 +135,27 @@ namespace Octopus::Player::Decoders::Jpeg
 		uint16_t mincode[17];
 		int32_t maxcode[18];
 		int16_t valptr[17];
-		int32_t numbits[256];
-		int32_t value[256];
+
+		// Multi-symbol lookup, indexed by the next kHuffLookupBits of the stream
+		int32_t lookup[1 << kHuffLookupBits];
+
+		// Left justified (16-bit) upper limit of all codes up to each length, for long codes
+		int32_t limit[18];
+
+		// First code length to test for a long code, indexed by its number of leading one bits
+		int8_t longStart[17];
 
 		uint16_t ehufco[256];
 		int8_t ehufsi[256];
 	};
 
 	// Computes the derived fields in the Huffman table structure.
-	static void FixHuffTbl(sHuffmanTable* htbl)
+	static void FixHuffTbl(sHuffmanTable* htbl, bool bug16)
 	{
 
 		int32_t l;
 		int32_t i;
 
-		const uint32_t bitMask[] =
-		{
-            0xffffffff, 0x7fffffff, 0x3fffffff, 0x1fffffff,
-            0x0fffffff, 0x07ffffff, 0x03ffffff, 0x01ffffff,
-            0x00ffffff, 0x007fffff, 0x003fffff, 0x001fffff,
-            0x000fffff, 0x0007ffff, 0x0003ffff, 0x0001ffff,
-            0x0000ffff, 0x00007fff, 0x00003fff, 0x00001fff,
-            0x00000fff, 0x000007ff, 0x000003ff, 0x000001ff,
-            0x000000ff, 0x0000007f, 0x0000003f, 0x0000001f,
-            0x0000000f, 0x00000007, 0x00000003, 0x00000001
-		};
-
 		// Figure C.1: make table of Huffman code length for each symbol
 		// Note that this is in code-length order.
 
@@ -157,39 +230,88 @@ namespace Octopus::Player::Decoders::Jpeg
 		// We put in this value to ensure HuffDecode terminates.
 		htbl->maxcode[17] = 0xFFFFFL;
 
-		// Build the numbits, value lookup tables.
-		// These table allow us to gather 8 bits from the bits stream,
-		// and immediately lookup the size and value of the huffman codes.
-		// If size is zero, it means that more than 8 bits are in the huffman
-		// code (this happens about 3-4% of the time).
-		memset(htbl->numbits, 0, sizeof(htbl->numbits));
+		// Build the left justified code limits used to find the length of codes
+		// longer than the lookup table index. Lengths without codes inherit the
+		// limit of the previous length so the search never stops on them.
+		int32_t limit = -1;
+
+		for (l = 1; l <= 16; l++)
+		{
+			if (htbl->bits[l])
+				limit = ((htbl->maxcode[l] + 1) << (16 - l)) - 1;
+
+			htbl->limit[l] = limit;
+		}
+
+		htbl->limit[17] = 0xFFFF;
+
+		// Canonical codes are assigned in increasing order, so a code beginning with
+		// n one bits cannot be shorter than the first length whose limit reaches the
+		// smallest 16-bit value with n leading ones.
+		for (int32_t n = 0; n <= 16; n++)
+		{
+			const int32_t smallest = (0xFFFF << (16 - n)) & 0xFFFF;
+
+			l = kHuffLookupBits + 1;
+
+			while (l < 17 && htbl->limit[l] < smallest)
+				l++;
+
+			htbl->longStart[n] = (int8_t)l;
+		}
+
+		// Build the multi-symbol lookup table.
+		// Each entry holds the length of the code in the top bits of the index, and
+		// where the extra bits also fit inside the index, the sign extended difference
+		// so the whole sample is decoded with a single lookup.
+		// Entries with a zero length are codes longer than the index (rare).
+		memset(htbl->lookup, 0, sizeof(htbl->lookup));
 
 		for (p = 0; p < lastp; p++)
 		{
-			int32_t size = huffsize[p];
+			const int32_t size = huffsize[p];
 
-			if (size <= 8)
-			{
-				int32_t value = htbl->huffval[p];
+			if (size > kHuffLookupBits)
+				continue;
 
-				code = huffcode[p];
+			int32_t s = htbl->huffval[p];
+
+			// Garbage input, fake a zero as the safest result
+			if (s > 16)
+			{
+				ThrowBadFormat();
+				s = 0;
+			}
 
-				int32_t ll = code << (8 - size);
+			const int32_t freeBits = kHuffLookupBits - size;
+			const int32_t ll = huffcode[p] << freeBits;
+			const int32_t ul = ll | ((1 << freeBits) - 1);
 
-				int32_t ul = (size < 8 ? ll | bitMask[24 + size]
-					: ll);
+			for (i = ll; i <= ul; i++)
+			{
+				int32_t entry = size | (s << kHuffLookupCategoryShift);
 
-				if (ul >= static_cast<int32_t> (sizeof(htbl->numbits) / sizeof(htbl->numbits[0])) ||
-					ul >= static_cast<int32_t> (sizeof(htbl->value) / sizeof(htbl->value[0])))
+				if (s == 0)
 				{
-					ThrowBadFormat();
+					entry |= kHuffLookupResolved;
 				}
-
-				for (i = ll; i <= ul; i++)
+				else if (s == 16)
+				{
+					// Only the "16-bit" bug reads extra bits for this category
+					if (!bug16)
+						entry |= kHuffLookupResolved | (-32768 * (1 << kHuffLookupDiffShift));
+				}
+				else if (s <= freeBits)
 				{
-					htbl->numbits[i] = size;
-					htbl->value[i] = value;
+					int32_t d = (i >> (freeBits - s)) & ((1 << s) - 1);
+
+					if (d < (1 << (s - 1)))
+						d += (-1 * (1 << s)) + 1;
+
+					entry = (size + s) | (s << kHuffLookupCategoryShift) | kHuffLookupResolved | (d * (1 << kHuffLookupDiffShift));
 				}
+
+				htbl->lookup[i] = entry;
 			}
 		}
 	}
@@ -281,21 +403,32 @@ namespace Octopus::Player::Decoders::Jpeg
 		 */
 		int32_t restartRowsToGo;	/* MCUs rows left in this restart interval */
 		int16_t nextRestartNum;	/* # of next RSTn marker (0..7) */
+		int32_t nextRestartInterval;	/* index of the next restart interval in the entropy coded segment */
 	};
 
 
 	typedef uint16_t ComponentType;
-	typedef ComponentType* MCU;
 
 	class DecoderInput
 	{
 	public:
-		DecoderInput(uint8_t* pStream)
+		DecoderInput(uint8_t* pStream, uint64_t size)
 			: m_pStream(pStream)
+			, m_size(size)
 			, m_position(0ull)
 		{}
 
 		FORCE_INLINE uint8_t Get_uint8() { return m_pStream[m_position++]; }
+		FORCE_INLINE const uint8_t* Data() const { return m_pStream; }
+		FORCE_INLINE uint64_t Size() const { return m_size; }
+
+		// Next 8 bytes in stream order without advancing, relies on the padded input, the caller checks it is within it
+		FORCE_INLINE uint64_t Peek_uint64() const
+		{
+			uint64_t word;
+			memcpy(&word, m_pStream + m_position, sizeof(word));
+			return ByteSwap(word);
+		}
 		FORCE_INLINE uint64_t Position() const { return m_position; }
 		FORCE_INLINE void SetReadPosition(uint64_t position) { m_position = position; }
 		FORCE_INLINE void Skip(uint64_t length) { m_position += length; }
@@ -303,61 +436,237 @@ namespace Octopus::Player::Decoders::Jpeg
 	private:
 
 		uint8_t* m_pStream;
+		uint64_t m_size;
 		uint64_t m_position;
 	};
 
+	// Entropy coded segment with the byte stuffing and markers removed
+	struct sEntropyCodedSegment
+	{
+		const uint8_t* pData;		// followed by LOSSLESS_ENTROPY_PADDING_BYTES zeroed bytes
+		uint64_t size;
+
+		// Start of every restart interval in pData, the first interval starts at 0
+		uint64_t* pIntervalPositions;
+		uint32_t intervalCount;
+		bool restartsInSequence;	// RSTn markers were numbered correctly, and no more than expected
+	};
+
+	// A stretch of a scan without restart markers, decoded from a guessed bit position.
+	// Huffman codes resynchronise by themselves, so once the decode of the previous chunk reaches a symbol
+	// boundary of this one, with the same component, the rest of this chunk's differences are correct.
+	struct sSpeculativeChunk
+	{
+		uint64_t startBit;
+		uint64_t endBit;					// the decode stops at the first symbol boundary at or after endBit
+		uint32_t phase;						// component of the first difference
+		std::vector<int16_t> differences;	// count used, the rest is room to grow
+		uint64_t count;
+		std::vector<uint64_t> boundaries;	// bit position of the first symbols, to synchronise with
+		uint64_t stopBit;					// bit position after the last difference
+		uint64_t validStart;				// first difference known to be in sync with the previous chunk
+	};
+
+	// Position of the first 0xFF in [p, pEnd), or pEnd. Copies every byte scanned to pOut,
+	// which must have room for a whole vector beyond the bytes scanned.
+	static FORCE_INLINE const uint8_t* CopyUntilFF(const uint8_t* p, const uint8_t* pEnd, uint8_t*& pOut)
+	{
+#if defined(__AVX2__)
+		const __m256i ff32 = _mm256_set1_epi8((char)0xFF);
+		while (p + 32 <= pEnd)
+		{
+			const __m256i v = _mm256_loadu_si256((const __m256i*)p);
+			_mm256_storeu_si256((__m256i*)pOut, v);
+			const uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, ff32));
+			if (mask)
+			{
+				const auto offset = CountTrailingZeros(mask);
+				pOut += offset;
+				return p + offset;
+			}
+			p += 32;
+			pOut += 32;
+		}
+#endif
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+		const __m128i ff16 = _mm_set1_epi8((char)0xFF);
+		while (p + 16 <= pEnd)
+		{
+			const __m128i v = _mm_loadu_si128((const __m128i*)p);
+			_mm_storeu_si128((__m128i*)pOut, v);
+			const uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, ff16));
+			if (mask)
+			{
+				const auto offset = CountTrailingZeros(mask);
+				pOut += offset;
+				return p + offset;
+			}
+			p += 16;
+			pOut += 16;
+		}
+#endif
+		auto pFF = (const uint8_t*)memchr(p, 0xFF, pEnd - p);
+		if (!pFF)
+			pFF = pEnd;
+		memcpy(pOut, p, pFF - p);
+		pOut += pFF - p;
+		return pFF;
+	}
+
+	// Removes the stuffed zero bytes from an entropy coded segment and records the restart
+	// marker positions, so the Huffman decoder can read it without checking for 0xFF.
+	// pOut must have room for the input size plus LOSSLESS_ENTROPY_PADDING_BYTES, and
+	// segment.pIntervalPositions room for maxIntervals (at least one) positions.
+	static void UnstuffEntropyCodedSegment(const uint8_t* pIn, uint64_t size, uint8_t* pOut, uint32_t maxIntervals, sEntropyCodedSegment& segment)
+	{
+		const uint8_t* p = pIn;
+		const uint8_t* pEnd = pIn + size;
+		uint8_t* pWrite = pOut;
+
+		segment.pData = pOut;
+		segment.pIntervalPositions[0] = 0;
+		segment.intervalCount = 1;
+		segment.restartsInSequence = true;
+
+		while (p < pEnd)
+		{
+			p = CopyUntilFF(p, pEnd, pWrite);
+
+			if (p + 1 >= pEnd)
+				break;
+
+			const uint8_t c = p[1];
+
+			if (c == 0)
+			{
+				// Stuffed zero byte
+				*pWrite++ = 0xFF;
+				p += 2;
+			}
+			else if (c == 0xFF)
+			{
+				// Extra FFs are legal before a marker
+				p++;
+			}
+			else if (c >= M_RST0 && c <= M_RST7)
+			{
+				if (c != M_RST0 + ((segment.intervalCount - 1) & 7) || segment.intervalCount == maxIntervals)
+					segment.restartsInSequence = false;
+				else
+					segment.pIntervalPositions[segment.intervalCount++] = pWrite - pOut;
+				p += 2;
+			}
+			else
+			{
+				// Any other marker ends the entropy coded segment
+				break;
+			}
+		}
+
+		segment.size = pWrite - pOut;
+		memset(pWrite, 0, LOSSLESS_ENTROPY_PADDING_BYTES);
+	}
+
+	// Destination for decoded rows, rows are reconstructed in place so the previous
+	// output row doubles as the upper predictor row
+	// Rows of decoded samples, rowStrideBytes apart so they can be placed inside a larger image
+	// Rows are added to the raw statistics, if any, once they are complete, while they are still in the cache
 	class DecoderOutput
 	{
 	public:
-		DecoderOutput(uint8_t* pOutput, uint64_t outputSize)
+		DecoderOutput(uint8_t* pOutput, uint64_t rowStrideBytes, uint32_t rowCount, const RawStatisticsRows& statistics = RawStatisticsRows())
 			: m_pOutput(pOutput)
-			, m_pBufferEnd(pOutput + outputSize)
+			, m_rowStrideBytes(rowStrideBytes)
+			, m_rowsLeft(rowCount)
+			, m_statistics(statistics)
+			, m_pPendingRow(nullptr)
+			, m_pendingSamples(0)
 		{
 		}
 
-		FORCE_INLINE void Spool(const void* pData, uint32_t count)
+		FORCE_INLINE ComponentType* NextRow(uint32_t rowSizeBytes)
 		{
-			assert((m_pOutput + count) <= m_pBufferEnd);
+			assert(rowSizeBytes <= m_rowStrideBytes && m_rowsLeft > 0);
+
+			const auto pRow = (ComponentType*)m_pOutput;
+			m_pOutput += m_rowStrideBytes;
+			m_rowsLeft--;
+
+			// The row before is complete once the next is asked for
+			if (m_statistics.Enabled())
+			{
+				if (m_pPendingRow)
+					m_statistics.Accumulate(m_pPendingRow, m_pendingSamples);
+				m_pPendingRow = pRow;
+				m_pendingSamples = rowSizeBytes / sizeof(ComponentType);
+			}
+			return pRow;
+		}
 
-			memcpy(m_pOutput, pData, count);
-			m_pOutput += count;
+		// Adds the last row to the statistics, once the decode is done
+		void Finish()
+		{
+			if (m_pPendingRow)
+				m_statistics.Accumulate(m_pPendingRow, m_pendingSamples);
+			m_pPendingRow = nullptr;
 		}
 
 	private:
 
 		uint8_t* m_pOutput;
-		uint8_t* m_pBufferEnd;
+		uint64_t m_rowStrideBytes;
+		uint32_t m_rowsLeft;
+		RawStatisticsRows m_statistics;
+		const ComponentType* m_pPendingRow;
+		uint32_t m_pendingSamples;
 	};
  
+    // Bump allocator over a caller owned buffer, allocations are 16 byte aligned
     class LosslessJpegAllocator
     {
     public:
         LosslessJpegAllocator(uint8_t* pBuffer, uint64_t bufferSize)
         : m_pBuffer(pBuffer)
         , m_bufferSize(bufferSize)
+        , m_requestedSize(0)
         {}
         
+        FORCE_INLINE void Reset(uint8_t* pBuffer, uint64_t bufferSize)
+        {
+            m_pBuffer = pBuffer;
+            m_bufferSize = bufferSize;
+            m_requestedSize = 0;
+        }
+        
 		FORCE_INLINE bool CanAllocate(uint64_t size)
         {
-            return ( size <= m_bufferSize );
+            return ( AlignedSize(size) <= m_bufferSize );
         }
         
 		FORCE_INLINE uint8_t* Allocate(uint64_t size)
         {
-            if ( CanAllocate(size) )
+            const auto alignedSize = AlignedSize(size);
+            m_requestedSize += alignedSize;
+            if ( alignedSize <= m_bufferSize )
             {
                 const auto pBuffer = m_pBuffer;
-                m_pBuffer += size;
-                m_bufferSize -= size;
+                m_pBuffer += alignedSize;
+                m_bufferSize -= alignedSize;
                 return pBuffer;
             }
             return nullptr;
         }
+        
+        // Total of all allocations since the last reset, including any that didn't fit
+        FORCE_INLINE uint64_t RequestedSize() const { return m_requestedSize; }
+        
+        static constexpr uint64_t AlignedSize(uint64_t size) { return (size + 15) & ~15ull; }
     
     private:
     
         uint8_t* m_pBuffer;
         uint64_t m_bufferSize;
+        uint64_t m_requestedSize;
     };
     
     class LosslessJpegMemory
@@ -365,25 +674,20 @@ namespace Octopus::Player::Decoders::Jpeg
 	public:
  
         LosslessJpegMemory(LosslessJpegAllocator* pAllocator)
-        : m_pStaticBuffer(nullptr)
-        , m_pAllocator(pAllocator)
+        : m_pAllocator(pAllocator)
+        , m_pStaticBuffer(nullptr)
         {}
 
 		FORCE_INLINE void Allocate(uint64_t size)
 		{
-            if ( m_pAllocator && m_pAllocator->CanAllocate(size))
-                m_pStaticBuffer = m_pAllocator->Allocate(size);
-            else
+            m_pStaticBuffer = m_pAllocator ? m_pAllocator->Allocate(size) : nullptr;
+            if ( !m_pStaticBuffer )
                 m_data.resize(size);
 		}
 
 		FORCE_INLINE void Allocate(uint64_t count, uint64_t elementSize)
 		{
-            const auto size = count * elementSize;
-            if ( m_pAllocator && m_pAllocator->CanAllocate(size))
-                m_pStaticBuffer = m_pAllocator->Allocate(size);
-            else
-                m_data.resize(size);
+            Allocate(count * elementSize);
 		}
 
 		FORCE_INLINE uint8_t* Buffer() { return m_pStaticBuffer ? m_pStaticBuffer : m_data.data(); }
@@ -395,37 +699,126 @@ namespace Octopus::Player::Decoders::Jpeg
 		std::vector<uint8_t> m_data;
 	};
 
+	// Parsed headers and derived Huffman tables of recently decoded streams.
+	// Frames of a clip, and tiles of a frame, normally share byte identical headers, so the
+	// header bytes up to the end of the scan header are the key. Entries are read only once inserted.
+	class LosslessJpegHeaderCache
+	{
+	public:
+
+		struct sEntry
+		{
+			std::vector<uint8_t> headerBytes;
+			bool bug16;
+			sDecompressInfo info;		// state after the scan header, points into this entry
+			std::vector<sJpegComponentInfo> compInfo;
+			std::unique_ptr<sHuffmanTable> huffmanTables[4];
+		};
+
+		LosslessJpegHeaderCache()
+			: m_nextEntry(0)
+		{}
+
+		// Entry whose headers the stream starts with, or nullptr
+		const sEntry* Find(const uint8_t* pStream, uint64_t size, bool bug16) const
+		{
+			for (const auto& entry : m_entries)
+			{
+				const auto headerSize = entry.headerBytes.size();
+				if (entry.bug16 == bug16 && headerSize <= size && memcmp(entry.headerBytes.data(), pStream, headerSize) == 0)
+					return &entry;
+			}
+			return nullptr;
+		}
+
+		// Stores the decoder state after parsing headerSize bytes of the stream, replacing the oldest entry when full
+		void Insert(const uint8_t* pStream, uint64_t headerSize, bool bug16, const sDecompressInfo& info)
+		{
+			if (m_entries.size() < kEntryCount)
+				m_entries.emplace_back();
+			auto& entry = m_entries[m_nextEntry];
+			m_nextEntry = (m_nextEntry + 1) % kEntryCount;
+
+			entry.headerBytes.assign(pStream, pStream + headerSize);
+			entry.bug16 = bug16;
+			entry.info = info;
+			entry.compInfo.assign(info.compInfo, info.compInfo + info.numComponents);
+			entry.info.compInfo = entry.compInfo.data();
+
+			for (int32_t i = 0; i < info.compsInScan; i++)
+				entry.info.curCompInfo[i] = entry.compInfo.data() + (info.curCompInfo[i] - info.compInfo);
+
+			for (int32_t i = 0; i < 4; i++)
+			{
+				if (info.dcHuffTblPtrs[i])
+				{
+					if (!entry.huffmanTables[i])
+						entry.huffmanTables[i].reset(new sHuffmanTable);
+					*entry.huffmanTables[i] = *info.dcHuffTblPtrs[i];
+				}
+				entry.info.dcHuffTblPtrs[i] = info.dcHuffTblPtrs[i] ? entry.huffmanTables[i].get() : nullptr;
+			}
+		}
+
+	private:
+
+		static constexpr uint32_t kEntryCount = 4;
+
+		std::vector<sEntry> m_entries;
+		uint32_t m_nextEntry;
+	};
+
 	class LosslessJpegDecoder
 	{
 	public:
 
-		LosslessJpegDecoder(DecoderInput* stream, DecoderOutput* spooler, bool bug16, LosslessJpegAllocator* pAllocator = nullptr)
+		LosslessJpegDecoder(DecoderInput* stream, DecoderOutput* spooler, bool bug16, LosslessJpegAllocator* pAllocator = nullptr,
+			LosslessJpegHeaderCache* pHeaderCache = nullptr)
 			: fStream(stream)
 			, fSpooler(spooler)
 			, fBug16(bug16)
+			, fHeaderCache(pHeaderCache)
             , huffmanBuffer{pAllocator, pAllocator, pAllocator, pAllocator}
 			, compInfoBuffer(pAllocator)
 			, info()
-			, mcuBuffer1(pAllocator)
-			, mcuBuffer2(pAllocator)
-			, mcuBuffer3(pAllocator)
-			, mcuBuffer4(pAllocator)
-			, mcuROW1(nullptr)
-			, mcuROW2(nullptr)
+			, entropyBuffer(pAllocator)
+			, intervalBuffer(pAllocator)
+			, diffBuffer(pAllocator)
+			, fSegment(nullptr)
+			, fEntropyStream(nullptr, 0)
 			, getBuffer(0)
 			, bitsLeft(0)
 		{
 			memset(&info, 0, sizeof(info));
 		}
 
-		bool StartRead(uint32_t& imageWidth, uint32_t& imageHeight, uint32_t& imageChannels)
+		// Reads the headers and prepares the entropy coded segment, which may be shared with
+		// another decoder of the same stream instead of being unstuffed again
+		bool StartRead(uint32_t& imageWidth, uint32_t& imageHeight, uint32_t& imageChannels, const sEntropyCodedSegment* pSharedSegment = nullptr)
 		{
-			if (!ReadFileHeader())
-				return false;
-			if (ReadScanHeader() == -1)
-				return false;
-			DecoderStructInit();
-			HuffDecoderInit();
+			const auto pCachedHeader = fHeaderCache ? fHeaderCache->Find(fStream->Data(), fStream->Size(), fBug16) : nullptr;
+			if (pCachedHeader)
+			{
+				// Same headers as an earlier stream, skip straight to the entropy coded data
+				info = pCachedHeader->info;
+				fStream->SetReadPosition(pCachedHeader->headerBytes.size());
+			}
+			else
+			{
+				if (!ReadFileHeader())
+					return false;
+				const auto scanHeader = ReadScanHeader();
+				if (scanHeader == -1)
+					return false;
+				DecoderStructInit();
+				HuffDecoderInit();
+
+				if (fHeaderCache && scanHeader == 1)
+					fHeaderCache->Insert(fStream->Data(), fStream->Position(), fBug16, info);
+			}
+			EntropyDecoderInit(pSharedSegment);
+
+			diffBuffer.Allocate((uint64_t)std::max(info.imageWidth, 0) * std::max<int32_t>(info.compsInScan, 0), sizeof(int16_t));
 
 			imageWidth = info.imageWidth;
 			imageHeight = info.imageHeight;
@@ -436,19 +829,200 @@ namespace Octopus::Player::Decoders::Jpeg
 
 		void FinishRead()
 		{
-			DecodeImage();
+			DecodeImage(info.imageHeight);
 		}
 
-	private:
+		// Rows per restart interval, 0 if the scan has no restart markers
+		int32_t RestartIntervalRows() const
+		{
+			if (info.restartInterval == 0 || (info.restartInterval % info.imageWidth) != 0)
+				return 0;
+			return info.restartInRows;
+		}
 
-		FORCE_INLINE uint8_t GetJpegChar()
+		// Start of every restart interval in the entropy coded segment.
+		// Returns false if the markers found don't match the expected interval layout.
+		bool IndexRestartIntervals() const
 		{
-			return fStream->Get_uint8();
+			const auto restartRows = RestartIntervalRows();
+			if (restartRows == 0 || !fSegment->restartsInSequence)
+				return false;
+
+			const auto intervalCount = (info.imageHeight + restartRows - 1) / restartRows;
+			return fSegment->intervalCount == (uint32_t)intervalCount;
+		}
+
+		const sEntropyCodedSegment& EntropyCodedSegment() const
+		{
+			return *fSegment;
+		}
+
+		// Decodes a single restart interval starting at the given read position
+		void DecodeRestartInterval(uint32_t interval, DecoderOutput* spooler, int32_t numROW)
+		{
+			BeginRestartInterval(interval, spooler);
+			DecodeImage(numROW);
+		}
+
+		// Moves to the start of a restart interval, which is then decoded to spooler
+		void BeginRestartInterval(uint32_t interval, DecoderOutput* spooler)
+		{
+			fEntropyStream.SetReadPosition(fSegment->pIntervalPositions[interval]);
+			fSpooler = spooler;
+
+			getBuffer = 0;
+			bitsLeft = 0;
+			info.restartRowsToGo = info.restartInRows;
+			info.nextRestartInterval = interval + 1;
+		}
+
+		// Streams decoded in lockstep by DecodeInterleaved
+		static constexpr uint32_t kInterleavedStreams = 4;
+
+		// True if the scan has the shape of other's, so the two can be decoded in lockstep
+		bool InterleavesWith(const LosslessJpegDecoder& other) const
+		{
+			return info.imageWidth == other.info.imageWidth && info.compsInScan == other.info.compsInScan && info.Ss == other.info.Ss &&
+				!fBug16 && !other.fBug16 && info.compsInScan >= 1 && info.compsInScan <= 4;
+		}
+
+		// Decodes numROW rows of kInterleavedStreams decoders from their read positions to their spoolers, the first
+		// row being the first of an image or restart interval. A sample of each stream is decoded in turn, so the
+		// dependency chains of their Huffman decodes overlap. The rows must not cross restart markers.
+		static void DecodeInterleaved(LosslessJpegDecoder* const* ppDecoders, int32_t numROW)
+		{
+#define DECODE_INTERLEAVED_PSVS(comps) \
+			{ &LosslessJpegDecoder::DecodeInterleaved<comps, 0>, &LosslessJpegDecoder::DecodeInterleaved<comps, 1>, \
+			  &LosslessJpegDecoder::DecodeInterleaved<comps, 2>, &LosslessJpegDecoder::DecodeInterleaved<comps, 3>, \
+			  &LosslessJpegDecoder::DecodeInterleaved<comps, 4>, &LosslessJpegDecoder::DecodeInterleaved<comps, 5>, \
+			  &LosslessJpegDecoder::DecodeInterleaved<comps, 6>, &LosslessJpegDecoder::DecodeInterleaved<comps, 7> }
+
+			static const DecodeInterleavedFunction decodeInterleavedFunctions[4][8] =
+			{
+				DECODE_INTERLEAVED_PSVS(1), DECODE_INTERLEAVED_PSVS(2), DECODE_INTERLEAVED_PSVS(3), DECODE_INTERLEAVED_PSVS(4)
+			};
+
+#undef DECODE_INTERLEAVED_PSVS
+
+			const auto& info = ppDecoders[0]->info;
+			const int32_t psv = (info.Ss >= 1 && info.Ss <= 7) ? info.Ss : 0;
+			decodeInterleavedFunctions[info.compsInScan - 1][psv](ppDecoders, numROW);
+		}
+
+		// Decodes numROW rows from the start of a scan without restart markers, or from a checkpoint: the bit position
+		// of a row and the row above it
+		void DecodeRows(DecoderOutput* spooler, int32_t numROW, uint64_t bitPosition = 0, const uint16_t* pPrevRow = nullptr)
+		{
+			fSpooler = spooler;
+			SetBitPosition(bitPosition);
+
+			if (!pPrevRow)
+			{
+				DecodeImage(numROW);
+				return;
+			}
+
+#define DECODE_ROWS_AFTER_PSVS(comps, bug16) \
+			{ &LosslessJpegDecoder::DecodeRowsAfter<comps, 0, bug16>, &LosslessJpegDecoder::DecodeRowsAfter<comps, 1, bug16>, \
+			  &LosslessJpegDecoder::DecodeRowsAfter<comps, 2, bug16>, &LosslessJpegDecoder::DecodeRowsAfter<comps, 3, bug16>, \
+			  &LosslessJpegDecoder::DecodeRowsAfter<comps, 4, bug16>, &LosslessJpegDecoder::DecodeRowsAfter<comps, 5, bug16>, \
+			  &LosslessJpegDecoder::DecodeRowsAfter<comps, 6, bug16>, &LosslessJpegDecoder::DecodeRowsAfter<comps, 7, bug16> }
+
+			static const DecodeRowsAfterFunction decodeRowsAfterFunctions[2][4][8] =
+			{
+				{ DECODE_ROWS_AFTER_PSVS(1, false), DECODE_ROWS_AFTER_PSVS(2, false), DECODE_ROWS_AFTER_PSVS(3, false), DECODE_ROWS_AFTER_PSVS(4, false) },
+				{ DECODE_ROWS_AFTER_PSVS(1, true), DECODE_ROWS_AFTER_PSVS(2, true), DECODE_ROWS_AFTER_PSVS(3, true), DECODE_ROWS_AFTER_PSVS(4, true) }
+			};
+
+#undef DECODE_ROWS_AFTER_PSVS
+
+			const int32_t psv = (info.Ss >= 1 && info.Ss <= 7) ? info.Ss : 0;
+			(this->*decodeRowsAfterFunctions[fBug16 ? 1 : 0][info.compsInScan - 1][psv])(numROW, pPrevRow);
+		}
+
+		// Bits of the entropy coded segment decoded so far
+		uint64_t DecodedBits() const
+		{
+			return BitPosition();
+		}
+
+		// True if decoding consumed more data than the entropy coded segment holds
+		bool Overrun() const
+		{
+			return (fEntropyStream.Position() - bitsLeft / 8) > fSegment->size;
+		}
+
+		bool HasRestartMarkers() const
+		{
+			return info.restartInterval != 0;
+		}
+
+		// True if every component of the scan shares a Huffman table, so a decode stays in sync whatever
+		// component it takes the first symbol to be
+		bool SingleHuffmanTable() const
+		{
+			for (int32_t curComp = 1; curComp < info.compsInScan; curComp++)
+			{
+				if (info.curCompInfo[info.MCUmembership[curComp]]->dcTblNo != info.curCompInfo[info.MCUmembership[0]]->dcTblNo)
+					return false;
+			}
+			return true;
+		}
+
+		// Decodes the differences of a chunk from startBit, the first being of component chunk.phase, until a symbol
+		// ends at or after endBit. The positions of the first maxBoundaries symbols are recorded.
+		void DecodeChunk(sSpeculativeChunk& chunk, uint64_t startBit, uint64_t endBit, uint32_t maxBoundaries)
+		{
+			static const DecodeChunkFunction decodeChunkFunctions[2][4] =
+			{
+				{ &LosslessJpegDecoder::DecodeChunk<1, false>, &LosslessJpegDecoder::DecodeChunk<2, false>,
+				  &LosslessJpegDecoder::DecodeChunk<3, false>, &LosslessJpegDecoder::DecodeChunk<4, false> },
+				{ &LosslessJpegDecoder::DecodeChunk<1, true>, &LosslessJpegDecoder::DecodeChunk<2, true>,
+				  &LosslessJpegDecoder::DecodeChunk<3, true>, &LosslessJpegDecoder::DecodeChunk<4, true> }
+			};
+			(this->*decodeChunkFunctions[fBug16 ? 1 : 0][info.compsInScan - 1])(chunk, startBit, endBit, maxBoundaries);
+		}
+
+		// Continues the decode of chunk, which must be in sync, into next until both decodes reach the same
+		// symbol boundary with the same component. Returns the symbol of next they meet at, or false if they don't
+		// meet within next's recorded boundaries.
+		bool ExtendChunk(sSpeculativeChunk& chunk, const sSpeculativeChunk& next, uint64_t& syncSymbol)
+		{
+			static const ExtendChunkFunction extendChunkFunctions[2][4] =
+			{
+				{ &LosslessJpegDecoder::ExtendChunk<1, false>, &LosslessJpegDecoder::ExtendChunk<2, false>,
+				  &LosslessJpegDecoder::ExtendChunk<3, false>, &LosslessJpegDecoder::ExtendChunk<4, false> },
+				{ &LosslessJpegDecoder::ExtendChunk<1, true>, &LosslessJpegDecoder::ExtendChunk<2, true>,
+				  &LosslessJpegDecoder::ExtendChunk<3, true>, &LosslessJpegDecoder::ExtendChunk<4, true> }
+			};
+			return (this->*extendChunkFunctions[fBug16 ? 1 : 0][info.compsInScan - 1])(chunk, next, syncSymbol);
+		}
+
+		// Reconstructs the image from the in sync differences of every chunk, which must hold at least all samples
+		void ReconstructChunks(const sSpeculativeChunk* pChunks, uint32_t chunkCount)
+		{
+#define RECONSTRUCT_CHUNKS_PSVS(comps) \
+			{ &LosslessJpegDecoder::ReconstructChunks<comps, 0>, &LosslessJpegDecoder::ReconstructChunks<comps, 1>, \
+			  &LosslessJpegDecoder::ReconstructChunks<comps, 2>, &LosslessJpegDecoder::ReconstructChunks<comps, 3>, \
+			  &LosslessJpegDecoder::ReconstructChunks<comps, 4>, &LosslessJpegDecoder::ReconstructChunks<comps, 5>, \
+			  &LosslessJpegDecoder::ReconstructChunks<comps, 6>, &LosslessJpegDecoder::ReconstructChunks<comps, 7> }
+
+			static const ReconstructChunksFunction reconstructChunksFunctions[4][8] =
+			{
+				RECONSTRUCT_CHUNKS_PSVS(1), RECONSTRUCT_CHUNKS_PSVS(2), RECONSTRUCT_CHUNKS_PSVS(3), RECONSTRUCT_CHUNKS_PSVS(4)
+			};
+
+#undef RECONSTRUCT_CHUNKS_PSVS
+
+			const int32_t psv = (info.Ss >= 1 && info.Ss <= 7) ? info.Ss : 0;
+			(this->*reconstructChunksFunctions[info.compsInScan - 1][psv])(pChunks, chunkCount);
 		}
 
-		FORCE_INLINE void UnGetJpegChar()
+	private:
+
+		FORCE_INLINE uint8_t GetJpegChar()
 		{
-			fStream->SetReadPosition(fStream->Position() - 1);
+			return fStream->Get_uint8();
 		}
 
 		FORCE_INLINE uint16_t Get2bytes()
@@ -810,31 +1384,7 @@ namespace Octopus::Player::Decoders::Jpeg
 				info.MCUmembership[ci] = (int16_t)ci;
 			}
 
-			// Initialize mucROW1 and mcuROW2 which buffer two rows of
-			// pixels for predictor calculation.
-
-			// This multiplication cannot overflow because info.compsInScan is
-			// guaranteed to be between 0 and 4 inclusive (see checks above).
-
-			int32_t mcuSize = info.compsInScan * (uint32_t)sizeof(ComponentType);
-
-			mcuBuffer1.Allocate(info.imageWidth, sizeof(MCU));
-			mcuBuffer2.Allocate(info.imageWidth, sizeof(MCU));
-
-			mcuROW1 = (MCU*)mcuBuffer1.Buffer();
-			mcuROW2 = (MCU*)mcuBuffer2.Buffer();
-
-			mcuBuffer3.Allocate(info.imageWidth, mcuSize);
-			mcuBuffer4.Allocate(info.imageWidth, mcuSize);
-
-			mcuROW1[0] = (ComponentType*)mcuBuffer3.Buffer();
-			mcuROW2[0] = (ComponentType*)mcuBuffer4.Buffer();
-
-			for (int32_t j = 1; j < info.imageWidth; j++)
-			{
-				mcuROW1[j] = mcuROW1[j - 1] + info.compsInScan;
-				mcuROW2[j] = mcuROW2[j - 1] + info.compsInScan;
-			}
+			// Rows are decoded straight into the output, no row buffers needed.
 		}
 
 		void HuffDecoderInit()
@@ -862,97 +1412,109 @@ namespace Octopus::Player::Decoders::Jpeg
 				// Compute derived values for Huffman tables.
 				// We may do this more than once for same table, but it's not a
 				// big deal
-				FixHuffTbl(info.dcHuffTblPtrs[compptr->dcTblNo]);
+				FixHuffTbl(info.dcHuffTblPtrs[compptr->dcTblNo], fBug16);
 			}
 
 			// Initialize restart stuff
 			info.restartInRows = info.restartInterval / info.imageWidth;
 			info.restartRowsToGo = info.restartInRows;
 			info.nextRestartNum = 0;
+			info.nextRestartInterval = 1;
+		}
+
+		void EntropyDecoderInit(const sEntropyCodedSegment* pSharedSegment)
+		{
+			if (pSharedSegment)
+			{
+				fSegment = pSharedSegment;
+			}
+			else
+			{
+				// Unstuff everything after the scan header
+				const auto position = fStream->Position();
+				const auto size = fStream->Size() > position ? fStream->Size() - position : 0;
+
+				// Room for every restart interval the scan header implies
+				const auto restartRows = info.restartInRows > 0 ? info.restartInRows : info.imageHeight;
+				const auto maxIntervals = (uint32_t)std::max(1, (info.imageHeight + restartRows - 1) / restartRows);
+				intervalBuffer.Allocate(maxIntervals, sizeof(uint64_t));
+				segment.pIntervalPositions = (uint64_t*)intervalBuffer.Buffer();
+
+				entropyBuffer.Allocate(size + LOSSLESS_ENTROPY_PADDING_BYTES);
+				UnstuffEntropyCodedSegment(fStream->Data() + position, size, entropyBuffer.Buffer(), maxIntervals, segment);
+
+				fSegment = &segment;
+			}
+
+			fEntropyStream = DecoderInput((uint8_t*)fSegment->pData, fSegment->size);
 		}
 
 		FORCE_INLINE void ProcessRestart()
 		{
 			// Throw away and unused odd bits in the bit buffer.
-			fStream->SetReadPosition(fStream->Position() - bitsLeft / 8);
-
 			bitsLeft = 0;
 			getBuffer = 0;
 
-			// Scan for next JPEG marker
-			int32_t c;
-
-			do
+			// Continue from the start of the next interval recorded by the unstuffing prepass
+			if (info.nextRestartInterval < (int32_t)fSegment->intervalCount)
 			{
-				// skip any non-FF bytes
-				do
-				{
-					c = GetJpegChar();
-				} while (c != 0xFF);
-
-				// skip any duplicate FFs
-				do
-				{
-					c = GetJpegChar();
-				} while (c == 0xFF);
-
-			} while (c == 0);		// repeat if it was a stuffed FF/00
-
-			// Verify correct restart code.
-			if (c != (M_RST0 + info.nextRestartNum))
+				fEntropyStream.SetReadPosition(fSegment->pIntervalPositions[info.nextRestartInterval]);
+			}
+			else
 			{
+				// Missing restart marker
 				ThrowBadFormat();
 			}
 
 			// Update restart state.
 			info.restartRowsToGo = info.restartInRows;
 			info.nextRestartNum = (info.nextRestartNum + 1) & 7;
+			info.nextRestartInterval++;
 		}
 
-		FORCE_INLINE void FillBitBuffer(int32_t nbits)
+		// Word at a time refill, tops the bit buffer up to 56-63 bits with a single load.
+		// The segment has been unstuffed, so there are no 0xFF bytes or markers to check for. Past its end
+		// come LOSSLESS_ENTROPY_PADDING_BYTES of zeroes, and truncated or corrupt data that reads beyond
+		// them is fed zeroes without loading, while the position keeps advancing for Overrun to report.
+		FORCE_INLINE void FillBitBuffer()
 		{
-			const int32_t kMinGetBits = sizeof(uint32_t) * 8 - 7;
-
-			while (bitsLeft < kMinGetBits)
-			{
-				int32_t c = GetJpegChar();
-
-				// If it's 0xFF, check and discard stuffed zero byte
-				if (c == 0xFF)
-				{
-					int32_t c2 = GetJpegChar();
+			const int32_t bytes = (int32_t)(sizeof(getBuffer) * 8 - 1 - bitsLeft) >> 3;
+			const int32_t refillBits = bytes * 8;
+			const bool inPadding = fEntropyStream.Position() + sizeof(uint64_t) <= fEntropyStream.Size() + LOSSLESS_ENTROPY_PADDING_BYTES;
+			const uint64_t word = inPadding ? fEntropyStream.Peek_uint64() : 0;
+
+			getBuffer = (getBuffer << refillBits) | (word >> (64 - refillBits));
+			bitsLeft += refillBits;
+			fEntropyStream.Skip(bytes);
+		}
 
-					if (c2 != 0)
-					{
-						// Oops, it's actually a marker indicating end of
-						// compressed data.  Better put it back for use later.
-						UnGetJpegChar();
-						UnGetJpegChar();
-
-						// There should be enough bits still left in the data
-						// segment; if so, just break out of the while loop.
-						if (bitsLeft >= nbits)
-							break;
-
-						// Uh-oh.  Corrupted data: stuff zeroes into the data
-						// stream, since this sometimes occurs when we are on the
-						// last show_bits8 during decoding of the Huffman
-						// segment.
-						c = 0;
-					}
-				}
+		// Bits of the entropy coded segment consumed so far
+		FORCE_INLINE uint64_t BitPosition() const
+		{
+			return fEntropyStream.Position() * 8 - bitsLeft;
+		}
 
-				getBuffer = (getBuffer << 8) | c;
-				bitsLeft += 8;
+		// Positions past the end of the segment, from a corrupt checkpoint index, are kept just past it, so the
+		// decode reads zeroes and Overrun reports it
+		void SetBitPosition(uint64_t position)
+		{
+			position = std::min(position, (fSegment->size + 1) * 8);
+			fEntropyStream.SetReadPosition(position / 8);
+			getBuffer = 0;
+			bitsLeft = 0;
+			if (position % 8)
+			{
+				FillBitBuffer();
+				flush_bits((int32_t)(position % 8));
 			}
 		}
 
-		FORCE_INLINE int32_t show_bits8()
+		FORCE_INLINE int32_t show_bits16()
 		{
-			if (bitsLeft < 8)
-				FillBitBuffer(8);
+			if (bitsLeft < 16)
+				FillBitBuffer();
 
-			return (int32_t)((getBuffer >> (bitsLeft - 8)) & 0xff);
+			return (int32_t)((getBuffer >> (bitsLeft - 16)) & 0xffff);
 		}
 
 		FORCE_INLINE void flush_bits(int32_t nbits)
@@ -968,55 +1530,34 @@ namespace Octopus::Player::Decoders::Jpeg
 			}
 
 			if (bitsLeft < nbits)
-				FillBitBuffer(nbits);
+				FillBitBuffer();
 
 			return (int32_t)((getBuffer >> (bitsLeft -= nbits)) & (0x0FFFF >> (16 - nbits)));
 		}
 
-		FORCE_INLINE int32_t get_bit()
+		// Decodes a code longer than the lookup table index, returns its category.
+		// The leading one bits give the first candidate length, the remaining
+		// lengths are found by comparing against the left justified code limits.
+		FORCE_INLINE int32_t HuffDecodeLong(sHuffmanTable* htbl, int32_t code16)
 		{
-			if (!bitsLeft)
-				FillBitBuffer(1);
+			const int32_t leadingOnes = CountLeadingZeros(~((uint32_t)code16 << 16));
 
-			return (int32_t)((getBuffer >> (--bitsLeft)) & 1);
-		}
+			int32_t l = htbl->longStart[leadingOnes];
 
-		FORCE_INLINE int32_t HuffDecode(sHuffmanTable* htbl)
-		{
-			// If the huffman code is less than 8 bits, we can use the fast
-			// table lookup to get its value.  It's more than 8 bits about
-			// 3-4% of the time.
-			int32_t code = show_bits8();
+			while (code16 > htbl->limit[l])
+				l++;
 
-			if (htbl->numbits[code])
+			// With garbage input we may reach the sentinel value l = 17.
+			if (l > 16)
 			{
-				flush_bits(htbl->numbits[code]);
-
-				return htbl->value[code];
+				flush_bits(16);
+				return 0;		// fake a zero as the safest result
 			}
-			else
-			{
-				flush_bits(8);
-
-				int32_t l = 8;
 
-				while (code > htbl->maxcode[l])
-				{
-					code = (code << 1) | get_bit();
-					l++;
-				}
+			flush_bits(l);
 
-				// With garbage input we may reach the sentinel value l = 17.
-				if (l > 16)
-				{
-					return 0;		// fake a zero as the safest result
-				}
-				else
-				{
-					return htbl->huffval[htbl->valptr[l] +
-						((int32_t)(code - htbl->mincode[l]))];
-				}
-			}
+			return htbl->huffval[htbl->valptr[l] +
+				((int32_t)((code16 >> (16 - l)) - htbl->mincode[l]))];
 		}
 
 #ifdef __clang__
@@ -1030,87 +1571,244 @@ namespace Octopus::Player::Decoders::Jpeg
 			}
 		}
 
-		FORCE_INLINE void PmPutRow(MCU* buf, int32_t numComp, int32_t numCol, int32_t row)
+		// Section F.2.2.1: decodes the difference for the given category
+		template <bool kBug16>
+		FORCE_INLINE int32_t ExtendDifference(int32_t s)
 		{
-			uint16_t* sPtr = &buf[0][0];
+			if (s == 0)
+				return 0;
 
-			uint32_t pixels = numCol * numComp;
+			if (s > 16)
+			{
+				ThrowBadFormat();
+				return 0;
+			}
 
-			fSpooler->Spool(sPtr, pixels * (uint32_t)sizeof(uint16_t));
+			if (s == 16 && !kBug16)
+				return -32768;
+
+			int32_t d = get_bits(s);
+			HuffExtend(d, s);
+			return d;
 		}
 
-		FORCE_INLINE void DecodeFirstRow(MCU* curRowBuf)
+		// Decodes the next difference.
+		// Short codes (and their extra bits) are fully resolved by a single table lookup.
+		template <bool kBug16>
+		FORCE_INLINE int32_t HuffDecodeDifference(sHuffmanTable* htbl)
 		{
-			int32_t compsInScan = info.compsInScan;
+			const int32_t code16 = show_bits16();
+			const int32_t entry = htbl->lookup[code16 >> (16 - kHuffLookupBits)];
+			const int32_t length = entry & kHuffLookupLengthMask;
 
-			// Process the first column in the row.
-			for (int32_t curComp = 0; curComp < compsInScan; curComp++)
+			if (entry & kHuffLookupResolved)
 			{
-				int32_t ci = info.MCUmembership[curComp];
+				flush_bits(length);
+				return entry >> kHuffLookupDiffShift;
+			}
 
-				sJpegComponentInfo* compptr = info.curCompInfo[ci];
+			int32_t s;
+
+			if (length)
+			{
+				flush_bits(length);
+				s = (entry >> kHuffLookupCategoryShift) & kHuffLookupLengthMask;
+			}
+			else
+			{
+				s = HuffDecodeLong(htbl, code16);
+			}
+
+			return ExtendDifference<kBug16>(s);
+		}
+
+		// Section H.1.2.1: predictor for the selection value (PSV), 0 for an invalid PSV
+		template <int32_t kPsv>
+		static FORCE_INLINE int32_t Predict(int32_t left, int32_t upper, int32_t diag)
+		{
+			switch (kPsv)
+			{
+			case 1:
+				return left;
+			case 2:
+				return upper;
+			case 3:
+				return diag;
+			case 4:
+				return left + upper - diag;
+			case 5:
+				return left + ((upper - diag) >> 1);
+			case 6:
+				return upper + ((left - diag) >> 1);
+			case 7:
+				return (left + upper) >> 1;
+			default:
+				return 0;
+			}
+		}
 
-				sHuffmanTable* dctbl = info.dcHuffTblPtrs[compptr->dcTblNo];
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+		// Adds every lane to the lanes kShift, 2 * kShift, ... above it, a running sum for each of kShift interleaved components
+		template <int32_t kShift>
+		static FORCE_INLINE __m128i PrefixSum(__m128i v)
+		{
+			v = _mm_add_epi16(v, _mm_slli_si128(v, kShift * 2));
+			if constexpr (kShift * 2 < 8)
+				return PrefixSum<kShift * 2>(v);
+			else
+				return v;
+		}
 
-				// Section F.2.2.1: decode the difference
-				int32_t d = 0;
-				int32_t s = HuffDecode(dctbl);
+		// Repeats the first kComps lanes across the vector
+		template <int32_t kComps, int32_t kShift = kComps>
+		static FORCE_INLINE __m128i RepeatLanes(__m128i v)
+		{
+			if constexpr (kShift == kComps)
+				v = _mm_and_si128(v, _mm_srli_si128(_mm_set1_epi16(-1), (8 - kComps) * 2));
+			v = _mm_or_si128(v, _mm_slli_si128(v, kShift * 2));
+			if constexpr (kShift * 2 < 8)
+				return RepeatLanes<kComps, kShift * 2>(v);
+			else
+				return v;
+		}
 
-				if (s)
+		// Reconstructs samples [x, numSamples) eight at a time, returns the first sample left over.
+		// PSV 2 and 3 are a vertical add. PSV 1, 4 and 5 are a running sum of the difference plus a term
+		// from the row above, which is linear modulo 2^16 so it is computed as a prefix sum.
+		template <int32_t kComps, int32_t kPsv>
+		static FORCE_INLINE int32_t ReconstructSamplesSimd(ComponentType* pOut, const ComponentType* pUpper, const int16_t* pDiff, int32_t x, int32_t numSamples)
+		{
+			if constexpr (kPsv == 2 || kPsv == 3)
+			{
+				const ComponentType* pPredictor = (kPsv == 2) ? pUpper : pUpper - kComps;
+				for (; x + 8 <= numSamples; x += 8)
 				{
-					if (s == 16 && !fBug16)
-					{
-						d = -32768;
-					}
-					else
+					const __m128i d = _mm_loadu_si128((const __m128i*)(pDiff + x));
+					const __m128i predictor = _mm_loadu_si128((const __m128i*)(pPredictor + x));
+					_mm_storeu_si128((__m128i*)(pOut + x), _mm_add_epi16(d, predictor));
+				}
+			}
+			else if constexpr (kPsv == 1 || kPsv == 4 || kPsv == 5)
+			{
+				if (x + 8 > numSamples)
+					return x;
+
+				// The previous sample of each component, repeated across the lanes
+				__m128i left = RepeatLanes<kComps>(_mm_loadu_si128((const __m128i*)(pOut + x - kComps)));
+				const __m128i one = _mm_set1_epi16(1);
+
+				for (; x + 8 <= numSamples; x += 8)
+				{
+					__m128i e = _mm_loadu_si128((const __m128i*)(pDiff + x));
+					if constexpr (kPsv == 4 || kPsv == 5)
 					{
-						d = get_bits(s);
-						HuffExtend(d, s);
+						const __m128i upper = _mm_loadu_si128((const __m128i*)(pUpper + x));
+						const __m128i diag = _mm_loadu_si128((const __m128i*)(pUpper + x - kComps));
+						if constexpr (kPsv == 4)
+						{
+							e = _mm_add_epi16(e, _mm_sub_epi16(upper, diag));
+						}
+						else
+						{
+							// (upper - diag) >> 1 without leaving 16 bits
+							const __m128i borrow = _mm_and_si128(_mm_andnot_si128(upper, diag), one);
+							e = _mm_add_epi16(e, _mm_sub_epi16(_mm_sub_epi16(_mm_srli_epi16(upper, 1), _mm_srli_epi16(diag, 1)), borrow));
+						}
 					}
+
+					const __m128i out = _mm_add_epi16(PrefixSum<kComps>(e), left);
+					_mm_storeu_si128((__m128i*)(pOut + x), out);
+					left = RepeatLanes<kComps>(_mm_srli_si128(out, (8 - kComps) * 2));
 				}
+			}
+			return x;
+		}
+#endif
+
+		// Stage two of a row: the first column is predicted from above (or from pSeed on the first row),
+		// the rest of the row by the PSV.
+		template <int32_t kComps, int32_t kPsv>
+		static FORCE_INLINE void ReconstructRow(ComponentType* pOut, const ComponentType* pUpper, const int16_t* pDiff, int32_t numCOL, const int32_t* pSeed = nullptr)
+		{
+			const int32_t numSamples = numCOL * kComps;
+
+			for (int32_t x = 0; x < kComps; x++)
+				pOut[x] = (ComponentType)((pSeed ? pSeed[x] : pUpper[x]) + pDiff[x]);
 
-				// Add the predictor to the difference.
-				int32_t Pr = info.dataPrecision;
-				int32_t Pt = info.Pt;
+			int32_t x = kComps;
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+			x = ReconstructSamplesSimd<kComps, kPsv>(pOut, pUpper, pDiff, x, numSamples);
+#endif
+			for (; x < numSamples; x++)
+			{
+				const int32_t upper = (kPsv == 1) ? 0 : pUpper[x];
+				const int32_t diag = (kPsv == 1) ? 0 : pUpper[x - kComps];
+				pOut[x] = (ComponentType)(Predict<kPsv>(pOut[x - kComps], upper, diag) + pDiff[x]);
+			}
+		}
 
-				curRowBuf[0][curComp] = (ComponentType)(d + (1 << (Pr - Pt - 1)));
+		// Stage one of a row: decodes the differences of every sample
+		template <int32_t kComps, bool kBug16>
+		FORCE_INLINE void DecodeDifferences(int16_t* pDiff, sHuffmanTable* const* ht, int32_t numCOL)
+		{
+			for (int32_t col = 0; col < numCOL; col++, pDiff += kComps)
+			{
+				for (int32_t curComp = 0; curComp < kComps; curComp++)
+					pDiff[curComp] = (int16_t)HuffDecodeDifference<kBug16>(ht[curComp]);
 			}
+		}
 
-			// Process the rest of the row.
-			int32_t numCOL = info.imageWidth;
+		// Decodes and reconstructs a row in a single pass, for predictors that can't be vectorised
+		template <int32_t kComps, int32_t kPsv, bool kBug16>
+		FORCE_INLINE void DecodeRowFused(ComponentType* pCurRow, const ComponentType* pPrevRow, sHuffmanTable* const* ht, int32_t numCOL)
+		{
+			// The upper neighbors are predictors for the first column.
+			for (int32_t curComp = 0; curComp < kComps; curComp++)
+				pCurRow[curComp] = (ComponentType)(HuffDecodeDifference<kBug16>(ht[curComp]) + pPrevRow[curComp]);
 
+			// For the rest of the column on this row, predictor
+			// calculations are based on PSV.
 			for (int32_t col = 1; col < numCOL; col++)
 			{
-				for (int32_t curComp = 0; curComp < compsInScan; curComp++)
+				const ComponentType* pUpper = pPrevRow + col * kComps;
+				const ComponentType* pLeft = pCurRow + (col - 1) * kComps;
+				ComponentType* pOut = pCurRow + col * kComps;
+
+				for (int32_t curComp = 0; curComp < kComps; curComp++)
 				{
-					int32_t ci = info.MCUmembership[curComp];
+					// Section F.2.2.1: decode the difference
+					const int32_t d = HuffDecodeDifference<kBug16>(ht[curComp]);
 
-					sJpegComponentInfo* compptr = info.curCompInfo[ci];
+					// Predict the pixel value.
+					const int32_t predictor = Predict<kPsv>(pLeft[curComp], pUpper[curComp], pUpper[curComp - kComps]);
 
-					sHuffmanTable* dctbl = info.dcHuffTblPtrs[compptr->dcTblNo];
+					// Save the difference.
+					pOut[curComp] = (ComponentType)(d + predictor);
+				}
+			}
+		}
 
-					// Section F.2.2.1: decode the difference
-					int32_t d = 0;
+		// Next output row to decode into
+		FORCE_INLINE ComponentType* PmNextRow(int32_t numComp, int32_t numCol)
+		{
+			uint32_t pixels = numCol * numComp;
 
-					int32_t s = HuffDecode(dctbl);
+			return fSpooler->NextRow(pixels * (uint32_t)sizeof(uint16_t));
+		}
 
-					if (s)
-					{
-						if (s == 16 && !fBug16)
-						{
-							d = -32768;
-						}
-						else
-						{
-							d = get_bits(s);
-							HuffExtend(d, s);
-						}
-					}
+		// Decodes the first row of the image (or of a restart interval), where the
+		// left neighbour is the only predictor.
+		template <int32_t kComps, bool kBug16>
+		FORCE_INLINE void DecodeFirstRow(ComponentType* pCurRow, int16_t* pDiff, sHuffmanTable* const* ht)
+		{
+			// The first column is predicted from the initial predictor, the rest from the left.
+			const int32_t initialPredictor = 1 << (info.dataPrecision - info.Pt - 1);
+			int32_t seeds[kComps];
+			for (int32_t curComp = 0; curComp < kComps; curComp++)
+				seeds[curComp] = initialPredictor;
 
-					// Add the predictor to the difference.
-					curRowBuf[col][curComp] = (ComponentType)(d + curRowBuf[col - 1][curComp]);
-				}
-			}
+			DecodeDifferences<kComps, kBug16>(pDiff, ht, info.imageWidth);
+			ReconstructRow<kComps, 1>(pCurRow, nullptr, pDiff, info.imageWidth, seeds);
 
 			// Update the restart counter
 			if (info.restartInRows)
@@ -1119,21 +1817,19 @@ namespace Octopus::Player::Decoders::Jpeg
 			}
 		}
 
-#define swap(type,a,b) {type c; c=(a); (a)=(b); (b)=c;}
-
-        void DecodeImage2ComponentsPredictor7()
-        {
-            int32_t numCOL = info.imageWidth;
-			int32_t numROW = info.imageHeight;
-			const int32_t compsInScan = 2;
-            assert(info.compsInScan == compsInScan);
+		// Decodes numROW rows from the current read position, the first row is predicted
+		// as the first row of the image (or of a restart interval).
+		// Specialised for every component count, PSV and "16-bit" bug combination so the
+		// per sample component loop and predictor selection are resolved at compile time.
+		template <int32_t kComps, int32_t kPsv, bool kBug16>
+		void DecodeImage(int32_t numROW)
+		{
+			const int32_t numCOL = info.imageWidth;
 
 			// Precompute the decoding table for each table.
-			sHuffmanTable* ht[4];
+			sHuffmanTable* ht[kComps];
 
-			memset(ht, 0, sizeof(ht));
-
-			for (int32_t curComp = 0; curComp < compsInScan; curComp++)
+			for (int32_t curComp = 0; curComp < kComps; curComp++)
 			{
 				int32_t ci = info.MCUmembership[curComp];
 
@@ -1142,18 +1838,18 @@ namespace Octopus::Player::Decoders::Jpeg
 				ht[curComp] = info.dcHuffTblPtrs[compptr->dcTblNo];
 			}
 
-			MCU* prevRowBuf = mcuROW1;
-			MCU* curRowBuf = mcuROW2;
-
-			// Decode the first row of image. Output the row and
-			// turn this row into a previous row for later predictor
-			// calculation.
-			DecodeFirstRow(mcuROW1);
-			PmPutRow(mcuROW1, compsInScan, numCOL, 0);
+			// Each row's differences are decoded first, then the row is reconstructed straight into
+			// the output, keeping the predictor arithmetic off the Huffman decoding dependency chain.
+			// The previous output row is the upper predictor for the next.
+			int16_t* pDiff = (int16_t*)diffBuffer.Buffer();
+			ComponentType* pPrevRow = PmNextRow(kComps, numCOL);
+			DecodeFirstRow<kComps, kBug16>(pPrevRow, pDiff, ht);
 
 			// Process each row.
 			for (int32_t row = 1; row < numROW; row++)
 			{
+				ComponentType* pCurRow = PmNextRow(kComps, numCOL);
+
 				// Account for restart interval, process restart marker if needed.
 				if (info.restartInRows)
 				{
@@ -1162,11 +1858,9 @@ namespace Octopus::Player::Decoders::Jpeg
 						ProcessRestart();
 
 						// Reset predictors at restart.
-						DecodeFirstRow(curRowBuf);
-
-						PmPutRow(curRowBuf, compsInScan, numCOL, row);
+						DecodeFirstRow<kComps, kBug16>(pCurRow, pDiff, ht);
 
-						swap(MCU*, prevRowBuf, curRowBuf);
+						pPrevRow = pCurRow;
 
 						continue;
 					}
@@ -1174,325 +1868,279 @@ namespace Octopus::Player::Decoders::Jpeg
 					info.restartRowsToGo--;
 				}
 
-				// The upper neighbors are predictors for the first column.
+				if constexpr (kPsv >= 1 && kPsv <= 5)
 				{
-                    const int32_t curComp = 0;
-					// Section F.2.2.1: decode the difference
-					int32_t d = 0;
-					int32_t s = HuffDecode(ht[curComp]);
-
-					if (s)
-					{
-						if (s == 16 && !fBug16)
-						{
-							d = -32768;
-						}
-						else
-						{
-							d = get_bits(s);
-							HuffExtend(d, s);
-						}
-					}
-
-					// First column of row above is predictor for first column.
-					curRowBuf[0][curComp] = (ComponentType)(d + prevRowBuf[0][curComp]);
+					DecodeDifferences<kComps, kBug16>(pDiff, ht, numCOL);
+					ReconstructRow<kComps, kPsv>(pCurRow, pPrevRow, pDiff, numCOL);
 				}
-                {
-                    const int32_t curComp = 1;
-					// Section F.2.2.1: decode the difference
-					int32_t d = 0;
-					int32_t s = HuffDecode(ht[curComp]);
-
-					if (s)
-					{
-						if (s == 16 && !fBug16)
-						{
-							d = -32768;
-						}
-						else
-						{
-							d = get_bits(s);
-							HuffExtend(d, s);
-						}
-					}
-
-					// First column of row above is predictor for first column.
-					curRowBuf[0][curComp] = (ComponentType)(d + prevRowBuf[0][curComp]);
+				else
+				{
+					// PSV 6 and 7 are non linear in the left neighbour, so there is no vector form
+					// and a separate reconstruction pass would only add memory traffic.
+					DecodeRowFused<kComps, kPsv, kBug16>(pCurRow, pPrevRow, ht, numCOL);
 				}
-                
-                for (int32_t col = 1; col < numCOL; col++)
-                {
-                    {
-                        const int32_t curComp = 0;
-                        // Section F.2.2.1: decode the difference
-                        int32_t d = 0;
-                        int32_t s = HuffDecode(ht[curComp]);
-
-                        if (s)
-                        {
-                            if (s == 16 && !fBug16)
-                            {
-                                d = -32768;
-                            }
-                            else
-                            {
-                                d = get_bits(s);
-                                HuffExtend(d, s);
-                            }
-                        }
-
-                        // Predict the pixel value.
-                        const int32_t upper = prevRowBuf[col][curComp];
-                        const int32_t left = curRowBuf[col - 1][curComp];
-                        int32_t predictor = (left + upper) >> 1;
-                        
-                        // Save the difference.
-                        curRowBuf[col][curComp] = (ComponentType)(d + predictor);
-                    }
-                    {
-                        const int32_t curComp = 1;
-                        // Section F.2.2.1: decode the difference
-                        int32_t d = 0;
-                        int32_t s = HuffDecode(ht[curComp]);
-
-                        if (s)
-                        {
-                            if (s == 16 && !fBug16)
-                            {
-                                d = -32768;
-                            }
-                            else
-                            {
-                                d = get_bits(s);
-                                HuffExtend(d, s);
-                            }
-                        }
-
-                        // Predict the pixel value.
-                        const int32_t upper = prevRowBuf[col][curComp];
-                        const int32_t left = curRowBuf[col - 1][curComp];
-                        int32_t predictor = (left + upper) >> 1;
-                        
-                        // Save the difference.
-                        curRowBuf[col][curComp] = (ComponentType)(d + predictor);
-                    }
-                }
-				
-
-				PmPutRow(curRowBuf, compsInScan, numCOL, row);
-				swap(MCU*, prevRowBuf, curRowBuf);
+
+				pPrevRow = pCurRow;
 			}
-        }
+		}
 
-		void DecodeImage()
+		// Huffman table of each component of the scan
+		template <int32_t kComps>
+		FORCE_INLINE void ScanTables(sHuffmanTable** ht)
 		{
-			int32_t numCOL = info.imageWidth;
-			int32_t numROW = info.imageHeight;
-			int32_t compsInScan = info.compsInScan;
-   
-            if ( compsInScan == 2 && info.Ss == 7 )
-            {
-                DecodeImage2ComponentsPredictor7();
-                return;
-            }
+			for (int32_t curComp = 0; curComp < kComps; curComp++)
+				ht[curComp] = info.dcHuffTblPtrs[info.curCompInfo[info.MCUmembership[curComp]]->dcTblNo];
+		}
 
-			// Precompute the decoding table for each table.
+		// Room for at least count more differences
+		static FORCE_INLINE int16_t* ReserveDifferences(sSpeculativeChunk& chunk, uint64_t count)
+		{
+			if (chunk.count + count > chunk.differences.size())
+				chunk.differences.resize(std::max<uint64_t>(chunk.differences.size() * 2, chunk.count + count + 4096));
+			return chunk.differences.data() + chunk.count;
+		}
 
-			sHuffmanTable* ht[4];
+		template <int32_t kComps, bool kBug16>
+		void DecodeChunk(sSpeculativeChunk& chunk, uint64_t startBit, uint64_t endBit, uint32_t maxBoundaries)
+		{
+			sHuffmanTable* ht[kComps];
+			ScanTables<kComps>(ht);
 
-			memset(ht, 0, sizeof(ht));
+			SetBitPosition(startBit);
+			chunk.count = 0;
+			chunk.boundaries.clear();
+			uint64_t position = startBit;
+			int32_t comp = (int32_t)chunk.phase;
 
-			for (int32_t curComp = 0; curComp < compsInScan; curComp++)
+			// Symbols the previous chunk can synchronise with
+			while (position < endBit && chunk.boundaries.size() < maxBoundaries)
 			{
-				int32_t ci = info.MCUmembership[curComp];
-
-				sJpegComponentInfo* compptr = info.curCompInfo[ci];
+				chunk.boundaries.push_back(position);
+				*ReserveDifferences(chunk, 1) = (int16_t)HuffDecodeDifference<kBug16>(ht[comp]);
+				chunk.count++;
+				comp = (comp + 1 == kComps) ? 0 : comp + 1;
+				position = BitPosition();
+			}
 
-				ht[curComp] = info.dcHuffTblPtrs[compptr->dcTblNo];
+			// The rest a whole pixel at a time, once aligned to the first component
+			while (position < endBit)
+			{
+				auto pDiff = ReserveDifferences(chunk, kComps);
+				if (comp == 0)
+				{
+					for (int32_t curComp = 0; curComp < kComps; curComp++)
+						pDiff[curComp] = (int16_t)HuffDecodeDifference<kBug16>(ht[curComp]);
+					chunk.count += kComps;
+				}
+				else
+				{
+					*pDiff = (int16_t)HuffDecodeDifference<kBug16>(ht[comp]);
+					chunk.count++;
+					comp = (comp + 1 == kComps) ? 0 : comp + 1;
+				}
+				position = BitPosition();
 			}
 
-			MCU* prevRowBuf = mcuROW1;
-			MCU* curRowBuf = mcuROW2;
+			chunk.stopBit = position;
+		}
 
-			// Decode the first row of image. Output the row and
-			// turn this row into a previous row for later predictor
-			// calculation.
-			DecodeFirstRow(mcuROW1);
-			PmPutRow(mcuROW1, compsInScan, numCOL, 0);
+		template <int32_t kComps, bool kBug16>
+		bool ExtendChunk(sSpeculativeChunk& chunk, const sSpeculativeChunk& next, uint64_t& syncSymbol)
+		{
+			sHuffmanTable* ht[kComps];
+			ScanTables<kComps>(ht);
 
-			// Process each row.
-			for (int32_t row = 1; row < numROW; row++)
+			uint64_t position = chunk.stopBit;
+			SetBitPosition(position);
+			int32_t comp = (int32_t)((chunk.phase + chunk.count) % kComps);
+
+			const bool singleTable = SingleHuffmanTable();
+			const auto& boundaries = next.boundaries;
+			auto symbol = (uint64_t)(std::lower_bound(boundaries.begin(), boundaries.end(), position) - boundaries.begin());
+			while (symbol < boundaries.size())
 			{
-				// Account for restart interval, process restart marker if needed.
-				if (info.restartInRows)
+				if (boundaries[symbol] == position && (singleTable || (next.phase + symbol) % kComps == (uint64_t)comp))
 				{
-					if (info.restartRowsToGo == 0)
-					{
-						ProcessRestart();
+					chunk.stopBit = position;
+					syncSymbol = symbol;
+					return true;
+				}
 
-						// Reset predictors at restart.
-						DecodeFirstRow(curRowBuf);
+				*ReserveDifferences(chunk, 1) = (int16_t)HuffDecodeDifference<kBug16>(ht[comp]);
+				chunk.count++;
+				comp = (comp + 1 == kComps) ? 0 : comp + 1;
+				position = BitPosition();
 
-						PmPutRow(curRowBuf, compsInScan, numCOL, row);
+				while (symbol < boundaries.size() && boundaries[symbol] < position)
+					symbol++;
+			}
 
-						swap(MCU*, prevRowBuf, curRowBuf);
+			chunk.stopBit = position;
+			return false;
+		}
 
-						continue;
-					}
+		template <int32_t kComps, int32_t kPsv>
+		void ReconstructChunks(const sSpeculativeChunk* pChunks, uint32_t chunkCount)
+		{
+			const int32_t numCOL = info.imageWidth;
+			const uint64_t rowSamples = (uint64_t)numCOL * kComps;
 
-					info.restartRowsToGo--;
-				}
+			const int32_t initialPredictor = 1 << (info.dataPrecision - info.Pt - 1);
+			int32_t seeds[kComps];
+			for (int32_t curComp = 0; curComp < kComps; curComp++)
+				seeds[curComp] = initialPredictor;
 
-				// The upper neighbors are predictors for the first column.
-				for (int32_t curComp = 0; curComp < compsInScan; curComp++)
+			// Rows are read straight from the chunks, apart from the few that start in one chunk and end in the next
+			int16_t* pRowDiff = (int16_t*)diffBuffer.Buffer();
+			uint32_t chunk = 0;
+			uint64_t offset = pChunks[0].validStart;
+
+			ComponentType* pPrevRow = nullptr;
+			for (int32_t row = 0; row < info.imageHeight; row++)
+			{
+				while (offset >= pChunks[chunk].count && chunk + 1 < chunkCount)
 				{
-					// Section F.2.2.1: decode the difference
-					int32_t d = 0;
-					int32_t s = HuffDecode(ht[curComp]);
+					chunk++;
+					offset = pChunks[chunk].validStart;
+				}
 
-					if (s)
+				const int16_t* pDiff;
+				if (pChunks[chunk].count - offset >= rowSamples)
+				{
+					pDiff = pChunks[chunk].differences.data() + offset;
+					offset += rowSamples;
+				}
+				else
+				{
+					for (uint64_t copied = 0; copied < rowSamples; )
 					{
-						if (s == 16 && !fBug16)
+						while (offset >= pChunks[chunk].count)
 						{
-							d = -32768;
-						}
-						else
-						{
-							d = get_bits(s);
-							HuffExtend(d, s);
+							chunk++;
+							offset = pChunks[chunk].validStart;
 						}
+						const auto count = std::min(rowSamples - copied, pChunks[chunk].count - offset);
+						memcpy(pRowDiff + copied, pChunks[chunk].differences.data() + offset, count * sizeof(int16_t));
+						copied += count;
+						offset += count;
 					}
-
-					// First column of row above is predictor for first column.
-					curRowBuf[0][curComp] = (ComponentType)(d + prevRowBuf[0][curComp]);
+					pDiff = pRowDiff;
 				}
 
-				// For the rest of the column on this row, predictor
-				// calculations are based on PSV. 
-				if (compsInScan == 2 && info.Ss == 1 && numCOL > 1)
-				{
-					// This is the combination used by both the Canon and Kodak raw formats. 
-					// Unrolling the general case logic results in a significant speed increase.
-					uint16_t* dPtr = &curRowBuf[1][0];
+				ComponentType* pCurRow = PmNextRow(kComps, numCOL);
+				if (row == 0)
+					ReconstructRow<kComps, 1>(pCurRow, nullptr, pDiff, numCOL, seeds);
+				else
+					ReconstructRow<kComps, kPsv>(pCurRow, pPrevRow, pDiff, numCOL);
+				pPrevRow = pCurRow;
+			}
+		}
 
-					int32_t prev0 = dPtr[-2];
-					int32_t prev1 = dPtr[-1];
+		// Decodes numROW rows below pPrevRow, none of them the first of the image or of a restart interval
+		template <int32_t kComps, int32_t kPsv, bool kBug16>
+		void DecodeRowsAfter(int32_t numROW, const ComponentType* pPrevRow)
+		{
+			const int32_t numCOL = info.imageWidth;
 
-					for (int32_t col = 1; col < numCOL; col++)
-					{
-						int32_t s = HuffDecode(ht[0]);
+			sHuffmanTable* ht[kComps];
+			ScanTables<kComps>(ht);
 
-						if (s)
-						{
+			int16_t* pDiff = (int16_t*)diffBuffer.Buffer();
+			for (int32_t row = 0; row < numROW; row++)
+			{
+				ComponentType* pCurRow = PmNextRow(kComps, numCOL);
+				DecodeDifferences<kComps, kBug16>(pDiff, ht, numCOL);
+				ReconstructRow<kComps, kPsv>(pCurRow, pPrevRow, pDiff, numCOL);
+				pPrevRow = pCurRow;
+			}
+		}
+
+		// Decodes sample x, of component kComp, of stream kLane and the streams after it
+		template <int32_t kComps, int32_t kLane = 0>
+		static FORCE_INLINE void DecodeInterleavedSample(LosslessJpegDecoder* const* ppDecoders, sHuffmanTable* const (*ht)[kComps], int16_t* const* ppDiff,
+			int32_t x, int32_t comp)
+		{
+			ppDiff[kLane][x] = (int16_t)ppDecoders[kLane]->HuffDecodeDifference<false>(ht[kLane][comp]);
+			if constexpr (kLane + 1 < (int32_t)kInterleavedStreams)
+				DecodeInterleavedSample<kComps, kLane + 1>(ppDecoders, ht, ppDiff, x, comp);
+		}
 
-							int32_t d;
+		template <int32_t kComps, int32_t kPsv>
+		static void DecodeInterleaved(LosslessJpegDecoder* const* ppDecoders, int32_t numROW)
+		{
+			constexpr int32_t kLanes = (int32_t)kInterleavedStreams;
+			const int32_t numCOL = ppDecoders[0]->info.imageWidth;
+			const int32_t numSamples = numCOL * kComps;
+
+			sHuffmanTable* ht[kLanes][kComps];
+			int16_t* pDiff[kLanes];
+			ComponentType* pPrevRow[kLanes] = {};
+			int32_t seeds[kLanes][kComps];
+			for (int32_t lane = 0; lane < kLanes; lane++)
+			{
+				auto& decoder = *ppDecoders[lane];
+				decoder.ScanTables<kComps>(ht[lane]);
+				pDiff[lane] = (int16_t*)decoder.diffBuffer.Buffer();
+				for (int32_t curComp = 0; curComp < kComps; curComp++)
+					seeds[lane][curComp] = 1 << (decoder.info.dataPrecision - decoder.info.Pt - 1);
+			}
 
-							if (s == 16 && !fBug16)
-							{
-								d = -32768;
-							}
-							else
-							{
-								d = get_bits(s);
-								HuffExtend(d, s);
-							}
+			for (int32_t row = 0; row < numROW; row++)
+			{
+				for (int32_t x = 0; x < numSamples; x += kComps)
+				{
+					for (int32_t curComp = 0; curComp < kComps; curComp++)
+						DecodeInterleavedSample<kComps>(ppDecoders, ht, pDiff, x + curComp, curComp);
+				}
 
-							prev0 += d;
-						}
+				for (int32_t lane = 0; lane < kLanes; lane++)
+				{
+					ComponentType* pCurRow = ppDecoders[lane]->PmNextRow(kComps, numCOL);
+					if (row == 0)
+						ReconstructRow<kComps, 1>(pCurRow, nullptr, pDiff[lane], numCOL, seeds[lane]);
+					else
+						ReconstructRow<kComps, kPsv>(pCurRow, pPrevRow[lane], pDiff[lane], numCOL);
+					pPrevRow[lane] = pCurRow;
+				}
+			}
+		}
 
-						s = HuffDecode(ht[1]);
+		typedef void (*DecodeInterleavedFunction)(LosslessJpegDecoder* const* ppDecoders, int32_t numROW);
+		typedef void (LosslessJpegDecoder::*DecodeRowsAfterFunction)(int32_t numROW, const ComponentType* pPrevRow);
+		typedef void (LosslessJpegDecoder::*DecodeChunkFunction)(sSpeculativeChunk& chunk, uint64_t startBit, uint64_t endBit, uint32_t maxBoundaries);
+		typedef bool (LosslessJpegDecoder::*ExtendChunkFunction)(sSpeculativeChunk& chunk, const sSpeculativeChunk& next, uint64_t& syncSymbol);
+		typedef void (LosslessJpegDecoder::*ReconstructChunksFunction)(const sSpeculativeChunk* pChunks, uint32_t chunkCount);
 
-						if (s)
-						{
-							int32_t d;
-
-							if (s == 16 && !fBug16)
-							{
-								d = -32768;
-							}
-							else
-							{
-								d = get_bits(s);
-								HuffExtend(d, s);
-							}
-
-							prev1 += d;
-						}
+		typedef void (LosslessJpegDecoder::*DecodeImageFunction)(int32_t numROW);
 
-						dPtr[0] = (uint16_t)prev0;
-						dPtr[1] = (uint16_t)prev1;
+#define DECODE_IMAGE_PSVS(comps, bug16) \
+		{ &LosslessJpegDecoder::DecodeImage<comps, 0, bug16>, &LosslessJpegDecoder::DecodeImage<comps, 1, bug16>, \
+		  &LosslessJpegDecoder::DecodeImage<comps, 2, bug16>, &LosslessJpegDecoder::DecodeImage<comps, 3, bug16>, \
+		  &LosslessJpegDecoder::DecodeImage<comps, 4, bug16>, &LosslessJpegDecoder::DecodeImage<comps, 5, bug16>, \
+		  &LosslessJpegDecoder::DecodeImage<comps, 6, bug16>, &LosslessJpegDecoder::DecodeImage<comps, 7, bug16> }
 
-						dPtr += 2;
-					}
-				}
-				else
-				{
-					for (int32_t col = 1; col < numCOL; col++)
-					{
-						for (int32_t curComp = 0; curComp < compsInScan; curComp++)
-						{
-							// Section F.2.2.1: decode the difference
-							int32_t d = 0;
-							int32_t s = HuffDecode(ht[curComp]);
-
-							if (s)
-							{
-								if (s == 16 && !fBug16)
-								{
-									d = -32768;
-								}
-								else
-								{
-									d = get_bits(s);
-									HuffExtend(d, s);
-								}
-							}
-
-							// Predict the pixel value.
-                            int32_t predictor = 0;
-                            {
-                                const int32_t diag = prevRowBuf[col - 1][curComp];
-                                const int32_t upper = prevRowBuf[col][curComp];
-                                const int32_t left = curRowBuf[col - 1][curComp];
-
-                                switch (info.Ss)
-                                {
-                                case 1:
-                                    predictor = left;
-                                    break;
-                                case 2:
-                                    predictor = upper;
-                                    break;
-                                case 3:
-                                    predictor = diag;
-                                    break;
-                                case 4:
-                                    predictor = left + upper - diag;
-                                    break;
-                                case 5:
-                                    predictor = left + ((upper - diag) >> 1);
-                                    break;
-                                case 6:
-                                    predictor = upper + ((left - diag) >> 1);
-                                    break;
-                                case 7:
-                                    predictor = (left + upper) >> 1;
-                                    break;
-                                }
-                            }
-                            
-							// Save the difference.
-							curRowBuf[col][curComp] = (ComponentType)(d + predictor);
-						}
-					}
-				}
+		// Decodes numROW rows, the specialised decode loop is selected once per scan
+		void DecodeImage(int32_t numROW)
+		{
+			static const DecodeImageFunction decodeImageFunctions[2][4][8] =
+			{
+				{ DECODE_IMAGE_PSVS(1, false), DECODE_IMAGE_PSVS(2, false), DECODE_IMAGE_PSVS(3, false), DECODE_IMAGE_PSVS(4, false) },
+				{ DECODE_IMAGE_PSVS(1, true), DECODE_IMAGE_PSVS(2, true), DECODE_IMAGE_PSVS(3, true), DECODE_IMAGE_PSVS(4, true) }
+			};
 
-				PmPutRow(curRowBuf, compsInScan, numCOL, row);
-				swap(MCU*, prevRowBuf, curRowBuf);
+			if (info.compsInScan < 1 || info.compsInScan > 4)
+			{
+				ThrowBadFormat();
+				return;
 			}
+
+			// An invalid PSV predicts zero, as the generic decoder did
+			const int32_t psv = (info.Ss >= 1 && info.Ss <= 7) ? info.Ss : 0;
+
+			(this->*decodeImageFunctions[fBug16 ? 1 : 0][info.compsInScan - 1][psv])(numROW);
 		}
-  
-  #undef swap
+
+#undef DECODE_IMAGE_PSVS
 
 		DecoderInput* fStream;		// Input data.
 
@@ -1500,43 +2148,1121 @@ namespace Octopus::Player::Decoders::Jpeg
 
 		bool fBug16;				// Decode data with the "16-bit" bug.
 
+		LosslessJpegHeaderCache* fHeaderCache;	// Optional, headers parsed by earlier decodes
+
 		LosslessJpegMemory huffmanBuffer[4];
 
 		LosslessJpegMemory compInfoBuffer;
 
 		sDecompressInfo info;
 
-		LosslessJpegMemory mcuBuffer1;
-		LosslessJpegMemory mcuBuffer2;
-		LosslessJpegMemory mcuBuffer3;
-		LosslessJpegMemory mcuBuffer4;
-
-		MCU* mcuROW1;
-		MCU* mcuROW2;
+		LosslessJpegMemory entropyBuffer;
+		LosslessJpegMemory intervalBuffer;
+		LosslessJpegMemory diffBuffer;		// One row of decoded differences
+		sEntropyCodedSegment segment;
+		const sEntropyCodedSegment* fSegment;	// Unstuffed entropy coded data, owned or shared
+		DecoderInput fEntropyStream;		// Bit reader input
 
 		uint64_t getBuffer;			// current bit-extraction buffer
 		int32_t bitsLeft;
 	};
     
-	extern "C" Core::eError DecodeLossless(uint8_t* pOut16Bit, uint8_t* pInCompressed, uint32_t compressedSizeBytes, uint32_t width, uint32_t height, uint32_t bitDepth)
+	// Persistent memory for lossless decodes, intended to be kept per decoding thread.
+	// The arena grows to fit the largest decode seen, so steady state decodes don't allocate,
+	// and the header cache lets streams with the same headers skip parsing them.
+	class LosslessJpegContext
 	{
-		
-        DecoderInput stream(pInCompressed);
-		DecoderOutput output(pOut16Bit, width * height * sizeof(uint16_t));
-		
-		LosslessJpegDecoder decoder(&stream, &output, false);
-		
-		uint32_t imageWidth;
-		uint32_t imageHeight;
-		uint32_t imageChannels;
-		if ( !decoder.StartRead(imageWidth, imageHeight, imageChannels) )
+	public:
+
+		LosslessJpegContext()
+			: m_allocator(nullptr, 0)
+		{}
+
+		// Prepares the arena for a new decode, the returned allocator is valid until the next call
+		LosslessJpegAllocator* BeginDecode(uint64_t compressedSizeBytes)
+		{
+			// Room for the tables and the unstuffed input, or everything the previous decode asked for
+			const auto tablesSize = 4 * LosslessJpegAllocator::AlignedSize(sizeof(sHuffmanTable)) +
+				LosslessJpegAllocator::AlignedSize(256 * sizeof(sJpegComponentInfo)) + kIntervalTableSize;
+			const auto entropySize = LosslessJpegAllocator::AlignedSize(compressedSizeBytes + LOSSLESS_ENTROPY_PADDING_BYTES);
+			const auto requiredSize = std::max(tablesSize + entropySize, m_allocator.RequestedSize());
+
+			if (requiredSize > m_arena.size())
+				m_arena.resize(requiredSize);
+
+			m_allocator.Reset(m_arena.data(), m_arena.size());
+			return &m_allocator;
+		}
+
+		LosslessJpegHeaderCache* HeaderCache() { return &m_headerCache; }
+
+		// Buffer for decodes that can't be written in place, kept between decodes
+		uint8_t* ScratchBuffer(uint64_t size)
+		{
+			if (size > m_scratch.size())
+				m_scratch.resize(size);
+			return m_scratch.data();
+		}
+
+		// Chunks of the speculative decode, their difference buffers are kept between decodes
+		std::vector<sSpeculativeChunk>& SpeculativeChunks() { return m_speculativeChunks; }
+
+		// Context for one of the streams a worker decodes in lockstep, the worker's own for the first
+		LosslessJpegContext* LaneContext(uint32_t lane)
+		{
+			return lane ? WorkerContext(lane - 1) : this;
+		}
+
+		// Context for one of the workers of a parallel decode
+		LosslessJpegContext* WorkerContext(uint32_t index)
+		{
+			while (m_workerContexts.size() <= index)
+				m_workerContexts.emplace_back(new LosslessJpegContext());
+			return m_workerContexts[index].get();
+		}
+
+		// Prepares worker contexts up front, so workers don't resize the list concurrently
+		void ReserveWorkerContexts(uint32_t count)
+		{
+			if (count)
+				WorkerContext(count - 1);
+		}
+
+		// libjpeg-turbo decompressor, created the first time the context decodes with that backend
+		LosslessJpegTurboDecoder* TurboDecoder()
+		{
+			if (!m_pTurboDecoder)
+				m_pTurboDecoder.reset(new LosslessJpegTurboDecoder());
+			return m_pTurboDecoder.get();
+		}
+
+	private:
+
+		static constexpr uint64_t kIntervalTableSize = 4096;
+
+		std::vector<uint8_t> m_arena;
+		LosslessJpegAllocator m_allocator;
+		LosslessJpegHeaderCache m_headerCache;
+		std::vector<uint8_t> m_scratch;
+		std::vector<std::unique_ptr<LosslessJpegContext>> m_workerContexts;
+		std::unique_ptr<LosslessJpegTurboDecoder> m_pTurboDecoder;
+		std::vector<sSpeculativeChunk> m_speculativeChunks;
+	};
+
+	// Minimum samples per frame before restart intervals are decoded in parallel
+	constexpr uint32_t kParallelRestartMinSamples = 256 * 1024;
+
+	// Decodes the restart intervals of a single scan on the shared thread pool.
+	// Every worker parses its own copy of the headers, then takes whole intervals which
+	// write their own rows of the output, and gathers its own statistics of them.
+	// Returns false if the stream can't be split.
+	static bool DecodeLosslessRestartIntervals(LosslessJpegContext* pContext, LosslessJpegDecoder& decoder, uint8_t* pOut16Bit, uint64_t outputStrideBytes,
+		uint8_t* pInCompressed, uint32_t compressedSizeBytes, uint32_t imageWidth, uint32_t imageHeight, uint32_t imageChannels,
+		const RawStatisticsRows& statistics, Core::eError& result)
+	{
+		auto& threadPool = ThreadPool::Instance();
+		const auto restartRows = decoder.RestartIntervalRows();
+		if (restartRows == 0 || restartRows >= (int32_t)imageHeight || threadPool.ThreadCount() <= 1 ||
+			imageWidth * imageHeight * imageChannels < kParallelRestartMinSamples)
+			return false;
+
+		if (!decoder.IndexRestartIntervals())
+			return false;
+
+		const auto intervalCount = decoder.EntropyCodedSegment().intervalCount;
+		const auto workerCount = std::min(intervalCount, threadPool.ThreadCount());
+
+		// With enough intervals for every worker, each takes kInterleavedStreams at a time and decodes them in lockstep
+		const auto laneCount = (intervalCount >= workerCount * LosslessJpegDecoder::kInterleavedStreams) ? LosslessJpegDecoder::kInterleavedStreams : 1;
+
+		if (pContext)
+			pContext->ReserveWorkerContexts(workerCount);
+
+		const uint64_t rowSamples = (uint64_t)imageWidth * imageChannels;
+		RawStatisticsPartials workerStatistics(statistics.Statistics(), workerCount);
+
+		std::atomic<uint32_t> nextInterval(0);
+		std::atomic<bool> badData(false);
+
+		threadPool.ParallelFor(workerCount, [&](uint32_t worker)
+		{
+			// Workers only hold their own Huffman tables, the unstuffed input is shared
+			auto pWorkerContext = pContext ? pContext->WorkerContext(worker) : nullptr;
+
+			std::vector<DecoderInput> streams(laneCount, DecoderInput(pInCompressed, compressedSizeBytes));
+			std::vector<DecoderOutput> outputs(laneCount, DecoderOutput(nullptr, 0, 0));
+			std::unique_ptr<LosslessJpegDecoder> laneDecoders[LosslessJpegDecoder::kInterleavedStreams];
+			LosslessJpegDecoder* ppLaneDecoders[LosslessJpegDecoder::kInterleavedStreams];
+			for (uint32_t lane = 0; lane < laneCount; lane++)
+			{
+				auto pLaneContext = pWorkerContext ? pWorkerContext->LaneContext(lane) : nullptr;
+				auto pAllocator = pLaneContext ? pLaneContext->BeginDecode(0) : nullptr;
+				laneDecoders[lane].reset(new LosslessJpegDecoder(&streams[lane], nullptr, false, pAllocator, pLaneContext ? pLaneContext->HeaderCache() : nullptr));
+				ppLaneDecoders[lane] = laneDecoders[lane].get();
+
+				uint32_t width, height, channels;
+				if (!laneDecoders[lane]->StartRead(width, height, channels, &decoder.EntropyCodedSegment()))
+				{
+					badData = true;
+					return;
+				}
+			}
+			auto& workerDecoder = *laneDecoders[0];
+			const bool interleave = laneCount > 1 && workerDecoder.InterleavesWith(workerDecoder);
+
+			for (uint32_t i = nextInterval.fetch_add(laneCount); i < intervalCount; i = nextInterval.fetch_add(laneCount))
+			{
+				// Whole intervals in lockstep, a short last interval on its own
+				const auto end = std::min(i + laneCount, intervalCount);
+				if (interleave && end - i == laneCount && end * restartRows <= imageHeight)
+				{
+					for (uint32_t lane = 0; lane < laneCount; lane++)
+					{
+						const auto firstRow = (i + lane) * restartRows;
+						outputs[lane] = DecoderOutput(pOut16Bit + firstRow * outputStrideBytes, outputStrideBytes, restartRows,
+							statistics.From(firstRow * rowSamples, workerStatistics[worker]));
+						laneDecoders[lane]->BeginRestartInterval(i + lane, &outputs[lane]);
+					}
+					LosslessJpegDecoder::DecodeInterleaved(ppLaneDecoders, restartRows);
+
+					for (uint32_t lane = 0; lane < laneCount; lane++)
+					{
+						outputs[lane].Finish();
+						if (laneDecoders[lane]->Overrun())
+							badData = true;
+					}
+					continue;
+				}
+
+				for (; i < end; i++)
+				{
+					const auto firstRow = i * restartRows;
+					const auto rowCount = std::min((uint32_t)restartRows, imageHeight - firstRow);
+					DecoderOutput output(pOut16Bit + firstRow * outputStrideBytes, outputStrideBytes, rowCount,
+						statistics.From(firstRow * rowSamples, workerStatistics[worker]));
+
+					workerDecoder.DecodeRestartInterval(i, &output, rowCount);
+					output.Finish();
+
+					if (workerDecoder.Overrun())
+						badData = true;
+				}
+			}
+		});
+
+		workerStatistics.Merge();
+		result = badData ? Core::eError::BadImageData : Core::eError::None;
+		return true;
+	}
+
+	// Minimum samples per frame, and compressed bytes per chunk, before a scan without restart markers is decoded speculatively
+	constexpr uint32_t kSpeculativeMinSamples = 1024 * 1024;
+	constexpr uint32_t kSpeculativeMinChunkBytes = 256 * 1024;
+
+	// Symbols at the start of each chunk the previous one can synchronise with. Huffman decodes from a wrong
+	// bit position fall back into step within a few dozen symbols.
+	constexpr uint32_t kSpeculativeSyncSymbols = 4096;
+
+	// Decodes a scan without restart markers on the shared thread pool.
+	// The entropy coded segment is split into chunks at arbitrary bits, each decoded from its start on a worker.
+	// Then, in order, each chunk's decode continues into the next until they reach the same symbol boundary, from
+	// which the next chunk's differences are known to be right, and the image is reconstructed from the differences
+	// in a single pass. Returns false if the scan can't be split, or a chunk never fell into step, and is left to
+	// the sequential decode.
+	static bool DecodeLosslessSpeculative(LosslessJpegContext* pContext, LosslessJpegDecoder& decoder,
+		uint8_t* pInCompressed, uint32_t compressedSizeBytes, uint32_t imageWidth, uint32_t imageHeight, uint32_t imageChannels, Core::eError& result)
+	{
+		auto& threadPool = ThreadPool::Instance();
+		const uint64_t totalSamples = (uint64_t)imageWidth * imageHeight * imageChannels;
+		const uint64_t totalBits = decoder.EntropyCodedSegment().size * 8;
+		const uint32_t chunkCount = (uint32_t)std::min<uint64_t>(threadPool.ThreadCount(), totalBits / ((uint64_t)kSpeculativeMinChunkBytes * 8));
+		if (decoder.HasRestartMarkers() || chunkCount <= 1 || totalSamples < kSpeculativeMinSamples)
+			return false;
+
+		std::vector<sSpeculativeChunk> localChunks;
+		auto& chunks = pContext ? pContext->SpeculativeChunks() : localChunks;
+		if (chunks.size() < chunkCount)
+			chunks.resize(chunkCount);
+
+		// Room for each chunk's share of the samples, and some
+		const uint64_t chunkSamples = totalSamples / chunkCount + totalSamples / (chunkCount * 4) + kSpeculativeSyncSymbols;
+		for (uint32_t i = 0; i < chunkCount; i++)
+		{
+			auto& chunk = chunks[i];
+			chunk.startBit = totalBits * i / chunkCount;
+			chunk.endBit = totalBits * (i + 1) / chunkCount;
+			chunk.phase = (uint32_t)((totalSamples * i / chunkCount) % imageChannels);
+			chunk.validStart = 0;
+			if (chunk.differences.size() < chunkSamples)
+				chunk.differences.resize(chunkSamples);
+		}
+
+		if (pContext)
+			pContext->ReserveWorkerContexts(chunkCount);
+
+		std::atomic<bool> badData(false);
+		threadPool.ParallelFor(chunkCount, [&](uint32_t i)
+		{
+			auto pWorkerContext = pContext ? pContext->WorkerContext(i) : nullptr;
+			auto pAllocator = pWorkerContext ? pWorkerContext->BeginDecode(0) : nullptr;
+
+			DecoderInput stream(pInCompressed, compressedSizeBytes);
+			LosslessJpegDecoder workerDecoder(&stream, nullptr, false, pAllocator, pWorkerContext ? pWorkerContext->HeaderCache() : nullptr);
+
+			uint32_t width, height, channels;
+			if (!workerDecoder.StartRead(width, height, channels, &decoder.EntropyCodedSegment()))
+			{
+				badData = true;
+				return;
+			}
+
+			// The first chunk starts where the scan does, so has nothing to synchronise
+			auto& chunk = chunks[i];
+			workerDecoder.DecodeChunk(chunk, chunk.startBit, chunk.endBit, i ? kSpeculativeSyncSymbols : 0);
+		});
+
+		if (badData)
+			return false;
+
+		// Each chunk is in step by the time it is continued into the next
+		for (uint32_t i = 0; i + 1 < chunkCount; i++)
+		{
+			auto& chunk = chunks[i];
+			auto& next = chunks[i + 1];
+
+			uint64_t syncSymbol;
+			if (decoder.ExtendChunk(chunk, next, syncSymbol))
+			{
+				next.validStart = syncSymbol;
+			}
+			else
+			{
+				// No common boundary, so the next chunk is decoded again from where this one stopped
+				next.phase = (uint32_t)((chunk.phase + chunk.count) % imageChannels);
+				decoder.DecodeChunk(next, chunk.stopBit, next.endBit, 0);
+				next.validStart = 0;
+			}
+		}
+
+		uint64_t validSamples = 0;
+		for (uint32_t i = 0; i < chunkCount; i++)
+			validSamples += chunks[i].count - chunks[i].validStart;
+
+		// The scan ran out before every sample was decoded
+		if (validSamples < totalSamples)
+			return false;
+
+		decoder.ReconstructChunks(chunks.data(), chunkCount);
+
+		result = Core::eError::None;
+		return true;
+	}
+
+	extern "C" uint32_t DecodeLosslessInputPaddingBytes()
+	{
+		return LOSSLESS_INPUT_PADDING_BYTES;
+	}
+
+	extern "C" LosslessJpegContext* CreateLosslessContext()
+	{
+		return new LosslessJpegContext();
+	}
+
+	extern "C" void DestroyLosslessContext(LosslessJpegContext* pContext)
+	{
+		delete pContext;
+	}
+
+	// Shape of a stream that the backends are timed on, read from its frame and scan headers
+	struct sLosslessStreamShape
+	{
+		uint32_t precision, width, height, components, predictor;
+
+		bool operator<(const sLosslessStreamShape& other) const
+		{
+			return std::tie(precision, width, height, components, predictor) <
+				std::tie(other.precision, other.width, other.height, other.components, other.predictor);
+		}
+	};
+
+	static bool ReadLosslessStreamShape(const uint8_t* pIn, uint32_t size, sLosslessStreamShape& shape)
+	{
+		if (size < 4 || pIn[0] != 0xFF || pIn[1] != M_SOI)
+			return false;
+
+		bool frame = false;
+		for (uint32_t i = 2; i + 4 <= size; )
+		{
+			if (pIn[i] != 0xFF)
+				return false;
+			const auto marker = pIn[i + 1];
+			if (marker == 0xFF)
+			{
+				i++;
+				continue;
+			}
+
+			const auto length = ((uint32_t)pIn[i + 2] << 8) | pIn[i + 3];
+			const auto pSegment = pIn + i + 4;
+			if (length < 2 || i + 2 + length > size)
+				return false;
+
+			if (marker == M_SOF3 && length >= 8)
+			{
+				shape.precision = pSegment[0];
+				shape.height = ((uint32_t)pSegment[1] << 8) | pSegment[2];
+				shape.width = ((uint32_t)pSegment[3] << 8) | pSegment[4];
+				shape.components = pSegment[5];
+				frame = true;
+			}
+			else if (marker == M_SOS)
+			{
+				const uint32_t scanComponents = length >= 3 ? pSegment[0] : 0;
+				if (!frame || length < 6 + 2 * scanComponents)
+					return false;
+				shape.predictor = pSegment[1 + 2 * scanComponents];
+				return true;
+			}
+			i += 2 + length;
+		}
+		return false;
+	}
+
+	// Number of frames each backend decodes before one is chosen for a stream shape
+	constexpr uint32_t kLosslessBackendTrialFrames = 3;
+
+	// Chooses the backend of every frame decode. When automatic, the first frames of each stream shape alternate
+	// between the backends and the fastest per pixel decodes the rest of the clip. Different cameras (predictors,
+	// tile shapes, restart layouts) favour different decoders. The OCTOPUS_LOSSLESS_JPEG_BACKEND environment
+	// variable (auto, dng-sdk or libjpeg-turbo) can force a backend.
+	class LosslessBackendSelector
+	{
+	public:
+
+		struct sChoice
+		{
+			eLosslessBackend backend;
+			bool timed;
+			sLosslessStreamShape shape;
+		};
+
+		// Intentionally never destroyed, as the thread pool
+		static LosslessBackendSelector& Instance()
+		{
+			static LosslessBackendSelector* pInstance = new LosslessBackendSelector();
+			return *pInstance;
+		}
+
+		sChoice Choose(const uint8_t* pInCompressed, uint32_t compressedSizeBytes)
+		{
+			sChoice choice = { eLosslessBackend::DngSdk, false, {} };
+			if (!LosslessJpegTurboDecoder::Available())
+				return choice;
+
+			const auto forced = m_forced.load();
+			if (forced != eLosslessBackend::Auto)
+			{
+				choice.backend = forced;
+				return choice;
+			}
+			if (!ReadLosslessStreamShape(pInCompressed, compressedSizeBytes, choice.shape))
+				return choice;
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+			auto& trial = m_trials[choice.shape];
+			if (trial.chosen != eLosslessBackend::Auto)
+			{
+				choice.backend = trial.chosen;
+				return choice;
+			}
+
+			// Alternates, so both backends are timed under the same load
+			const auto turbo = trial.started[1] < trial.started[0];
+			trial.started[turbo]++;
+			choice.backend = turbo ? eLosslessBackend::LibJpegTurbo : eLosslessBackend::DngSdk;
+			choice.timed = true;
+			return choice;
+		}
+
+		// Times a frame decoded with a timed choice, fellBack is set when libjpeg-turbo couldn't decode the streams
+		void Record(const sChoice& choice, double seconds, uint64_t pixels, bool fellBack)
+		{
+			if (!choice.timed || pixels == 0)
+				return;
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+			auto& trial = m_trials[choice.shape];
+			if (trial.chosen != eLosslessBackend::Auto)
+				return;
+			if (fellBack)
+			{
+				trial.chosen = eLosslessBackend::DngSdk;
+				return;
+			}
+
+			// Best rather than average time, the first frames also pay for allocating the decoders' memory
+			const auto index = choice.backend == eLosslessBackend::LibJpegTurbo ? 1 : 0;
+			trial.finished[index]++;
+			trial.bestSecondsPerPixel[index] = std::min(trial.bestSecondsPerPixel[index], seconds / pixels);
+			if (trial.finished[0] >= kLosslessBackendTrialFrames && trial.finished[1] >= kLosslessBackendTrialFrames)
+				trial.chosen = trial.bestSecondsPerPixel[1] < trial.bestSecondsPerPixel[0] ? eLosslessBackend::LibJpegTurbo : eLosslessBackend::DngSdk;
+		}
+
+		void Reset()
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_trials.clear();
+		}
+
+		void Force(eLosslessBackend backend)
+		{
+			m_forced = backend;
+		}
+
+	private:
+
+		struct sTrial
+		{
+			uint32_t started[2] = { 0, 0 };
+			uint32_t finished[2] = { 0, 0 };
+			double bestSecondsPerPixel[2] = { DBL_MAX, DBL_MAX };
+			eLosslessBackend chosen = eLosslessBackend::Auto;
+		};
+
+		LosslessBackendSelector()
+			: m_forced(BackendFromEnvironment())
+		{}
+
+		static eLosslessBackend BackendFromEnvironment()
+		{
+			static const char* pVariable = "OCTOPUS_LOSSLESS_JPEG_BACKEND";
+			std::string value;
+#ifdef _MSC_VER
+			char* pValue = nullptr;
+			size_t length = 0;
+			if (_dupenv_s(&pValue, &length, pVariable) == 0 && pValue)
+			{
+				value = pValue;
+				free(pValue);
+			}
+#else
+			if (const char* pValue = getenv(pVariable))
+				value = pValue;
+#endif
+			if (value == "dng-sdk")
+				return eLosslessBackend::DngSdk;
+			if (value == "libjpeg-turbo")
+				return eLosslessBackend::LibJpegTurbo;
+			return eLosslessBackend::Auto;
+		}
+
+		std::mutex m_mutex;
+		std::map<sLosslessStreamShape, sTrial> m_trials;
+		std::atomic<eLosslessBackend> m_forced;
+	};
+
+	// Runs decode(backend) with the backend chosen for the frame's streams, timing it while the backends are on trial.
+	// pixels is the frame's decoded pixels, decode sets fellBack if libjpeg-turbo had to hand streams to the DNG SDK decoder.
+	template<typename Decode>
+	static Core::eError DecodeLosslessFrame(const uint8_t* pInCompressed, uint32_t compressedSizeBytes, uint64_t pixels, const Decode& decode)
+	{
+		auto& selector = LosslessBackendSelector::Instance();
+		const auto choice = selector.Choose(pInCompressed, compressedSizeBytes);
+		std::atomic<bool> fellBack(false);
+		if (!choice.timed)
+			return decode(choice.backend, fellBack);
+
+		const auto start = std::chrono::steady_clock::now();
+		const auto result = decode(choice.backend, fellBack);
+		const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		if (result == Core::eError::None)
+			selector.Record(choice, seconds, pixels, fellBack);
+		return result;
+	}
+
+	extern "C" void SetLosslessBackend(eLosslessBackend backend)
+	{
+		LosslessBackendSelector::Instance().Force(backend);
+	}
+
+	extern "C" void ResetLosslessBackendSelection()
+	{
+		LosslessBackendSelector::Instance().Reset();
+	}
+
+	// Where the rows of a stream are decoded. Rows of the stream normally match rows of the output and are decoded in place.
+	// Streams with differently shaped rows are contiguous in a dense block, otherwise they go through a scratch buffer.
+	// Draft decodes always go through the scratch buffer, which is binned to the output.
+	static uint8_t* LosslessDecodeTarget(LosslessJpegContext* pContext, std::vector<uint8_t>& localScratch, uint8_t* pOut16Bit, uint64_t outputStrideBytes,
+		uint32_t width, uint64_t streamRowSizeBytes, uint32_t streamHeight, bool draft, uint64_t& decodeStrideBytes)
+	{
+		const auto rowSizeBytes = (uint64_t)width * sizeof(uint16_t);
+		const bool sameRows = (streamRowSizeBytes == rowSizeBytes) && !draft;
+		const bool dense = (outputStrideBytes == rowSizeBytes) && !draft;
+		decodeStrideBytes = sameRows ? outputStrideBytes : streamRowSizeBytes;
+		if (sameRows || dense)
+			return pOut16Bit;
+
+		const auto scratchSize = streamRowSizeBytes * streamHeight;
+		if (pContext)
+			return pContext->ScratchBuffer(scratchSize);
+		localScratch.resize(scratchSize);
+		return localScratch.data();
+	}
+
+	// Moves a stream decoded away from the output to its place, binning it in draft mode
+	static void FinishLosslessDecode(uint8_t* pOut16Bit, uint64_t outputStrideBytes, const uint8_t* pDecode, uint32_t width, uint32_t height, bool draft)
+	{
+		const auto rowSizeBytes = (uint64_t)width * sizeof(uint16_t);
+		if (draft)
+		{
+			BinBayerDraft<uint16_t>(pOut16Bit, outputStrideBytes, pDecode, rowSizeBytes, width, height);
+		}
+		else if (pDecode != pOut16Bit)
+		{
+			for (uint32_t row = 0; row < height; row++)
+				memcpy(pOut16Bit + row * outputStrideBytes, pDecode + row * rowSizeBytes, rowSizeBytes);
+		}
+	}
+
+	// Decodes one stream with libjpeg-turbo, false if it couldn't be and should be decoded by the DNG SDK decoder.
+	// Statistics are only kept once the whole stream is decoded, as the DNG SDK decoder starts over.
+	static bool DecodeLosslessImageTurbo(LosslessJpegContext* pContext, uint8_t* pOut16Bit, uint64_t outputStrideBytes, uint8_t* pInCompressed,
+		uint32_t compressedSizeBytes, uint32_t width, uint32_t height, bool draft, const RawStatisticsRows& statistics, Core::eError& result)
+	{
+		std::unique_ptr<LosslessJpegTurboDecoder> pLocalDecoder;
+		auto pDecoder = pContext ? pContext->TurboDecoder() : nullptr;
+		if (!pDecoder)
+		{
+			pLocalDecoder.reset(new LosslessJpegTurboDecoder());
+			pDecoder = pLocalDecoder.get();
+		}
+
+		uint32_t imageWidth;
+		uint32_t imageHeight;
+		uint32_t imageChannels;
+		if (!pDecoder->StartRead(pInCompressed, compressedSizeBytes, imageWidth, imageHeight, imageChannels))
+			return false;
+		if ((uint64_t)imageWidth * imageHeight * imageChannels != (uint64_t)width * height)
+		{
+			result = Core::eError::BadMetadata;
+			return true;
+		}
+
+		std::vector<uint8_t> localScratch;
+		uint64_t decodeStrideBytes;
+		const auto pDecode = LosslessDecodeTarget(pContext, localScratch, pOut16Bit, outputStrideBytes, width,
+			(uint64_t)imageWidth * imageChannels * sizeof(uint16_t), imageHeight, draft, decodeStrideBytes);
+		RawStatisticsPartials streamStatistics(statistics.Statistics(), 1);
+		auto rows = statistics.From(0, streamStatistics[0]);
+		if (pDecoder->FinishRead(pDecode, decodeStrideBytes, rows.Enabled() ? &rows : nullptr) != Core::eError::None)
+			return false;
+		streamStatistics.Merge();
+
+		FinishLosslessDecode(pOut16Bit, outputStrideBytes, pDecode, width, height, draft);
+		result = Core::eError::None;
+		return true;
+	}
+
+	// Decodes one complete stream into a width x height block of an image with the given row stride,
+	// or into a width / 2 x height / 2 block binned from the Bayer mosaic in draft mode.
+	// Restart intervals, or speculative chunks of a scan without them, may be spread over the thread pool.
+	// Streams libjpeg-turbo fails on are decoded again by the DNG SDK decoder, setting pFellBack.
+	// The full resolution samples are added to the statistics of the block, if any.
+	static Core::eError DecodeLosslessImage(LosslessJpegContext* pContext, uint8_t* pOut16Bit, uint64_t outputStrideBytes, uint8_t* pInCompressed,
+		uint32_t compressedSizeBytes, uint32_t width, uint32_t height, bool parallelRestarts, bool draft = false,
+		eLosslessBackend backend = eLosslessBackend::DngSdk, std::atomic<bool>* pFellBack = nullptr, const RawStatisticsRows& statistics = RawStatisticsRows())
+	{
+		if (backend == eLosslessBackend::LibJpegTurbo)
+		{
+			Core::eError result;
+			if (DecodeLosslessImageTurbo(pContext, pOut16Bit, outputStrideBytes, pInCompressed, compressedSizeBytes, width, height, draft, statistics, result))
+				return result;
+			if (pFellBack)
+				*pFellBack = true;
+		}
+
+        DecoderInput stream(pInCompressed, compressedSizeBytes);
+		DecoderOutput output(nullptr, 0, 0);
+		
+		auto pAllocator = pContext ? pContext->BeginDecode(compressedSizeBytes) : nullptr;
+		LosslessJpegDecoder decoder(&stream, &output, false, pAllocator, pContext ? pContext->HeaderCache() : nullptr);
+		
+		uint32_t imageWidth;
+		uint32_t imageHeight;
+		uint32_t imageChannels;
+		if ( !decoder.StartRead(imageWidth, imageHeight, imageChannels) )
+			return Core::eError::BadFile;
+		if (imageWidth * imageHeight * imageChannels != width * height)
+			return Core::eError::BadMetadata;
+
+		std::vector<uint8_t> localScratch;
+		uint64_t decodeStrideBytes;
+		const auto pDecode = LosslessDecodeTarget(pContext, localScratch, pOut16Bit, outputStrideBytes, width,
+			(uint64_t)imageWidth * imageChannels * sizeof(uint16_t), imageHeight, draft, decodeStrideBytes);
+		output = DecoderOutput(pDecode, decodeStrideBytes, imageHeight, statistics);
+
+		Core::eError result;
+		if (!parallelRestarts ||
+			(!DecodeLosslessRestartIntervals(pContext, decoder, pDecode, decodeStrideBytes, pInCompressed, compressedSizeBytes, imageWidth, imageHeight, imageChannels,
+				statistics, result) &&
+			 !DecodeLosslessSpeculative(pContext, decoder, pInCompressed, compressedSizeBytes, imageWidth, imageHeight, imageChannels, result)))
+		{
+			decoder.FinishRead();
+			result = decoder.Overrun() ? Core::eError::BadImageData : Core::eError::None;
+		}
+		output.Finish();
+
+		FinishLosslessDecode(pOut16Bit, outputStrideBytes, pDecode, width, height, draft);
+		return result;
+	}
+
+	extern "C" Core::eError DecodeLossless(LosslessJpegContext* pContext, uint8_t* pOut16Bit, uint32_t outputStrideBytes, uint32_t originX, uint32_t originY,
+		uint8_t* pInCompressed, uint32_t compressedSizeBytes, uint32_t width, uint32_t height, uint32_t bitDepth, sRawStatistics* pStatistics)
+	{
+		const RawStatisticsRows statistics(pStatistics, originX, originY, width);
+		return DecodeLosslessFrame(pInCompressed, compressedSizeBytes, (uint64_t)width * height, [&](eLosslessBackend backend, std::atomic<bool>& fellBack)
+		{
+			return DecodeLosslessImage(pContext, pOut16Bit + (uint64_t)originY * outputStrideBytes + originX * sizeof(uint16_t), outputStrideBytes,
+				pInCompressed, compressedSizeBytes, width, height, true, false, backend, &fellBack, statistics);
+		});
+	}
+
+	extern "C" Core::eError DecodeLosslessDraft(LosslessJpegContext* pContext, uint8_t* pOut16Bit, uint32_t outputStrideBytes, uint32_t originX, uint32_t originY,
+		uint8_t* pInCompressed, uint32_t compressedSizeBytes, uint32_t width, uint32_t height, uint32_t bitDepth)
+	{
+		return DecodeLosslessFrame(pInCompressed, compressedSizeBytes, (uint64_t)width * height, [&](eLosslessBackend backend, std::atomic<bool>& fellBack)
+		{
+			return DecodeLosslessImage(pContext, pOut16Bit + (uint64_t)originY * outputStrideBytes + originX * sizeof(uint16_t), outputStrideBytes,
+				pInCompressed, compressedSizeBytes, width, height, true, true, backend, &fellBack);
+		});
+	}
+
+	// Checkpoint index of a stream without restart markers. Header, the bit position of each checkpoint's row in the
+	// entropy coded segment (which is all of the bit reader's state, as it refills from the unstuffed segment), then the
+	// row above each checkpoint.
+	struct sLosslessCheckpointIndex
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t compressedSizeBytes;
+		uint32_t rowSamples;
+		uint32_t height;
+		uint32_t rowsPerCheckpoint;
+		uint32_t checkpointCount;	// 0 when the stream isn't worth indexing, it has restart markers
+		uint32_t reserved;
+		uint64_t fingerprint;		// of the start and end of the stream
+	};
+
+	constexpr uint32_t kLosslessCheckpointMagic = 0x49434A4C;	// LJCI
+	constexpr uint32_t kLosslessCheckpointVersion = 1;
+
+	// Checkpoints split a frame into this many row bands, of at least kLosslessCheckpointMinRows rows
+	constexpr uint32_t kLosslessCheckpointBands = 16;
+	constexpr uint32_t kLosslessCheckpointMinRows = 16;
+
+	// Bytes at each end of a stream hashed to tell whether an index belongs to it
+	constexpr uint32_t kLosslessCheckpointFingerprintBytes = 4096;
+
+	static uint32_t LosslessCheckpointRows(uint32_t height)
+	{
+		return std::max((height + kLosslessCheckpointBands - 1) / kLosslessCheckpointBands, kLosslessCheckpointMinRows);
+	}
+
+	static uint64_t LosslessCheckpointIndexSize(uint32_t rowSamples, uint32_t height)
+	{
+		const uint64_t checkpointCount = height ? (height - 1) / LosslessCheckpointRows(height) : 0;
+		return sizeof(sLosslessCheckpointIndex) + checkpointCount * (sizeof(uint64_t) + rowSamples * sizeof(uint16_t));
+	}
+
+	// FNV-1a of the first and last kLosslessCheckpointFingerprintBytes
+	static uint64_t LosslessCheckpointFingerprint(const uint8_t* pIn, uint32_t size)
+	{
+		uint64_t hash = 0xCBF29CE484222325ull;
+		const auto head = std::min(size, kLosslessCheckpointFingerprintBytes);
+		const auto tail = std::min(size - head, kLosslessCheckpointFingerprintBytes);
+		for (uint32_t i = 0; i < head; i++)
+			hash = (hash ^ pIn[i]) * 0x100000001B3ull;
+		for (uint32_t i = size - tail; i < size; i++)
+			hash = (hash ^ pIn[i]) * 0x100000001B3ull;
+		return hash;
+	}
+
+	extern "C" uint32_t LosslessCheckpointIndexSizeBytes(const uint8_t* pInCompressed, uint32_t compressedSizeBytes)
+	{
+		sLosslessStreamShape shape;
+		if (!ReadLosslessStreamShape(pInCompressed, compressedSizeBytes, shape))
+			return 0;
+		return (uint32_t)LosslessCheckpointIndexSize(shape.width * shape.components, shape.height);
+	}
+
+	extern "C" Core::eError DecodeLosslessIndexing(LosslessJpegContext* pContext, uint8_t* pOut16Bit, uint32_t outputStrideBytes, uint32_t originX, uint32_t originY,
+		uint8_t* pInCompressed, uint32_t compressedSizeBytes, uint32_t width, uint32_t height, uint32_t bitDepth, uint8_t* pIndex, uint32_t indexSizeBytes,
+		sRawStatistics* pStatistics)
+	{
+		if (!pIndex || indexSizeBytes < sizeof(sLosslessCheckpointIndex))
+			return Core::eError::BadMetadata;
+		auto& index = *(sLosslessCheckpointIndex*)pIndex;
+		index = sLosslessCheckpointIndex();
+
+		DecoderInput stream(pInCompressed, compressedSizeBytes);
+		DecoderOutput output(nullptr, 0, 0);
+
+		auto pAllocator = pContext ? pContext->BeginDecode(compressedSizeBytes) : nullptr;
+		LosslessJpegDecoder decoder(&stream, &output, false, pAllocator, pContext ? pContext->HeaderCache() : nullptr);
+
+		uint32_t imageWidth;
+		uint32_t imageHeight;
+		uint32_t imageChannels;
+		if (!decoder.StartRead(imageWidth, imageHeight, imageChannels))
 			return Core::eError::BadFile;
 		if (imageWidth * imageHeight * imageChannels != width * height)
 			return Core::eError::BadMetadata;
-		decoder.FinishRead();
 
-		if (stream.Position() > compressedSizeBytes)
+		const auto rowSamples = imageWidth * imageChannels;
+		if (indexSizeBytes < LosslessCheckpointIndexSize(rowSamples, imageHeight))
+			return Core::eError::BadMetadata;
+
+		index.magic = kLosslessCheckpointMagic;
+		index.version = kLosslessCheckpointVersion;
+		index.compressedSizeBytes = compressedSizeBytes;
+		index.rowSamples = rowSamples;
+		index.height = imageHeight;
+		index.fingerprint = LosslessCheckpointFingerprint(pInCompressed, compressedSizeBytes);
+
+		// Restart intervals already give random access
+		if (decoder.HasRestartMarkers())
+			return DecodeLossless(pContext, pOut16Bit, outputStrideBytes, originX, originY, pInCompressed, compressedSizeBytes, width, height, bitDepth, pStatistics);
+
+		index.rowsPerCheckpoint = LosslessCheckpointRows(imageHeight);
+		const auto checkpointCount = (imageHeight - 1) / index.rowsPerCheckpoint;
+		auto pBitPositions = (uint64_t*)(pIndex + sizeof(sLosslessCheckpointIndex));
+		auto pRows = (uint16_t*)(pBitPositions + checkpointCount);
+
+		pOut16Bit += (uint64_t)originY * outputStrideBytes + originX * sizeof(uint16_t);
+		std::vector<uint8_t> localScratch;
+		uint64_t decodeStrideBytes;
+		const auto pDecode = LosslessDecodeTarget(pContext, localScratch, pOut16Bit, outputStrideBytes, width,
+			(uint64_t)rowSamples * sizeof(uint16_t), imageHeight, false, decodeStrideBytes);
+
+		// Decoded a band at a time, recording where the next band starts
+		const RawStatisticsRows statistics(pStatistics, originX, originY, width);
+		uint64_t bitPosition = 0;
+		const uint16_t* pPrevRow = nullptr;
+		for (uint32_t firstRow = 0, checkpoint = 0; firstRow < imageHeight; firstRow += index.rowsPerCheckpoint, checkpoint++)
+		{
+			const auto rowCount = std::min(index.rowsPerCheckpoint, imageHeight - firstRow);
+			if (checkpoint)
+			{
+				pBitPositions[checkpoint - 1] = bitPosition;
+				memcpy(pRows + (uint64_t)(checkpoint - 1) * rowSamples, pPrevRow, rowSamples * sizeof(uint16_t));
+			}
+
+			DecoderOutput bandOutput(pDecode + firstRow * decodeStrideBytes, decodeStrideBytes, rowCount, statistics.From((uint64_t)firstRow * rowSamples, pStatistics));
+			decoder.DecodeRows(&bandOutput, rowCount, bitPosition, pPrevRow);
+			bandOutput.Finish();
+			bitPosition = decoder.DecodedBits();
+			pPrevRow = (const uint16_t*)(pDecode + (firstRow + rowCount - 1) * decodeStrideBytes);
+		}
+
+		FinishLosslessDecode(pOut16Bit, outputStrideBytes, pDecode, width, height, false);
+
+		// An index of a broken stream is of no use
+		if (decoder.Overrun())
+		{
+			index.magic = 0;
 			return Core::eError::BadImageData;
+		}
+		index.checkpointCount = checkpointCount;
 		return Core::eError::None;
 	}
+
+	extern "C" Core::eError DecodeLosslessIndexed(LosslessJpegContext* pContext, uint8_t* pOut16Bit, uint32_t outputStrideBytes, uint32_t originX, uint32_t originY,
+		uint8_t* pInCompressed, uint32_t compressedSizeBytes, uint32_t width, uint32_t height, uint32_t bitDepth, const uint8_t* pIndex, uint32_t indexSizeBytes,
+		sRawStatistics* pStatistics)
+	{
+		// Anything that doesn't match the stream decodes without the index
+		const auto pHeader = (const sLosslessCheckpointIndex*)pIndex;
+		if (!pIndex || indexSizeBytes < sizeof(sLosslessCheckpointIndex) || pHeader->magic != kLosslessCheckpointMagic ||
+			pHeader->version != kLosslessCheckpointVersion || pHeader->checkpointCount == 0 || pHeader->compressedSizeBytes != compressedSizeBytes ||
+			pHeader->rowsPerCheckpoint != LosslessCheckpointRows(pHeader->height) ||
+			pHeader->checkpointCount != (pHeader->height - 1) / pHeader->rowsPerCheckpoint ||
+			indexSizeBytes < LosslessCheckpointIndexSize(pHeader->rowSamples, pHeader->height) ||
+			(uint64_t)pHeader->rowSamples * pHeader->height != (uint64_t)width * height ||
+			pHeader->fingerprint != LosslessCheckpointFingerprint(pInCompressed, compressedSizeBytes))
+		{
+			return DecodeLossless(pContext, pOut16Bit, outputStrideBytes, originX, originY, pInCompressed, compressedSizeBytes, width, height, bitDepth, pStatistics);
+		}
+		const auto& index = *pHeader;
+		const auto pBitPositions = (const uint64_t*)(pIndex + sizeof(sLosslessCheckpointIndex));
+		const auto pRows = (const uint16_t*)(pBitPositions + index.checkpointCount);
+
+		DecoderInput stream(pInCompressed, compressedSizeBytes);
+		DecoderOutput output(nullptr, 0, 0);
+
+		auto pAllocator = pContext ? pContext->BeginDecode(compressedSizeBytes) : nullptr;
+		LosslessJpegDecoder decoder(&stream, &output, false, pAllocator, pContext ? pContext->HeaderCache() : nullptr);
+
+		uint32_t imageWidth;
+		uint32_t imageHeight;
+		uint32_t imageChannels;
+		if (!decoder.StartRead(imageWidth, imageHeight, imageChannels))
+			return Core::eError::BadFile;
+		if (imageWidth * imageChannels != index.rowSamples || imageHeight != index.height || decoder.HasRestartMarkers())
+			return Core::eError::BadMetadata;
+
+		pOut16Bit += (uint64_t)originY * outputStrideBytes + originX * sizeof(uint16_t);
+		std::vector<uint8_t> localScratch;
+		uint64_t decodeStrideBytes;
+		const auto pDecode = LosslessDecodeTarget(pContext, localScratch, pOut16Bit, outputStrideBytes, width,
+			(uint64_t)index.rowSamples * sizeof(uint16_t), imageHeight, false, decodeStrideBytes);
+
+		// Every band is independent, as restart intervals are
+		auto& threadPool = ThreadPool::Instance();
+		const auto bandCount = index.checkpointCount + 1;
+		const auto workerCount = std::min(bandCount, threadPool.ThreadCount());
+
+		if (pContext)
+			pContext->ReserveWorkerContexts(workerCount);
+
+		const RawStatisticsRows statistics(pStatistics, originX, originY, width);
+		RawStatisticsPartials workerStatistics(pStatistics, workerCount);
+
+		std::atomic<uint32_t> nextBand(0);
+		std::atomic<bool> badData(false);
+
+		threadPool.ParallelFor(workerCount, [&](uint32_t worker)
+		{
+			auto pWorkerContext = pContext ? pContext->WorkerContext(worker) : nullptr;
+			auto pAllocator = pWorkerContext ? pWorkerContext->BeginDecode(0) : nullptr;
+
+			DecoderInput stream(pInCompressed, compressedSizeBytes);
+			LosslessJpegDecoder workerDecoder(&stream, nullptr, false, pAllocator, pWorkerContext ? pWorkerContext->HeaderCache() : nullptr);
+
+			uint32_t width, height, channels;
+			if (!workerDecoder.StartRead(width, height, channels, &decoder.EntropyCodedSegment()))
+			{
+				badData = true;
+				return;
+			}
+
+			for (uint32_t band = nextBand++; band < bandCount; band = nextBand++)
+			{
+				const auto firstRow = band * index.rowsPerCheckpoint;
+				const auto rowCount = std::min(index.rowsPerCheckpoint, imageHeight - firstRow);
+				DecoderOutput bandOutput(pDecode + firstRow * decodeStrideBytes, decodeStrideBytes, rowCount,
+					statistics.From((uint64_t)firstRow * index.rowSamples, workerStatistics[worker]));
+
+				if (band == 0)
+					workerDecoder.DecodeRows(&bandOutput, rowCount);
+				else
+					workerDecoder.DecodeRows(&bandOutput, rowCount, pBitPositions[band - 1], pRows + (uint64_t)(band - 1) * index.rowSamples);
+				bandOutput.Finish();
+
+				if (workerDecoder.Overrun())
+					badData = true;
+			}
+		});
+
+		workerStatistics.Merge();
+		FinishLosslessDecode(pOut16Bit, outputStrideBytes, pDecode, width, height, false);
+		return badData ? Core::eError::BadImageData : Core::eError::None;
+	}
+
+	// A pixel rectangle of the full resolution frame
+	struct sRegion
+	{
+		uint32_t x, y, width, height;
+	};
+
+	// Fills a tile's place in the output with a constant rather than decoding it
+	static void FillLosslessTile(uint8_t* pOut16Bit, uint64_t outputStrideBytes, uint32_t width, uint32_t height, uint16_t value)
+	{
+		for (uint32_t row = 0; row < height; row++)
+		{
+			auto pRow = (uint16_t*)(pOut16Bit + row * outputStrideBytes);
+			std::fill(pRow, pRow + width, value);
+		}
+	}
+
+	// Decodes kInterleavedStreams tiles in lockstep on one thread. Returns false, before decoding any, if their scans
+	// don't have the same shape or have restart markers, and they are left to be decoded one at a time.
+	static bool DecodeLosslessTilesInterleaved(LosslessJpegContext* pWorkerContext, uint8_t* pOut16Bit, uint32_t outputStrideBytes, uint8_t* pInCompressed,
+		const uint64_t* pTileOffsets, const uint32_t* pTileSizeBytes, const uint32_t* pTiles, uint32_t tilesAcross, uint32_t tileWidth, uint32_t tileHeight,
+		bool draft, sRawStatistics* pStatistics, Core::eError* pTileErrors)
+	{
+		constexpr auto kLanes = LosslessJpegDecoder::kInterleavedStreams;
+		std::vector<DecoderInput> streams;
+		std::vector<DecoderOutput> outputs(kLanes, DecoderOutput(nullptr, 0, 0));
+		std::unique_ptr<LosslessJpegDecoder> laneDecoders[kLanes];
+		LosslessJpegDecoder* ppLaneDecoders[kLanes];
+		std::vector<uint8_t> localScratch[kLanes];
+		uint8_t* pTileOut[kLanes];
+		uint8_t* pDecode[kLanes];
+		uint32_t imageHeight = 0;
+
+		streams.reserve(kLanes);
+		for (uint32_t lane = 0; lane < kLanes; lane++)
+		{
+			const auto tile = pTiles[lane];
+			auto pLaneContext = pWorkerContext ? pWorkerContext->LaneContext(lane) : nullptr;
+			auto pAllocator = pLaneContext ? pLaneContext->BeginDecode(pTileSizeBytes[tile]) : nullptr;
+			streams.emplace_back(pInCompressed + pTileOffsets[tile], pTileSizeBytes[tile]);
+			laneDecoders[lane].reset(new LosslessJpegDecoder(&streams[lane], &outputs[lane], false, pAllocator, pLaneContext ? pLaneContext->HeaderCache() : nullptr));
+			ppLaneDecoders[lane] = laneDecoders[lane].get();
+
+			uint32_t imageWidth, imageChannels;
+			if (!laneDecoders[lane]->StartRead(imageWidth, imageHeight, imageChannels) || imageWidth * imageHeight * imageChannels != tileWidth * tileHeight ||
+				laneDecoders[lane]->HasRestartMarkers() || !laneDecoders[lane]->InterleavesWith(*laneDecoders[0]))
+				return false;
+
+			const auto scale = draft ? 2 : 1;
+			const auto originX = (uint64_t)(tile % tilesAcross) * tileWidth / scale;
+			const auto originY = (uint64_t)(tile / tilesAcross) * tileHeight / scale;
+			pTileOut[lane] = pOut16Bit + originY * outputStrideBytes + originX * sizeof(uint16_t);
+
+			uint64_t decodeStrideBytes;
+			pDecode[lane] = LosslessDecodeTarget(pLaneContext, localScratch[lane], pTileOut[lane], outputStrideBytes, tileWidth,
+				(uint64_t)imageWidth * imageChannels * sizeof(uint16_t), imageHeight, draft, decodeStrideBytes);
+			outputs[lane] = DecoderOutput(pDecode[lane], decodeStrideBytes, imageHeight,
+				RawStatisticsRows(pStatistics, (tile % tilesAcross) * tileWidth, (tile / tilesAcross) * tileHeight, tileWidth));
+		}
+
+		// Every lane has the same shape, so the same number of rows
+		LosslessJpegDecoder::DecodeInterleaved(ppLaneDecoders, (int32_t)imageHeight);
+
+		for (uint32_t lane = 0; lane < kLanes; lane++)
+		{
+			outputs[lane].Finish();
+			FinishLosslessDecode(pTileOut[lane], outputStrideBytes, pDecode[lane], tileWidth, tileHeight, draft);
+			pTileErrors[pTiles[lane]] = laneDecoders[lane]->Overrun() ? Core::eError::BadImageData : Core::eError::None;
+		}
+		return true;
+	}
+
+	// Decodes the tiles intersecting pRegion (all tiles when null), optionally filling the others with fillValue.
+	// The decoded tiles are added to pStatistics, if any.
+	static Core::eError DecodeLosslessTileRegion(LosslessJpegContext* pContext, uint8_t* pOut16Bit, uint32_t outputStrideBytes, uint8_t* pInCompressed,
+		const uint64_t* pTileOffsets, const uint32_t* pTileSizeBytes, uint32_t tileCount, uint32_t tilesAcross, uint32_t tileWidth, uint32_t tileHeight,
+		bool draft, const sRegion* pRegion, bool fillOutside, uint16_t fillValue, sRawStatistics* pStatistics, Core::eError* pTileErrors)
+	{
+		if (tileCount == 0 || tilesAcross == 0)
+			return Core::eError::None;
+
+		const auto TileInRegion = [&](uint32_t tile)
+		{
+			if (!pRegion)
+				return true;
+			const auto x = (uint64_t)(tile % tilesAcross) * tileWidth;
+			const auto y = (uint64_t)(tile / tilesAcross) * tileHeight;
+			return x < (uint64_t)pRegion->x + pRegion->width && pRegion->x < x + tileWidth
+				&& y < (uint64_t)pRegion->y + pRegion->height && pRegion->y < y + tileHeight;
+		};
+
+		// Tiles to decode, largest first so the slowest tiles don't end up alone at the end of the frame
+		std::vector<uint32_t> tileOrder;
+		std::vector<uint32_t> fillTiles;
+		tileOrder.reserve(tileCount);
+		for (uint32_t i = 0; i < tileCount; i++)
+		{
+			if (TileInRegion(i))
+				tileOrder.push_back(i);
+			else if (fillOutside)
+				fillTiles.push_back(i);
+		}
+		std::stable_sort(tileOrder.begin(), tileOrder.end(), [pTileSizeBytes](uint32_t a, uint32_t b) { return pTileSizeBytes[a] > pTileSizeBytes[b]; });
+		const auto decodeCount = (uint32_t)tileOrder.size();
+		tileOrder.insert(tileOrder.end(), fillTiles.begin(), fillTiles.end());
+		const auto workCount = (uint32_t)tileOrder.size();
+
+		auto& threadPool = ThreadPool::Instance();
+		const auto workerCount = std::min(workCount, threadPool.ThreadCount());
+
+		// Too few tiles to keep every thread busy, let each tile split its restart intervals as well
+		const bool parallelRestarts = decodeCount < threadPool.ThreadCount();
+
+		if (pContext)
+			pContext->ReserveWorkerContexts(workerCount);
+
+		std::vector<Core::eError> tileErrors(tileCount, Core::eError::None);
+
+		// Every tile of a frame has the same shape, the backend is chosen from the first one decoded
+		const auto firstTile = decodeCount ? tileOrder[0] : 0;
+		DecodeLosslessFrame(pInCompressed + pTileOffsets[firstTile], decodeCount ? pTileSizeBytes[firstTile] : 0, (uint64_t)decodeCount * tileWidth * tileHeight,
+			[&](eLosslessBackend backend, std::atomic<bool>& fellBack)
+		{
+			// With enough tiles for every worker, the DNG SDK decoder takes kInterleavedStreams at a time and decodes them in lockstep
+			const auto groupSize = (backend == eLosslessBackend::DngSdk && decodeCount >= workerCount * LosslessJpegDecoder::kInterleavedStreams) ?
+				LosslessJpegDecoder::kInterleavedStreams : 1;
+
+			RawStatisticsPartials workerStatistics(pStatistics, workerCount);
+			std::atomic<uint32_t> nextTile(0);
+			threadPool.ParallelFor(workerCount, [&](uint32_t worker)
+			{
+				auto pWorkerContext = pContext ? pContext->WorkerContext(worker) : nullptr;
+
+				for (uint32_t i = nextTile.fetch_add(groupSize); i < workCount; i = nextTile.fetch_add(groupSize))
+				{
+					const auto end = std::min(i + groupSize, workCount);
+					if (groupSize > 1 && end - i == groupSize && end <= decodeCount &&
+						DecodeLosslessTilesInterleaved(pWorkerContext, pOut16Bit, outputStrideBytes, pInCompressed, pTileOffsets, pTileSizeBytes,
+							tileOrder.data() + i, tilesAcross, tileWidth, tileHeight, draft, workerStatistics[worker], tileErrors.data()))
+						continue;
+
+					for (; i < end; i++)
+					{
+						const auto tile = tileOrder[i];
+						const auto scale = draft ? 2 : 1;
+						const auto originX = (uint64_t)(tile % tilesAcross) * tileWidth / scale;
+						const auto originY = (uint64_t)(tile / tilesAcross) * tileHeight / scale;
+						auto pTileOut = pOut16Bit + originY * outputStrideBytes + originX * sizeof(uint16_t);
+						if (i < decodeCount)
+						{
+							const RawStatisticsRows statistics(workerStatistics[worker], (tile % tilesAcross) * tileWidth, (tile / tilesAcross) * tileHeight, tileWidth);
+							tileErrors[tile] = DecodeLosslessImage(pWorkerContext, pTileOut, outputStrideBytes, pInCompressed + pTileOffsets[tile], pTileSizeBytes[tile],
+								tileWidth, tileHeight, parallelRestarts, draft, backend, &fellBack, statistics);
+						}
+						else
+							FillLosslessTile(pTileOut, outputStrideBytes, tileWidth / scale, tileHeight / scale, fillValue);
+					}
+				}
+			});
+			workerStatistics.Merge();
+
+			for (auto error : tileErrors)
+			{
+				if (error != Core::eError::None)
+					return error;
+			}
+			return Core::eError::None;
+		});
+
+		auto result = Core::eError::None;
+		for (uint32_t i = 0; i < tileCount; i++)
+		{
+			if (pTileErrors)
+				pTileErrors[i] = tileErrors[i];
+			if (result == Core::eError::None)
+				result = tileErrors[i];
+		}
+		return result;
+	}
+
+	extern "C" Core::eError DecodeLosslessTiles(LosslessJpegContext* pContext, uint8_t* pOut16Bit, uint32_t outputStrideBytes, uint8_t* pInCompressed,
+		const uint64_t* pTileOffsets, const uint32_t* pTileSizeBytes, uint32_t tileCount, uint32_t tilesAcross, uint32_t tileWidth, uint32_t tileHeight,
+		uint32_t bitDepth, bool draft, Core::eError* pTileErrors, sRawStatistics* pStatistics)
+	{
+		return DecodeLosslessTileRegion(pContext, pOut16Bit, outputStrideBytes, pInCompressed, pTileOffsets, pTileSizeBytes, tileCount, tilesAcross,
+			tileWidth, tileHeight, draft, nullptr, false, 0, pStatistics, pTileErrors);
+	}
+
+	extern "C" Core::eError DecodeLosslessTilesRegion(LosslessJpegContext* pContext, uint8_t* pOut16Bit, uint32_t outputStrideBytes, uint8_t* pInCompressed,
+		const uint64_t* pTileOffsets, const uint32_t* pTileSizeBytes, uint32_t tileCount, uint32_t tilesAcross, uint32_t tileWidth, uint32_t tileHeight,
+		uint32_t bitDepth, bool draft, uint32_t regionX, uint32_t regionY, uint32_t regionWidth, uint32_t regionHeight, bool fillOutside, uint16_t fillValue,
+		Core::eError* pTileErrors)
+	{
+		const sRegion region = { regionX, regionY, regionWidth, regionHeight };
+		return DecodeLosslessTileRegion(pContext, pOut16Bit, outputStrideBytes, pInCompressed, pTileOffsets, pTileSizeBytes, tileCount, tilesAcross,
+			tileWidth, tileHeight, draft, &region, fillOutside, fillValue, nullptr, pTileErrors);
+	}
 }
@@ -1,12 +1,74 @@
 #pragma once
 
 #include "../Api.h"
+#include "../RawStatistics.h"
 
 #include <stdint.h>
 
 namespace Octopus::Player::Decoders::Jpeg
 {
+	// Persistent decoder memory, one per decoding thread
+	class LosslessJpegContext;
+
+	// Decoders behind the lossless entry points. Auto times both on the first frames of a clip and keeps the faster one.
+	// Should match C# 'public enum Octopus.Player.Core.Decoders.Jpeg.LosslessBackend' in 'Jpeg.cs'
+	enum class eLosslessBackend : uint32_t
+	{
+		Auto,
+		DngSdk,
+		LibJpegTurbo
+	};
+
 DECODER_EXPORT_BEGIN
-	DECODER_EXPORT Core::eError DecodeLossless(uint8_t* pOut16Bit, uint8_t* pInCompressed, uint32_t compressedSizeBytes, uint32_t width, uint32_t height, uint32_t bitDepth);
+	DECODER_EXPORT uint32_t DecodeLosslessInputPaddingBytes();
+	DECODER_EXPORT LosslessJpegContext* CreateLosslessContext();
+	DECODER_EXPORT void DestroyLosslessContext(LosslessJpegContext* pContext);
+
+	// Forces a backend for every decode, overriding the OCTOPUS_LOSSLESS_JPEG_BACKEND environment variable (auto, dng-sdk
+	// or libjpeg-turbo). The DNG SDK decoder is used when the library is built without libjpeg-turbo.
+	DECODER_EXPORT void SetLosslessBackend(eLosslessBackend backend);
+
+	// Forgets the backends chosen automatically, so the first frames of the next clip are timed again
+	DECODER_EXPORT void ResetLosslessBackendSelection();
+
+	// Decodes a width x height image to (originX, originY) of an output image with rows outputStrideBytes apart.
+	// The samples are added to pStatistics, if given, as they are decoded.
+	DECODER_EXPORT Core::eError DecodeLossless(LosslessJpegContext* pContext, uint8_t* pOut16Bit, uint32_t outputStrideBytes, uint32_t originX, uint32_t originY,
+		uint8_t* pInCompressed, uint32_t compressedSizeBytes, uint32_t width, uint32_t height, uint32_t bitDepth, sRawStatistics* pStatistics);
+
+	// As DecodeLossless, but bins each 4x4 block of the Bayer image to one 2x2 CFA quad.
+	// The origin and stride are in the half width, half height draft output.
+	DECODER_EXPORT Core::eError DecodeLosslessDraft(LosslessJpegContext* pContext, uint8_t* pOut16Bit, uint32_t outputStrideBytes, uint32_t originX, uint32_t originY,
+		uint8_t* pInCompressed, uint32_t compressedSizeBytes, uint32_t width, uint32_t height, uint32_t bitDepth);
+
+	// Size of the checkpoint index DecodeLosslessIndexing writes for a stream, 0 if the stream can't be read.
+	DECODER_EXPORT uint32_t LosslessCheckpointIndexSizeBytes(const uint8_t* pInCompressed, uint32_t compressedSizeBytes);
+
+	// As DecodeLossless, also writing a checkpoint index of the stream to pIndex: the decoder state every few rows.
+	// The index is meant to be kept with the clip, so later decodes of the frame can use DecodeLosslessIndexed.
+	DECODER_EXPORT Core::eError DecodeLosslessIndexing(LosslessJpegContext* pContext, uint8_t* pOut16Bit, uint32_t outputStrideBytes, uint32_t originX, uint32_t originY,
+		uint8_t* pInCompressed, uint32_t compressedSizeBytes, uint32_t width, uint32_t height, uint32_t bitDepth, uint8_t* pIndex, uint32_t indexSizeBytes,
+		sRawStatistics* pStatistics);
+
+	// As DecodeLossless, decoding the row bands between the checkpoints of the stream's index on the native thread pool.
+	// An index that doesn't belong to the stream is ignored.
+	DECODER_EXPORT Core::eError DecodeLosslessIndexed(LosslessJpegContext* pContext, uint8_t* pOut16Bit, uint32_t outputStrideBytes, uint32_t originX, uint32_t originY,
+		uint8_t* pInCompressed, uint32_t compressedSizeBytes, uint32_t width, uint32_t height, uint32_t bitDepth, const uint8_t* pIndex, uint32_t indexSizeBytes,
+		sRawStatistics* pStatistics);
+
+	// Decodes every tile of a frame on the native thread pool. Tile i is read from pInCompressed + pTileOffsets[i]
+	// and written to its place in the frame, tiles being numbered left to right then top to bottom with tilesAcross
+	// tiles per row. Draft decodes bin each tile as DecodeLosslessDraft does. pTileErrors is optional, as is pStatistics, which
+	// gathers the full resolution samples of every tile, draft or not.
+	DECODER_EXPORT Core::eError DecodeLosslessTiles(LosslessJpegContext* pContext, uint8_t* pOut16Bit, uint32_t outputStrideBytes, uint8_t* pInCompressed,
+		const uint64_t* pTileOffsets, const uint32_t* pTileSizeBytes, uint32_t tileCount, uint32_t tilesAcross, uint32_t tileWidth, uint32_t tileHeight,
+		uint32_t bitDepth, bool draft, Core::eError* pTileErrors, sRawStatistics* pStatistics);
+
+	// As DecodeLosslessTiles, but only decodes the tiles intersecting the given rectangle of the full resolution frame.
+	// The other tiles are left untouched, or set to fillValue when fillOutside is true.
+	DECODER_EXPORT Core::eError DecodeLosslessTilesRegion(LosslessJpegContext* pContext, uint8_t* pOut16Bit, uint32_t outputStrideBytes, uint8_t* pInCompressed,
+		const uint64_t* pTileOffsets, const uint32_t* pTileSizeBytes, uint32_t tileCount, uint32_t tilesAcross, uint32_t tileWidth, uint32_t tileHeight,
+		uint32_t bitDepth, bool draft, uint32_t regionX, uint32_t regionY, uint32_t regionWidth, uint32_t regionHeight, bool fillOutside, uint16_t fillValue,
+		Core::eError* pTileErrors);
 DECODER_EXPORT_END
 }
@@ -0,0 +1,432 @@
+#include "LosslessJpegEncoder.h"
+
+// Two pass lossless JPEG (ITU T.81 Annex H) encoder: the first pass predicts every sample and gathers the
+// difference category statistics, the second writes the entropy coded segment with an optimal Huffman table.
+
+#include "JpegMarker.h"
+
+#include <algorithm>
+#include <vector>
+
+#ifdef _MSC_VER
+#define FORCE_INLINE __forceinline
+#include <intrin.h>
+#else
+#ifdef __clang__
+#define FORCE_INLINE __attribute__((always_inline))
+#else
+#define FORCE_INLINE inline
+#endif
+#endif
+
+namespace Octopus::Player::Decoders::Jpeg
+{
+	// Difference categories (SSSS) 0-16
+	static const uint32_t kCategoryCount = 17;
+
+	// Size of everything but the entropy coded segment, with room for a full Huffman table
+	static const uint32_t kHeaderSizeBytes = 2 + (2 + 6 + 3 * 4) + (2 + 3 + 16 + kCategoryCount) + (2 + 4) + (2 + 4 + 2 * 4 + 3) + 2;
+
+	// Number of significant bits of a non-zero value
+	static FORCE_INLINE uint32_t BitLength(uint32_t x)
+	{
+#ifdef _MSC_VER
+		unsigned long index;
+		_BitScanReverse(&index, x);
+		return (uint32_t)index + 1;
+#else
+		return 32 - __builtin_clz(x);
+#endif
+	}
+
+	// Section H.1.2.2: category of a difference modulo 2^16, 32768 being the only difference in category 16
+	static FORCE_INLINE uint32_t DifferenceCategory(int32_t diff)
+	{
+		if (diff == 0)
+			return 0;
+		return BitLength((uint32_t)(diff < 0 ? -diff : diff));
+	}
+
+	// Section H.1.2.1: predictor for the selection value (PSV)
+	template <int32_t kPsv>
+	static FORCE_INLINE int32_t Predict(int32_t left, int32_t upper, int32_t diag)
+	{
+		switch (kPsv)
+		{
+		case 1: return left;
+		case 2: return upper;
+		case 3: return diag;
+		case 4: return left + upper - diag;
+		case 5: return left + ((upper - diag) >> 1);
+		case 6: return upper + ((left - diag) >> 1);
+		default: return (left + upper) >> 1;
+		}
+	}
+
+	// Wraps a prediction error to the signed 16-bit range coded by lossless JPEG
+	static FORCE_INLINE int16_t WrapDifference(int32_t diff)
+	{
+		return (int16_t)(uint16_t)diff;
+	}
+
+	// Predicts a row of samples, pUpper is null for the first row of a restart interval
+	template <int32_t kPsv>
+	static void PredictRow(int16_t* pDiff, const uint16_t* pRow, const uint16_t* pUpper, uint32_t rowSamples, uint32_t components,
+		int32_t initialPredictor, uint32_t* pHistogram)
+	{
+		for (uint32_t c = 0; c < components; c++)
+			pDiff[c] = WrapDifference((int32_t)pRow[c] - (pUpper ? (int32_t)pUpper[c] : initialPredictor));
+
+		if (!pUpper)
+		{
+			for (uint32_t i = components; i < rowSamples; i++)
+				pDiff[i] = WrapDifference((int32_t)pRow[i] - (int32_t)pRow[i - components]);
+		}
+		else
+		{
+			for (uint32_t i = components; i < rowSamples; i++)
+				pDiff[i] = WrapDifference((int32_t)pRow[i] - Predict<kPsv>(pRow[i - components], pUpper[i], pUpper[i - components]));
+		}
+
+		for (uint32_t i = 0; i < rowSamples; i++)
+			pHistogram[DifferenceCategory(pDiff[i])]++;
+	}
+
+	typedef void (*PredictRowFunction)(int16_t*, const uint16_t*, const uint16_t*, uint32_t, uint32_t, int32_t, uint32_t*);
+
+	static const PredictRowFunction kPredictRow[8] = { nullptr, PredictRow<1>, PredictRow<2>, PredictRow<3>, PredictRow<4>, PredictRow<5>, PredictRow<6>, PredictRow<7> };
+
+	struct sHuffmanTable
+	{
+		uint8_t bits[17];					// bits[l] codes of length l
+		uint8_t values[kCategoryCount];		// Categories in order of increasing code length
+		uint32_t valueCount;
+		uint16_t code[kCategoryCount];
+		uint8_t codeLength[kCategoryCount];
+	};
+
+	// Section K.2: code lengths from the category frequencies, limited to 16 bits.
+	// A reserved symbol with a count of one keeps any code from being all ones.
+	static void BuildHuffmanTable(const uint32_t* pHistogram, sHuffmanTable& table)
+	{
+		const uint32_t symbolCount = kCategoryCount + 1;
+		uint64_t freq[symbolCount];
+		int32_t codeSize[symbolCount];
+		int32_t others[symbolCount];
+		for (uint32_t i = 0; i < symbolCount; i++)
+		{
+			freq[i] = i < kCategoryCount ? pHistogram[i] : 1;
+			codeSize[i] = 0;
+			others[i] = -1;
+		}
+
+		while (true)
+		{
+			// Least frequent symbol, then the next least frequent
+			int32_t c1 = -1;
+			for (int32_t i = 0; i < (int32_t)symbolCount; i++)
+			{
+				if (freq[i] && (c1 < 0 || freq[i] <= freq[c1]))
+					c1 = i;
+			}
+			int32_t c2 = -1;
+			for (int32_t i = 0; i < (int32_t)symbolCount; i++)
+			{
+				if (freq[i] && i != c1 && (c2 < 0 || freq[i] <= freq[c2]))
+					c2 = i;
+			}
+			if (c2 < 0)
+				break;
+
+			freq[c1] += freq[c2];
+			freq[c2] = 0;
+
+			codeSize[c1]++;
+			while (others[c1] >= 0)
+			{
+				c1 = others[c1];
+				codeSize[c1]++;
+			}
+			others[c1] = c2;
+
+			codeSize[c2]++;
+			while (others[c2] >= 0)
+			{
+				c2 = others[c2];
+				codeSize[c2]++;
+			}
+		}
+
+		// Section K.3: count the codes of each length, then move codes longer than 16 bits up the tree
+		uint32_t bits[33] = {};
+		for (uint32_t i = 0; i < symbolCount; i++)
+		{
+			if (codeSize[i])
+				bits[codeSize[i]]++;
+		}
+		for (uint32_t i = 32; i > 16; i--)
+		{
+			while (bits[i] > 0)
+			{
+				uint32_t j = i - 2;
+				while (bits[j] == 0)
+					j--;
+				bits[i] -= 2;
+				bits[i - 1]++;
+				bits[j + 1] += 2;
+				bits[j]--;
+			}
+		}
+
+		// Drop the reserved symbol, it has the longest code
+		uint32_t longest = 16;
+		while (bits[longest] == 0)
+			longest--;
+		bits[longest]--;
+
+		table.bits[0] = 0;
+		for (uint32_t l = 1; l <= 16; l++)
+			table.bits[l] = (uint8_t)bits[l];
+
+		// Section K.4: categories sorted by code size
+		table.valueCount = 0;
+		for (int32_t l = 1; l <= 32; l++)
+		{
+			for (uint32_t i = 0; i < kCategoryCount; i++)
+			{
+				if (codeSize[i] == l)
+					table.values[table.valueCount++] = (uint8_t)i;
+			}
+		}
+
+		// Section C.2: canonical codes
+		std::fill(table.codeLength, table.codeLength + kCategoryCount, 0);
+		uint32_t code = 0;
+		uint32_t k = 0;
+		for (uint32_t l = 1; l <= 16; l++)
+		{
+			for (uint32_t i = 0; i < table.bits[l]; i++, k++)
+			{
+				table.code[table.values[k]] = (uint16_t)code++;
+				table.codeLength[table.values[k]] = (uint8_t)l;
+			}
+			code <<= 1;
+		}
+	}
+
+	// Big endian bit writer with 0xFF byte stuffing
+	class BitWriter
+	{
+	public:
+
+		BitWriter(uint8_t* pOut, uint8_t* pEnd)
+			: m_pOut(pOut)
+			, m_pEnd(pEnd)
+			, m_buffer(0)
+			, m_bitCount(0)
+			, m_overflow(false)
+		{}
+
+		// Appends up to 32 bits
+		FORCE_INLINE void Put(uint32_t value, uint32_t length)
+		{
+			m_buffer = (m_buffer << length) | value;
+			m_bitCount += length;
+			if (m_bitCount >= 32)
+				Drain();
+		}
+
+		// Pads the last byte with one bits, as required before a marker or the end of the image
+		void Flush()
+		{
+			const auto padding = (8 - (m_bitCount & 7)) & 7;
+			Put((1u << padding) - 1, padding);
+			Drain();
+		}
+
+		void PutMarker(uint8_t marker)
+		{
+			PutByte(0xFF);
+			PutByte(marker);
+		}
+
+		void PutByte(uint8_t byte)
+		{
+			if (m_pOut == m_pEnd)
+			{
+				m_overflow = true;
+				return;
+			}
+			*m_pOut++ = byte;
+		}
+
+		void PutShort(uint16_t value)
+		{
+			PutByte((uint8_t)(value >> 8));
+			PutByte((uint8_t)value);
+		}
+
+		uint8_t* Position() const { return m_pOut; }
+		bool Overflow() const { return m_overflow; }
+
+	private:
+
+		// Writes out all whole bytes, four at a time when none of them needs stuffing
+		FORCE_INLINE void Drain()
+		{
+			if (m_bitCount >= 32 && m_pEnd - m_pOut >= 4)
+			{
+				const auto word = (uint32_t)(m_buffer >> (m_bitCount - 32));
+				const auto inverted = ~word;
+				if (((inverted - 0x01010101u) & ~inverted & 0x80808080u) == 0)
+				{
+					m_pOut[0] = (uint8_t)(word >> 24);
+					m_pOut[1] = (uint8_t)(word >> 16);
+					m_pOut[2] = (uint8_t)(word >> 8);
+					m_pOut[3] = (uint8_t)word;
+					m_pOut += 4;
+					m_bitCount -= 32;
+				}
+			}
+
+			while (m_bitCount >= 8)
+			{
+				m_bitCount -= 8;
+				const auto byte = (uint8_t)(m_buffer >> m_bitCount);
+				PutByte(byte);
+				if (byte == 0xFF)
+					PutByte(0);
+			}
+		}
+
+		uint8_t* m_pOut;
+		uint8_t* m_pEnd;
+		uint64_t m_buffer;
+		uint32_t m_bitCount;
+		bool m_overflow;
+	};
+
+	// Section F.1.2.1.1: Huffman code of the category followed by the low bits of the difference (one less if negative)
+	static FORCE_INLINE void EncodeDifference(BitWriter& writer, const sHuffmanTable& table, int32_t diff)
+	{
+		if (diff == -32768)
+		{
+			writer.Put(table.code[16], table.codeLength[16]);
+			return;
+		}
+
+		const auto category = DifferenceCategory(diff);
+		const auto extra = (uint32_t)(diff < 0 ? diff - 1 : diff) & ((1u << category) - 1);
+		writer.Put(((uint32_t)table.code[category] << category) | extra, table.codeLength[category] + category);
+	}
+
+	extern "C" uint32_t EncodeLosslessMaxSizeBytes(uint32_t width, uint32_t height)
+	{
+		// At most 31 bits a sample, every byte of which may need stuffing, and a marker plus padding byte per restart
+		const auto maxSize = (uint64_t)kHeaderSizeBytes + (uint64_t)width * height * 8 + (uint64_t)height * 3;
+		return (uint32_t)std::min<uint64_t>(maxSize, UINT32_MAX);
+	}
+
+	extern "C" Core::eError EncodeLossless(uint8_t* pOutCompressed, uint32_t outputCapacityBytes, uint32_t* pCompressedSizeBytes, const uint8_t* pIn16Bit,
+		uint32_t inputStrideBytes, uint32_t width, uint32_t height, uint32_t bitDepth, uint32_t components, uint32_t predictor, uint32_t restartIntervalRows)
+	{
+		if (pCompressedSizeBytes)
+			*pCompressedSizeBytes = 0;
+
+		// Frame limits of the SOF3 and DRI segments
+		if (components < 1 || components > 4 || width == 0 || height == 0 || width % components != 0)
+			return Core::eError::NotImplmeneted;
+		const auto columns = width / components;
+		if (columns > 0xFFFF || height > 0xFFFF || bitDepth < 2 || bitDepth > 16 || predictor < 1 || predictor > 7)
+			return Core::eError::NotImplmeneted;
+		if ((uint64_t)restartIntervalRows * columns > 0xFFFF)
+			return Core::eError::NotImplmeneted;
+
+		// First pass, prediction errors and their category statistics
+		std::vector<int16_t> differences((size_t)width * height);
+		uint32_t histogram[kCategoryCount] = {};
+		const auto predictRow = kPredictRow[predictor];
+		const auto initialPredictor = 1 << (bitDepth - 1);
+		for (uint32_t row = 0; row < height; row++)
+		{
+			const auto pRow = (const uint16_t*)(pIn16Bit + (size_t)row * inputStrideBytes);
+			const bool intervalStart = restartIntervalRows ? (row % restartIntervalRows == 0) : (row == 0);
+			const auto pUpper = intervalStart ? nullptr : (const uint16_t*)(pIn16Bit + (size_t)(row - 1) * inputStrideBytes);
+			predictRow(differences.data() + (size_t)row * width, pRow, pUpper, width, components, initialPredictor, histogram);
+		}
+
+		sHuffmanTable table;
+		BuildHuffmanTable(histogram, table);
+
+		BitWriter writer(pOutCompressed, pOutCompressed + outputCapacityBytes);
+		writer.PutMarker(M_SOI);
+
+		writer.PutMarker(M_SOF3);
+		writer.PutShort((uint16_t)(8 + 3 * components));
+		writer.PutByte((uint8_t)bitDepth);
+		writer.PutShort((uint16_t)height);
+		writer.PutShort((uint16_t)columns);
+		writer.PutByte((uint8_t)components);
+		for (uint32_t c = 0; c < components; c++)
+		{
+			writer.PutByte((uint8_t)c);
+			writer.PutByte(0x11);
+			writer.PutByte(0);
+		}
+
+		// Every component shares DC table 0
+		writer.PutMarker(M_DHT);
+		writer.PutShort((uint16_t)(2 + 1 + 16 + table.valueCount));
+		writer.PutByte(0);
+		for (uint32_t l = 1; l <= 16; l++)
+			writer.PutByte(table.bits[l]);
+		for (uint32_t i = 0; i < table.valueCount; i++)
+			writer.PutByte(table.values[i]);
+
+		if (restartIntervalRows)
+		{
+			writer.PutMarker(M_DRI);
+			writer.PutShort(4);
+			writer.PutShort((uint16_t)(restartIntervalRows * columns));
+		}
+
+		writer.PutMarker(M_SOS);
+		writer.PutShort((uint16_t)(6 + 2 * components));
+		writer.PutByte((uint8_t)components);
+		for (uint32_t c = 0; c < components; c++)
+		{
+			writer.PutByte((uint8_t)c);
+			writer.PutByte(0);
+		}
+		writer.PutByte((uint8_t)predictor);
+		writer.PutByte(0);
+		writer.PutByte(0);
+
+		// Second pass, the entropy coded segment
+		uint32_t restartIndex = 0;
+		for (uint32_t row = 0; row < height; row++)
+		{
+			if (restartIntervalRows && row && row % restartIntervalRows == 0)
+			{
+				writer.Flush();
+				writer.PutMarker((uint8_t)(M_RST0 + restartIndex));
+				restartIndex = (restartIndex + 1) & 7;
+			}
+
+			const auto pDiff = differences.data() + (size_t)row * width;
+			for (uint32_t i = 0; i < width; i++)
+				EncodeDifference(writer, table, pDiff[i]);
+
+			if (writer.Overflow())
+				return Core::eError::BadImageData;
+		}
+		writer.Flush();
+		writer.PutMarker(M_EOI);
+
+		if (writer.Overflow())
+			return Core::eError::BadImageData;
+		if (pCompressedSizeBytes)
+			*pCompressedSizeBytes = (uint32_t)(writer.Position() - pOutCompressed);
+		return Core::eError::None;
+	}
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "../Api.h"
+
+#include <stdint.h>
+
+namespace Octopus::Player::Decoders::Jpeg
+{
+DECODER_EXPORT_BEGIN
+	// Upper bound of the encoded size of a width x height image, for sizing the output of EncodeLossless
+	DECODER_EXPORT uint32_t EncodeLosslessMaxSizeBytes(uint32_t width, uint32_t height);
+
+	// Encodes a width x height image of 16-bit samples, with rows inputStrideBytes apart, as a lossless (SOF3) JPEG.
+	// Rows are coded as width / components pixels of interleaved components, DNG stores Bayer tiles with two components
+	// so that DecodeLossless can decode the result with the same width and height.
+	// predictor is the selection value (1-7) and a restart interval starts every restartIntervalRows rows (0 = none).
+	DECODER_EXPORT Core::eError EncodeLossless(uint8_t* pOutCompressed, uint32_t outputCapacityBytes, uint32_t* pCompressedSizeBytes, const uint8_t* pIn16Bit,
+		uint32_t inputStrideBytes, uint32_t width, uint32_t height, uint32_t bitDepth, uint32_t components, uint32_t predictor, uint32_t restartIntervalRows);
+DECODER_EXPORT_END
+}
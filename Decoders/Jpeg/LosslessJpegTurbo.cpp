@@ -0,0 +1,183 @@
+#include "LosslessJpegTurbo.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <vector>
+
+#ifndef DECODERS_WITHOUT_LIBJPEG_TURBO
+#include <setjmp.h>
+#include <jpeglib.h>
+#endif
+
+namespace Octopus::Player::Decoders::Jpeg
+{
+#ifndef DECODERS_WITHOUT_LIBJPEG_TURBO
+	// libjpeg reports fatal errors through error_exit, which must not return to the library
+	struct sTurboErrorManager
+	{
+		jpeg_error_mgr manager;
+		jmp_buf jump;
+	};
+
+	static void TurboErrorExit(j_common_ptr pInfo)
+	{
+		longjmp(((sTurboErrorManager*)pInfo->err)->jump, 1);
+	}
+
+	// Corrupt data is reported as warnings, which are counted rather than printed
+	static void TurboOutputMessage(j_common_ptr)
+	{
+	}
+
+	struct LosslessJpegTurboDecoder::sState
+	{
+		jpeg_decompress_struct decompress;
+		sTurboErrorManager error;
+		std::vector<uint8_t*> rows;
+		std::vector<uint8_t> row8Bit;
+		bool started = false;
+	};
+
+	bool LosslessJpegTurboDecoder::Available()
+	{
+		return true;
+	}
+
+	LosslessJpegTurboDecoder::LosslessJpegTurboDecoder()
+		: m_pState(new sState())
+	{
+		m_pState->decompress.err = jpeg_std_error(&m_pState->error.manager);
+		m_pState->error.manager.error_exit = TurboErrorExit;
+		m_pState->error.manager.output_message = TurboOutputMessage;
+		jpeg_create_decompress(&m_pState->decompress);
+	}
+
+	LosslessJpegTurboDecoder::~LosslessJpegTurboDecoder()
+	{
+		jpeg_destroy_decompress(&m_pState->decompress);
+	}
+
+	bool LosslessJpegTurboDecoder::StartRead(const uint8_t* pInCompressed, uint32_t compressedSizeBytes, uint32_t& width, uint32_t& height, uint32_t& channels)
+	{
+		auto& state = *m_pState;
+		auto& decompress = state.decompress;
+
+		// Releases whatever a previous stream left behind, the decompressor keeps its memory pools
+		jpeg_abort_decompress(&decompress);
+		state.started = false;
+		state.error.manager.num_warnings = 0;
+
+		if (setjmp(state.error.jump))
+		{
+			jpeg_abort_decompress(&decompress);
+			return false;
+		}
+
+		jpeg_mem_src(&decompress, pInCompressed, compressedSizeBytes);
+		if (jpeg_read_header(&decompress, TRUE) != JPEG_HEADER_OK)
+			return false;
+
+		// Lossless streams are never subsampled, and their components are decoded as they are stored
+		for (int i = 0; i < decompress.num_components; i++)
+		{
+			if (decompress.comp_info[i].h_samp_factor != 1 || decompress.comp_info[i].v_samp_factor != 1)
+				return false;
+		}
+		decompress.jpeg_color_space = JCS_UNKNOWN;
+		decompress.out_color_space = JCS_UNKNOWN;
+
+		width = decompress.image_width;
+		height = decompress.image_height;
+		channels = decompress.num_components;
+		state.started = true;
+		return true;
+	}
+
+	Core::eError LosslessJpegTurboDecoder::FinishRead(uint8_t* pOut16Bit, uint64_t outputStrideBytes, RawStatisticsRows* pStatistics)
+	{
+		auto& state = *m_pState;
+		auto& decompress = state.decompress;
+		if (!state.started)
+			return Core::eError::BadFile;
+		state.started = false;
+
+		if (setjmp(state.error.jump))
+		{
+			jpeg_abort_decompress(&decompress);
+			return Core::eError::BadImageData;
+		}
+
+		jpeg_start_decompress(&decompress);
+
+		const auto height = decompress.output_height;
+		state.rows.resize(height);
+		for (JDIMENSION row = 0; row < height; row++)
+			state.rows[row] = pOut16Bit + row * outputStrideBytes;
+
+		// Samples come in the smallest of the 8, 12 and 16-bit containers that holds the precision
+		const auto rowSamples = (size_t)decompress.output_width * decompress.output_components;
+		if (decompress.data_precision <= 8)
+			state.row8Bit.resize(rowSamples);
+
+		while (decompress.output_scanline < height)
+		{
+			const auto scanline = decompress.output_scanline;
+			JDIMENSION rowsRead;
+			if (decompress.data_precision > 12)
+				rowsRead = jpeg16_read_scanlines(&decompress, (J16SAMPARRAY)(state.rows.data() + scanline), height - scanline);
+			else if (decompress.data_precision > 8)
+				rowsRead = jpeg12_read_scanlines(&decompress, (J12SAMPARRAY)(state.rows.data() + scanline), height - scanline);
+			else
+			{
+				JSAMPROW pRow = state.row8Bit.data();
+				rowsRead = jpeg_read_scanlines(&decompress, &pRow, 1);
+				auto pOut = (uint16_t*)state.rows[scanline];
+				for (size_t i = 0; i < rowSamples; i++)
+					pOut[i] = state.row8Bit[i];
+			}
+
+			if (rowsRead == 0)
+			{
+				jpeg_abort_decompress(&decompress);
+				return Core::eError::BadImageData;
+			}
+
+			if (pStatistics)
+			{
+				for (JDIMENSION row = scanline; row < scanline + rowsRead; row++)
+					pStatistics->Accumulate((const uint16_t*)state.rows[row], rowSamples);
+			}
+		}
+
+		jpeg_finish_decompress(&decompress);
+		return state.error.manager.num_warnings ? Core::eError::BadImageData : Core::eError::None;
+	}
+#else
+	struct LosslessJpegTurboDecoder::sState
+	{
+	};
+
+	bool LosslessJpegTurboDecoder::Available()
+	{
+		return false;
+	}
+
+	LosslessJpegTurboDecoder::LosslessJpegTurboDecoder()
+	{
+	}
+
+	LosslessJpegTurboDecoder::~LosslessJpegTurboDecoder()
+	{
+	}
+
+	bool LosslessJpegTurboDecoder::StartRead(const uint8_t* pInCompressed, uint32_t compressedSizeBytes, uint32_t& width, uint32_t& height, uint32_t& channels)
+	{
+		return false;
+	}
+
+	Core::eError LosslessJpegTurboDecoder::FinishRead(uint8_t* pOut16Bit, uint64_t outputStrideBytes, RawStatisticsRows* pStatistics)
+	{
+		return Core::eError::NotImplmeneted;
+	}
+#endif
+}
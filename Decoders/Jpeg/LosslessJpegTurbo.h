@@ -0,0 +1,35 @@
+#pragma once
+
+#include "../Api.h"
+#include "../RawStatistics.h"
+
+#include <stdint.h>
+#include <memory>
+
+namespace Octopus::Player::Decoders::Jpeg
+{
+	// Lossless (SOF3) decoding through libjpeg-turbo 3, the alternative to the DNG SDK derived decoder of LosslessJpeg.cpp.
+	// The decompressor is created once and reused by every stream decoded on the owning thread.
+	class LosslessJpegTurboDecoder
+	{
+	public:
+
+		// False when the library was built without libjpeg-turbo 3
+		static bool Available();
+
+		LosslessJpegTurboDecoder();
+		~LosslessJpegTurboDecoder();
+
+		// Reads the headers of a stream, its rows are width samples of channels interleaved components
+		bool StartRead(const uint8_t* pInCompressed, uint32_t compressedSizeBytes, uint32_t& width, uint32_t& height, uint32_t& channels);
+
+		// Decodes the stream opened by StartRead to 16-bit rows outputStrideBytes apart, adding each batch of rows to pStatistics as it is read
+		Core::eError FinishRead(uint8_t* pOut16Bit, uint64_t outputStrideBytes, RawStatisticsRows* pStatistics = nullptr);
+
+	private:
+
+		// Keeps jpeglib.h out of the lossless decoder
+		struct sState;
+		std::unique_ptr<sState> m_pState;
+	};
+}
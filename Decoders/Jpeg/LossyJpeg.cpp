@@ -1,9 +1,23 @@
 #include "LossyJpeg.h"
+#include "../Draft.h"
+#include "../ThreadPool.h"
 
+#include <setjmp.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <jpeglib.h>
 #include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
 
 // Bit hacky, this needs to match the internal header jpegint.h
 struct jpeg_decomp_master 
@@ -31,104 +45,428 @@ struct jpeg_decomp_master
 
 namespace Octopus::Player::Decoders::Jpeg
 {
-    extern "C" bool IsLossy(uint8_t* pInCompressed, uint32_t compressedSizeBytes)
+	// libjpeg reports fatal errors through error_exit, which must not return to the library
+	struct sLossyErrorManager
 	{
-		jpeg_decompress_struct context;
-		jpeg_error_mgr errorManager;
-        
-		context.err = jpeg_std_error(&errorManager);
-		jpeg_create_decompress(&context);
+		jpeg_error_mgr manager;
+		jmp_buf jump;
+	};
 
-		jpeg_mem_src(&context, pInCompressed, compressedSizeBytes);
+	static void LossyErrorExit(j_common_ptr pInfo)
+	{
+		longjmp(((sLossyErrorManager*)pInfo->err)->jump, 1);
+	}
 
-		if ( jpeg_read_header(&context, TRUE) != JPEG_HEADER_OK)
-		{
-			jpeg_destroy_decompress(&context);
-			return false;
-		}
+	// Corrupt data is reported as warnings, the damaged part of the image is decoded as best it can be
+	static void LossyOutputMessage(j_common_ptr)
+	{
+	}
+
+	// Rectangle of an image to decode, in its pixels
+	struct sLossyRegion
+	{
+		uint32_t x;
+		uint32_t y;
+		uint32_t width;
+		uint32_t height;
+	};
 
-		const auto lossy = (context.data_precision == 12 || context.data_precision == 16) && !context.master->lossless;
+	// Scanlines asked of each read, enough for a whole iMCU row of any sampling so a read does all the work it can
+	constexpr JDIMENSION kLossyScanlinesPerRead = 16;
 
-		jpeg_destroy_decompress(&context);
-		return lossy;
+	// Promotes samples of a lower precision than the frame to its bit depth
+	static void PromoteSamples(uint16_t* pSamples, size_t count, uint32_t shift)
+	{
+		size_t i = 0;
+#if defined(__AVX2__)
+		const __m128i shift256 = _mm_cvtsi32_si128((int)shift);
+		for (; i + 16 <= count; i += 16)
+		{
+			const __m256i v = _mm256_loadu_si256((const __m256i*)(pSamples + i));
+			_mm256_storeu_si256((__m256i*)(pSamples + i), _mm256_sll_epi16(v, shift256));
+		}
+#endif
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+		const __m128i shift128 = _mm_cvtsi32_si128((int)shift);
+		for (; i + 8 <= count; i += 8)
+		{
+			const __m128i v = _mm_loadu_si128((const __m128i*)(pSamples + i));
+			_mm_storeu_si128((__m128i*)(pSamples + i), _mm_sll_epi16(v, shift128));
+		}
+#endif
+		for (; i < count; i++)
+			pSamples[i] = (uint16_t)(pSamples[i] << shift);
 	}
 
-	extern "C" Core::eError DecodeLossy(uint8_t* pOut16Bit, uint8_t* pInCompressed, uint32_t compressedSizeBytes, uint32_t width, uint32_t height,
-        uint32_t bitDepth)
+	// Persistent libjpeg-turbo decompressor for lossy decodes, intended to be kept per decoding thread.
+	// Between streams the decompressor is only aborted, so its permanent memory pool and the scanline buffer are reused
+	// rather than set up again for every tile.
+	class LossyJpegContext
 	{
-		jpeg_decompress_struct context;
-		jpeg_error_mgr errorManager;
+	public:
+
+		LossyJpegContext()
+		{
+			m_decompress.err = jpeg_std_error(&m_error.manager);
+			m_error.manager.error_exit = LossyErrorExit;
+			m_error.manager.output_message = LossyOutputMessage;
+			jpeg_create_decompress(&m_decompress);
+		}
+
+		~LossyJpegContext()
+		{
+			jpeg_destroy_decompress(&m_decompress);
+		}
+
+		// Reads the headers of a stream, releasing whatever the previous stream left behind
+		bool ReadHeader(const uint8_t* pInCompressed, uint32_t compressedSizeBytes, sJpegInfo& info)
+		{
+			jpeg_abort_decompress(&m_decompress);
+			if (setjmp(m_error.jump))
+			{
+				jpeg_abort_decompress(&m_decompress);
+				return false;
+			}
+
+			jpeg_mem_src(&m_decompress, pInCompressed, compressedSizeBytes);
+			if (jpeg_read_header(&m_decompress, TRUE) != JPEG_HEADER_OK)
+				return false;
+
+			info.width = m_decompress.image_width;
+			info.height = m_decompress.image_height;
+			info.components = m_decompress.num_components;
+			info.precision = m_decompress.data_precision;
+			info.lossy = (m_decompress.data_precision == 12 || m_decompress.data_precision == 16) && !m_decompress.master->lossless;
+			return true;
+		}
+
+		// Decodes the stream opened by ReadHeader, or only pRegion of it, see DecodeLossy, DecodeLossyDraft and DecodeLossyRegion
+		Core::eError Decode(uint8_t* pOut16Bit, uint32_t outputStrideBytes, uint32_t originX, uint32_t originY, uint32_t width, uint32_t height,
+			uint32_t bitDepth, sRawStatistics* pStatistics, bool draft, const sLossyRegion* pRegion = nullptr);
+
+		// Writes the DC term of each block of the stream opened by ReadHeader as a thumbnail, see DecodeLossyThumbnails
+		Core::eError DecodeThumbnail(uint8_t* pOut16Bit, uint32_t outputStrideBytes, uint32_t originX, uint32_t originY, uint32_t width, uint32_t height,
+			uint32_t bitDepth);
+
+	private:
+
+		// Buffer for decodes that can't be written in place, kept between decodes
+		uint8_t* ScratchBuffer(size_t size)
+		{
+			if (size > m_scratch.size())
+				m_scratch.resize(size);
+			return m_scratch.data();
+		}
+
+		uint8_t** ScanlinePointers(size_t count)
+		{
+			if (count > m_scanlines.size())
+				m_scanlines.resize(count);
+			return m_scanlines.data();
+		}
 
-		context.err = jpeg_std_error(&errorManager);
-		jpeg_create_decompress(&context);
+		jpeg_decompress_struct m_decompress;
+		sLossyErrorManager m_error;
+		std::vector<uint8_t> m_scratch;
+		std::vector<uint8_t*> m_scanlines;
+	};
 
-		jpeg_mem_src(&context, pInCompressed, compressedSizeBytes);
+	Core::eError LossyJpegContext::Decode(uint8_t* pOut16Bit, uint32_t outputStrideBytes, uint32_t originX, uint32_t originY, uint32_t width, uint32_t height,
+		uint32_t bitDepth, sRawStatistics* pStatistics, bool draft, const sLossyRegion* pRegion)
+	{
+		auto& context = m_decompress;
+		if (context.data_precision != 12 && context.data_precision != 16)
+		{
+			jpeg_abort_decompress(&context);
+			return Core::eError::BadMetadata;
+		}
 
-		if ( jpeg_read_header(&context, TRUE) != JPEG_HEADER_OK )
+		if (setjmp(m_error.jump))
 		{
-			jpeg_destroy_decompress(&context);
+			jpeg_abort_decompress(&context);
 			return Core::eError::BadImageData;
 		}
 
 		jpeg_start_decompress(&context);
 
-		const auto stride = context.output_width * context.output_components * sizeof(short);
+		// Scanlines are decoded in place when they match rows of the output, and are contiguous
+		// when the output is dense. Otherwise they go through the scratch buffer, as draft decodes always do.
+		const auto pOut = pOut16Bit + (size_t)originY * outputStrideBytes + originX * sizeof(uint16_t);
+		const auto rowSizeBytes = width * sizeof(uint16_t);
+		const bool sameRows = (context.output_width * context.output_components * sizeof(short) == rowSizeBytes);
+		const bool inPlace = !draft && (sameRows || outputStrideBytes == rowSizeBytes);
 
-		switch (context.data_precision)
+		// Regions are cropped to whole iMCU columns, and the rows above them are skipped without an inverse DCT.
+		// Only 12-bit DCT streams whose scanlines are rows of the image can be cropped, others are decoded whole.
+		JDIMENSION firstRow = 0;
+		JDIMENSION endRow = context.output_height;
+		size_t cropOffsetBytes = 0;
+		if (pRegion && sameRows && !draft && context.data_precision == 12)
 		{
-		case 12:
-			while (context.output_scanline < context.output_height)
+			const auto components = (JDIMENSION)context.output_components;
+			auto cropColumn = std::min<JDIMENSION>(pRegion->x / components, context.output_width);
+			auto cropWidth = std::min<JDIMENSION>((pRegion->x + pRegion->width + components - 1) / components, context.output_width) - cropColumn;
+			firstRow = std::min<JDIMENSION>(pRegion->y, context.output_height);
+			endRow = std::min<JDIMENSION>(pRegion->y + pRegion->height, context.output_height);
+			if (cropWidth == 0 || endRow <= firstRow)
 			{
-				uint8_t* scanlines[4];
-				scanlines[0] = pOut16Bit + (context.output_scanline * stride);
-				scanlines[1] = scanlines[0] + stride;
-				scanlines[2] = scanlines[1] + stride;
-				scanlines[3] = scanlines[2] + stride;
-
-				if (jpeg12_read_scanlines(&context, J12SAMPARRAY(scanlines), 4) == 0)
-				{
-					jpeg_abort_decompress(&context);
-					jpeg_destroy_decompress(&context);
-					return Core::eError::BadImageData;
-				}
+				jpeg_abort_decompress(&context);
+				return Core::eError::None;
 			}
 
-			// Work around for weird behaviour from RAW Converter creating 16-bit dngs with 12-bit jpeg data
-			// This could be moved to the GPU pipeline...
-			if (bitDepth > context.data_precision)
+			jpeg12_crop_scanline(&context, &cropColumn, &cropWidth);
+			cropOffsetBytes = (size_t)cropColumn * components * sizeof(uint16_t);
+			if (firstRow > 0 && jpeg12_skip_scanlines(&context, firstRow) != firstRow)
 			{
-				const auto shift = bitDepth - context.data_precision;
-				const auto pData = (uint16_t*)pOut16Bit;
-				const auto pixelCount = width * height;
-				for (int i = 0; i < pixelCount; i++)
-					pData[i] = pData[i] << shift;
+				jpeg_abort_decompress(&context);
+				return Core::eError::BadImageData;
 			}
-			break;
-		case 16:
-			while (context.output_scanline < context.output_height)
+		}
+
+		const auto scanlineSizeBytes = context.output_width * context.output_components * sizeof(short);
+		const auto pDecode = inPlace ? pOut + cropOffsetBytes : ScratchBuffer((size_t)scanlineSizeBytes * context.output_height);
+		const auto stride = (inPlace && sameRows) ? outputStrideBytes : scanlineSizeBytes;
+
+		// Work around for weird behaviour from RAW Converter creating 16-bit dngs with 12-bit jpeg data
+		// This could be moved to the GPU pipeline...
+		const auto shift = (context.data_precision == 12 && bitDepth > 12) ? bitDepth - 12 : 0;
+
+		// Scanlines are promoted and added to the statistics as they are read, while they are still in the cache.
+		// Draft decodes bin every four whole rows of the image to the output as soon as they are decoded.
+		RawStatisticsRows statistics((draft || pRegion) ? nullptr : pStatistics, originX, originY, width);
+		uint32_t binnedRows = 0;
+		const auto scanlineSamples = scanlineSizeBytes / sizeof(uint16_t);
+		const auto FinishScanlines = [&](JDIMENSION firstScanline, JDIMENSION scanlineCount)
+		{
+			for (auto scanline = firstScanline; scanline < firstScanline + scanlineCount; scanline++)
 			{
-				uint8_t* scanlines[4];
-				scanlines[0] = pOut16Bit + (context.output_scanline * stride);
-				scanlines[1] = scanlines[0] + stride;
-				scanlines[2] = scanlines[1] + stride;
-				scanlines[3] = scanlines[2] + stride;
+				const auto pData = (uint16_t*)(pDecode + scanline * stride);
+				if (shift)
+					PromoteSamples(pData, scanlineSamples, shift);
+				if (statistics.Enabled())
+					statistics.Accumulate(pData, scanlineSamples);
+			}
 
-				if (jpeg16_read_scanlines(&context, J16SAMPARRAY(scanlines), 4) == 0)
+			if (draft)
+			{
+				const auto decodedRows = (uint32_t)std::min<uint64_t>((uint64_t)(firstScanline + scanlineCount) * scanlineSizeBytes / rowSizeBytes, height);
+				const auto binRows = decodedRows / 4 * 4;
+				if (binRows > binnedRows)
 				{
-					jpeg_abort_decompress(&context);
-					jpeg_destroy_decompress(&context);
-					return Core::eError::BadImageData;
+					BinBayerDraft<uint16_t>(pOut + (binnedRows / 2) * outputStrideBytes, outputStrideBytes, pDecode + binnedRows * rowSizeBytes, rowSizeBytes,
+						width, binRows - binnedRows);
+					binnedRows = binRows;
 				}
 			}
-			break;
-		default:
+		};
+
+		// Reads are a whole number of the decompressor's preferred row groups
+		const auto rowGroup = (JDIMENSION)std::max(context.rec_outbuf_height, 1);
+		const auto scanlinesPerRead = (kLossyScanlinesPerRead + rowGroup - 1) / rowGroup * rowGroup;
+		const auto pScanlines = ScanlinePointers(scanlinesPerRead);
+		while (context.output_scanline < endRow)
+		{
+			const auto firstScanline = context.output_scanline;
+			const auto scanlineCount = std::min(scanlinesPerRead, endRow - firstScanline);
+			for (JDIMENSION scanline = 0; scanline < scanlineCount; scanline++)
+				pScanlines[scanline] = pDecode + (size_t)(firstScanline + scanline) * stride;
+
+			const auto scanlinesRead = context.data_precision == 12 ? jpeg12_read_scanlines(&context, J12SAMPARRAY(pScanlines), scanlineCount)
+				: jpeg16_read_scanlines(&context, J16SAMPARRAY(pScanlines), scanlineCount);
+			if (scanlinesRead == 0)
+			{
+				jpeg_abort_decompress(&context);
+				return Core::eError::BadImageData;
+			}
+			FinishScanlines(firstScanline, scanlinesRead);
+		}
+
+		// Rows below a region are never read, so the decompressor is left rather than finished
+		if (context.output_scanline < context.output_height)
+			jpeg_abort_decompress(&context);
+		else
 			jpeg_finish_decompress(&context);
-			jpeg_destroy_decompress(&context);
-			return Core::eError::BadMetadata;
+
+		if (!inPlace && !draft)
+		{
+			for (uint32_t row = 0; row < height; row++)
+				memcpy(pOut + row * outputStrideBytes, pDecode + row * rowSizeBytes, rowSizeBytes);
+		}
+		return Core::eError::None;
+	}
+
+	Core::eError LossyJpegContext::DecodeThumbnail(uint8_t* pOut16Bit, uint32_t outputStrideBytes, uint32_t originX, uint32_t originY, uint32_t width,
+		uint32_t height, uint32_t bitDepth)
+	{
+		// A DC term is the mean of an 8x8 block of its component, which is only a block of the image when the scanlines are its rows
+		// and no component is subsampled
+		auto& context = m_decompress;
+		const auto components = (uint32_t)context.num_components;
+		bool blocksOfImage = context.data_precision == 12 && !context.master->lossless && context.image_width * components == width &&
+			context.image_height == height;
+		for (uint32_t component = 0; component < components; component++)
+			blocksOfImage = blocksOfImage && context.comp_info[component].h_samp_factor == 1 && context.comp_info[component].v_samp_factor == 1;
+		if (!blocksOfImage)
+		{
+			jpeg_abort_decompress(&context);
+			return Core::eError::NotImplmeneted;
+		}
+
+		if (setjmp(m_error.jump))
+		{
+			jpeg_abort_decompress(&context);
+			return Core::eError::BadImageData;
+		}
+
+		// The coefficients are entropy decoded, none of the blocks go through an inverse DCT
+		const auto pCoefficients = jpeg_read_coefficients(&context);
+		if (!pCoefficients)
+		{
+			jpeg_abort_decompress(&context);
+			return Core::eError::BadImageData;
+		}
+
+		// Block column i of each component covers the same 8 x components columns of the image, so the mean of their DC terms
+		// fills that many thumbnail samples. Dequantised DC terms are 8 times the mean of their level shifted block.
+		const auto thumbnailWidth = (width + 7) / 8;
+		const auto thumbnailHeight = (height + 7) / 8;
+		const auto blockColumns = context.comp_info[0].width_in_blocks;
+		const int32_t divisor = 8 * components;
+		const int32_t levelShift = (1 << 11) * divisor;
+		const auto shift = bitDepth > 12 ? bitDepth - 12 : 0;
+		const auto pOut = pOut16Bit + (size_t)originY * outputStrideBytes + originX * sizeof(uint16_t);
+		JBLOCKARRAY blockRows[MAX_COMPONENTS];
+		for (JDIMENSION blockRow = 0; blockRow < thumbnailHeight; blockRow++)
+		{
+			for (uint32_t component = 0; component < components; component++)
+				blockRows[component] = (*context.mem->access_virt_barray)((j_common_ptr)&context, pCoefficients[component], blockRow, 1, FALSE);
+
+			const auto pRow = (uint16_t*)(pOut + (size_t)blockRow * outputStrideBytes);
+			for (JDIMENSION blockColumn = 0; blockColumn < blockColumns; blockColumn++)
+			{
+				int32_t sum = 0;
+				for (uint32_t component = 0; component < components; component++)
+					sum += blockRows[component][0][blockColumn][0] * context.comp_info[component].quant_table->quantval[0];
+				const auto sample = (uint16_t)(std::clamp((sum + levelShift + divisor / 2) / divisor, 0, 4095) << shift);
+
+				const auto firstColumn = blockColumn * components;
+				const auto endColumn = std::min(firstColumn + components, thumbnailWidth);
+				for (auto column = firstColumn; column < endColumn; column++)
+					pRow[column] = sample;
+			}
 		}
 
 		jpeg_finish_decompress(&context);
-		jpeg_destroy_decompress(&context);
+		return Core::eError::None;
+	}
+
+	extern "C" LossyJpegContext* CreateLossyContext()
+	{
+		return new LossyJpegContext();
+	}
+
+	extern "C" void DestroyLossyContext(LossyJpegContext* pContext)
+	{
+		delete pContext;
+	}
+
+	extern "C" bool ReadJpegInfo(LossyJpegContext* pContext, uint8_t* pInCompressed, uint32_t compressedSizeBytes, sJpegInfo* pInfo)
+	{
+		return pContext->ReadHeader(pInCompressed, compressedSizeBytes, *pInfo);
+	}
+
+	extern "C" bool IsLossy(uint8_t* pInCompressed, uint32_t compressedSizeBytes)
+	{
+		LossyJpegContext context;
+		sJpegInfo info;
+		return context.ReadHeader(pInCompressed, compressedSizeBytes, info) && info.lossy;
+	}
+
+	extern "C" Core::eError DecodeLossy(LossyJpegContext* pContext, uint8_t* pOut16Bit, uint32_t outputStrideBytes, uint32_t originX, uint32_t originY,
+		uint8_t* pInCompressed, uint32_t compressedSizeBytes, uint32_t width, uint32_t height, uint32_t bitDepth, sRawStatistics* pStatistics, sJpegInfo* pInfo)
+	{
+		sJpegInfo info;
+		if (!pContext->ReadHeader(pInCompressed, compressedSizeBytes, info))
+			return Core::eError::BadImageData;
+		if (pInfo)
+			*pInfo = info;
+		return pContext->Decode(pOut16Bit, outputStrideBytes, originX, originY, width, height, bitDepth, pStatistics, false);
+	}
+
+	extern "C" Core::eError DecodeLossyDraft(LossyJpegContext* pContext, uint8_t* pOut16Bit, uint32_t outputStrideBytes, uint32_t originX, uint32_t originY,
+		uint8_t* pInCompressed, uint32_t compressedSizeBytes, uint32_t width, uint32_t height, uint32_t bitDepth)
+	{
+		sJpegInfo info;
+		if (!pContext->ReadHeader(pInCompressed, compressedSizeBytes, info))
+			return Core::eError::BadImageData;
+		return pContext->Decode(pOut16Bit, outputStrideBytes, originX, originY, width, height, bitDepth, nullptr, true);
+	}
+
+	extern "C" Core::eError DecodeLossyRegion(LossyJpegContext* pContext, uint8_t* pOut16Bit, uint32_t outputStrideBytes, uint32_t originX, uint32_t originY,
+		uint8_t* pInCompressed, uint32_t compressedSizeBytes, uint32_t width, uint32_t height, uint32_t bitDepth, uint32_t regionX, uint32_t regionY,
+		uint32_t regionWidth, uint32_t regionHeight)
+	{
+		sJpegInfo info;
+		if (!pContext->ReadHeader(pInCompressed, compressedSizeBytes, info))
+			return Core::eError::BadImageData;
+		const sLossyRegion region = { regionX, regionY, regionWidth, regionHeight };
+		return pContext->Decode(pOut16Bit, outputStrideBytes, originX, originY, width, height, bitDepth, nullptr, false, &region);
+	}
+
+	extern "C" Core::eError DecodeLossyThumbnails(uint8_t* pOut16Bit, uint8_t* pInCompressed, const uint64_t* pSegmentOffsets, const uint32_t* pSegmentSizeBytes,
+		uint32_t segmentCount, uint32_t segmentsPerFrame, uint32_t segmentsAcross, uint32_t segmentWidth, uint32_t segmentHeight, uint32_t bitDepth,
+		Core::eError* pSegmentErrors)
+	{
+		if (segmentCount == 0)
+			return Core::eError::None;
+		if (segmentsPerFrame == 0 || segmentsAcross == 0 || segmentsPerFrame % segmentsAcross != 0)
+			return Core::eError::BadMetadata;
+
+		// Each frame's thumbnail is its segments' thumbnails laid out as the segments are in the frame
+		const auto segmentThumbnailWidth = (segmentWidth + 7) / 8;
+		const auto segmentThumbnailHeight = (segmentHeight + 7) / 8;
+		const auto thumbnailStrideBytes = segmentsAcross * segmentThumbnailWidth * sizeof(uint16_t);
+		const auto thumbnailSizeBytes = (size_t)thumbnailStrideBytes * (segmentsPerFrame / segmentsAcross) * segmentThumbnailHeight;
+
+		// Frames of a clip are independent, so workers take whole segments from all of them, each on a decompressor of its own
+		auto& threadPool = ThreadPool::Instance();
+		const auto workerCount = std::min(segmentCount, threadPool.ThreadCount());
+		std::vector<Core::eError> segmentErrors(segmentCount, Core::eError::None);
+		std::atomic<uint32_t> nextSegment(0);
+		threadPool.ParallelFor(workerCount, [&](uint32_t)
+		{
+			std::unique_ptr<LossyJpegContext> pContext(new LossyJpegContext());
+			for (auto segment = nextSegment.fetch_add(1); segment < segmentCount; segment = nextSegment.fetch_add(1))
+			{
+				// Frames missing from the batch have no data, their thumbnails are left as they are
+				if (pSegmentSizeBytes[segment] == 0)
+				{
+					segmentErrors[segment] = Core::eError::FrameNotPresent;
+					continue;
+				}
+
+				sJpegInfo info;
+				if (!pContext->ReadHeader(pInCompressed + pSegmentOffsets[segment], pSegmentSizeBytes[segment], info))
+				{
+					segmentErrors[segment] = Core::eError::BadImageData;
+					continue;
+				}
+
+				const auto frame = segment / segmentsPerFrame;
+				const auto frameSegment = segment % segmentsPerFrame;
+				segmentErrors[segment] = pContext->DecodeThumbnail(pOut16Bit + frame * thumbnailSizeBytes, thumbnailStrideBytes,
+					(frameSegment % segmentsAcross) * segmentThumbnailWidth, (frameSegment / segmentsAcross) * segmentThumbnailHeight, segmentWidth, segmentHeight,
+					bitDepth);
+			}
+		});
+
+		if (pSegmentErrors)
+			std::copy(segmentErrors.begin(), segmentErrors.end(), pSegmentErrors);
+		for (auto error : segmentErrors)
+		{
+			if (error != Core::eError::None)
+				return error;
+		}
 		return Core::eError::None;
 	}
 }
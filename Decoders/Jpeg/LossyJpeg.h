@@ -1,14 +1,61 @@
 #pragma once
 
 #include "../Api.h"
+#include "../RawStatistics.h"
 
 #include <stdint.h>
 
 namespace Octopus::Player::Decoders::Jpeg
 {
+	// Persistent libjpeg-turbo decompressor, one per decoding thread
+	class LossyJpegContext;
+
+	// What the header of a stream says about it, read by the same parse that decodes it.
+	// Should match C# 'public struct Octopus.Player.Core.Decoders.Jpeg.JpegInfo' in 'Jpeg.cs'
+	struct sJpegInfo
+	{
+		uint32_t width;
+		uint32_t height;
+		uint32_t components;
+		uint32_t precision;
+
+		// 12 or 16-bit DCT based, as opposed to lossless (SOF3) streams
+		uint32_t lossy;
+	};
+
 DECODER_EXPORT_BEGIN
+	DECODER_EXPORT LossyJpegContext* CreateLossyContext();
+	DECODER_EXPORT void DestroyLossyContext(LossyJpegContext* pContext);
+
+	// Reads the headers of a stream into pInfo, false if they can't be read
+	DECODER_EXPORT bool ReadJpegInfo(LossyJpegContext* pContext, uint8_t* pInCompressed, uint32_t compressedSizeBytes, sJpegInfo* pInfo);
+
+	// Whether the stream is lossy, on a decompressor of its own. Callers with a context use ReadJpegInfo.
     DECODER_EXPORT bool IsLossy(uint8_t* pInCompressed, uint32_t compressedSizeBytes);
-	DECODER_EXPORT Core::eError DecodeLossy(uint8_t* pOut16Bit, uint8_t* pInCompressed, uint32_t compressedSizeBytes, uint32_t width,
-        uint32_t height, uint32_t bitDepth);
+
+	// Decodes a width x height image to (originX, originY) of an output image with rows outputStrideBytes apart.
+	// The samples are added to pStatistics, if given, as they are decoded. pInfo, if given, receives the stream's headers.
+	DECODER_EXPORT Core::eError DecodeLossy(LossyJpegContext* pContext, uint8_t* pOut16Bit, uint32_t outputStrideBytes, uint32_t originX, uint32_t originY,
+		uint8_t* pInCompressed, uint32_t compressedSizeBytes, uint32_t width, uint32_t height, uint32_t bitDepth, sRawStatistics* pStatistics, sJpegInfo* pInfo);
+
+	// As DecodeLossy, but bins each 4x4 block of the Bayer image to one 2x2 CFA quad as the rows are decoded.
+	// The origin and stride are in the half width, half height draft output.
+	DECODER_EXPORT Core::eError DecodeLossyDraft(LossyJpegContext* pContext, uint8_t* pOut16Bit, uint32_t outputStrideBytes, uint32_t originX, uint32_t originY,
+		uint8_t* pInCompressed, uint32_t compressedSizeBytes, uint32_t width, uint32_t height, uint32_t bitDepth);
+
+	// As DecodeLossy, but only decodes the rectangle of the image at (regionX, regionY), in its own pixels, for zoomed views.
+	// Columns are decoded in whole iMCUs, so a little either side of the rectangle is written too, and rows outside it are skipped.
+	DECODER_EXPORT Core::eError DecodeLossyRegion(LossyJpegContext* pContext, uint8_t* pOut16Bit, uint32_t outputStrideBytes, uint32_t originX, uint32_t originY,
+		uint8_t* pInCompressed, uint32_t compressedSizeBytes, uint32_t width, uint32_t height, uint32_t bitDepth, uint32_t regionX, uint32_t regionY,
+		uint32_t regionWidth, uint32_t regionHeight);
+
+	// Thumbnails of a batch of frames sharing a layout of segmentWidth x segmentHeight strips or tiles, from the DC term of each 8x8 block.
+	// The segments of each frame follow one another, segmentsAcross to a row. The thumbnails are written back to back, each one
+	// segmentsAcross * ceil(segmentWidth / 8) by segmentsPerFrame / segmentsAcross * ceil(segmentHeight / 8) samples.
+	// A DC term averages every CFA colour of its block, so the thumbnails are monochrome, unlike the Bayer output of the other decodes.
+	// Segments of size 0 are frames missing from the batch, left untouched and reported as FrameNotPresent in pSegmentErrors, if given.
+	DECODER_EXPORT Core::eError DecodeLossyThumbnails(uint8_t* pOut16Bit, uint8_t* pInCompressed, const uint64_t* pSegmentOffsets, const uint32_t* pSegmentSizeBytes,
+		uint32_t segmentCount, uint32_t segmentsPerFrame, uint32_t segmentsAcross, uint32_t segmentWidth, uint32_t segmentHeight, uint32_t bitDepth,
+		Core::eError* pSegmentErrors);
 DECODER_EXPORT_END
 }
@@ -0,0 +1,254 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <algorithm>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+namespace Octopus::Player::Decoders
+{
+    // Bins of the coarse histogram of each CFA channel
+    constexpr uint32_t kRawStatisticsBins = 64;
+
+    // Statistics of the raw samples of a frame, gathered by the decoders as they write the samples.
+    // Channels are the four positions of a 2x2 CFA quad, channel (y & 1) * 2 + (x & 1) of the full resolution frame.
+    // Decodes add to the statistics, so the segments of a frame can all be gathered in one.
+    // Should match C# 'public struct Octopus.Player.Core.Decoders.RawStatistics' in 'RawStatistics.cs'
+    struct sRawStatistics
+    {
+        // Set by ResetRawStatistics
+        uint32_t whiteLevel;
+        uint32_t histogramShift;
+
+        uint16_t minimum[4];
+        uint16_t maximum[4];
+        uint64_t samples[4];
+
+        // Samples at or above the white level
+        uint64_t clipped[4];
+
+        // Bin i counts samples from i << histogramShift, the last bin also counts everything above it
+        uint32_t histogram[4][kRawStatisticsBins];
+    };
+
+    // Empties the statistics, keeping the white level and histogram bins
+    inline void ClearRawStatistics(sRawStatistics& statistics)
+    {
+        for (uint32_t channel = 0; channel < 4; channel++)
+        {
+            statistics.minimum[channel] = UINT16_MAX;
+            statistics.maximum[channel] = 0;
+            statistics.samples[channel] = 0;
+            statistics.clipped[channel] = 0;
+            std::fill(statistics.histogram[channel], statistics.histogram[channel] + kRawStatisticsBins, 0);
+        }
+    }
+
+    // Empties the statistics of a frame with the given white level, the histogram spanning the range of bitDepth samples
+    inline void ResetRawStatistics(sRawStatistics& statistics, uint32_t whiteLevel, uint32_t bitDepth)
+    {
+        statistics.whiteLevel = whiteLevel;
+        statistics.histogramShift = bitDepth > 6 ? bitDepth - 6 : 0;
+        ClearRawStatistics(statistics);
+    }
+
+    inline void MergeRawStatistics(sRawStatistics& statistics, const sRawStatistics& other)
+    {
+        for (uint32_t channel = 0; channel < 4; channel++)
+        {
+            statistics.minimum[channel] = std::min(statistics.minimum[channel], other.minimum[channel]);
+            statistics.maximum[channel] = std::max(statistics.maximum[channel], other.maximum[channel]);
+            statistics.samples[channel] += other.samples[channel];
+            statistics.clipped[channel] += other.clipped[channel];
+            for (uint32_t bin = 0; bin < kRawStatisticsBins; bin++)
+                statistics.histogram[channel][bin] += other.histogram[channel][bin];
+        }
+    }
+
+    // Adds count samples of row y of the frame, starting at column x.
+    // Samples alternate between two channels along a row. The extremes and clipping are a vectorised pass of their own, and
+    // neighbouring samples, mostly in the same bin, are counted in separate histograms so their increments don't wait on each other.
+    template<typename T>
+    inline void AccumulateRawStatistics(sRawStatistics& statistics, const T* pSamples, uint32_t count, uint32_t x, uint32_t y)
+    {
+        if (count == 0)
+            return;
+
+        const uint32_t channels[2] = { (y & 1) * 2 + (x & 1), ((y & 1) * 2 + (x & 1)) ^ 1 };
+        const uint32_t whiteLevel = statistics.whiteLevel;
+        const uint32_t shift = statistics.histogramShift;
+
+        uint32_t minimum0 = UINT16_MAX, minimum1 = UINT16_MAX;
+        uint32_t maximum0 = 0, maximum1 = 0;
+        uint32_t clipped0 = 0, clipped1 = 0;
+        uint32_t i = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+        // Even lanes hold one channel and odd lanes the other, as the samples do. SSE2 only compares signed 16-bit
+        // values, so samples are offset by 0x8000.
+        if (sizeof(T) == sizeof(uint16_t) && whiteLevel - 1 < UINT16_MAX)
+        {
+            const __m128i bias = _mm_set1_epi16(INT16_MIN);
+            const __m128i threshold = _mm_set1_epi16((int16_t)((whiteLevel - 1) ^ 0x8000));
+            __m128i minimum = _mm_set1_epi16(INT16_MAX);
+            __m128i maximum = _mm_set1_epi16(INT16_MIN);
+            uint32_t clipped[8] = {};
+            while (i + 8 <= count)
+            {
+                // Clipping is counted in 16-bit lanes, added up before they can overflow
+                const auto end = i + std::min(count - i, 8u * INT16_MAX) / 8 * 8;
+                __m128i blockClipped = _mm_setzero_si128();
+                for (; i < end; i += 8)
+                {
+                    const __m128i samples = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(pSamples + i)), bias);
+                    minimum = _mm_min_epi16(minimum, samples);
+                    maximum = _mm_max_epi16(maximum, samples);
+                    blockClipped = _mm_sub_epi16(blockClipped, _mm_cmpgt_epi16(samples, threshold));
+                }
+                alignas(16) uint16_t lanes[8];
+                _mm_store_si128((__m128i*)lanes, blockClipped);
+                for (uint32_t lane = 0; lane < 8; lane++)
+                    clipped[lane] += lanes[lane];
+            }
+
+            alignas(16) uint16_t minimumLanes[8];
+            alignas(16) uint16_t maximumLanes[8];
+            _mm_store_si128((__m128i*)minimumLanes, _mm_xor_si128(minimum, bias));
+            _mm_store_si128((__m128i*)maximumLanes, _mm_xor_si128(maximum, bias));
+            for (uint32_t lane = 0; lane < 8; lane += 2)
+            {
+                minimum0 = std::min<uint32_t>(minimum0, minimumLanes[lane]);
+                maximum0 = std::max<uint32_t>(maximum0, maximumLanes[lane]);
+                clipped0 += clipped[lane];
+                minimum1 = std::min<uint32_t>(minimum1, minimumLanes[lane + 1]);
+                maximum1 = std::max<uint32_t>(maximum1, maximumLanes[lane + 1]);
+                clipped1 += clipped[lane + 1];
+            }
+        }
+#endif
+        for (; i + 2 <= count; i += 2)
+        {
+            const uint32_t sample0 = pSamples[i];
+            const uint32_t sample1 = pSamples[i + 1];
+            minimum0 = std::min(minimum0, sample0);
+            maximum0 = std::max(maximum0, sample0);
+            clipped0 += sample0 >= whiteLevel;
+            minimum1 = std::min(minimum1, sample1);
+            maximum1 = std::max(maximum1, sample1);
+            clipped1 += sample1 >= whiteLevel;
+        }
+        if (i < count)
+        {
+            const uint32_t sample0 = pSamples[i];
+            minimum0 = std::min(minimum0, sample0);
+            maximum0 = std::max(maximum0, sample0);
+            clipped0 += sample0 >= whiteLevel;
+        }
+        const uint32_t minimum[2] = { minimum0, minimum1 };
+        const uint32_t maximum[2] = { maximum0, maximum1 };
+        const uint32_t clipped[2] = { clipped0, clipped1 };
+
+        // Two histograms per channel, for samples 2i and 2i + 1 apart
+        uint32_t histograms[4][kRawStatisticsBins] = {};
+        for (i = 0; i + 4 <= count; i += 4)
+        {
+            histograms[0][std::min<uint32_t>(pSamples[i] >> shift, kRawStatisticsBins - 1)]++;
+            histograms[1][std::min<uint32_t>(pSamples[i + 1] >> shift, kRawStatisticsBins - 1)]++;
+            histograms[2][std::min<uint32_t>(pSamples[i + 2] >> shift, kRawStatisticsBins - 1)]++;
+            histograms[3][std::min<uint32_t>(pSamples[i + 3] >> shift, kRawStatisticsBins - 1)]++;
+        }
+        for (; i < count; i++)
+            histograms[i & 1][std::min<uint32_t>(pSamples[i] >> shift, kRawStatisticsBins - 1)]++;
+
+        for (uint32_t parity = 0; parity < std::min(count, 2u); parity++)
+        {
+            const auto channel = channels[parity];
+            statistics.minimum[channel] = (uint16_t)std::min<uint32_t>(statistics.minimum[channel], minimum[parity]);
+            statistics.maximum[channel] = (uint16_t)std::max<uint32_t>(statistics.maximum[channel], maximum[parity]);
+            statistics.samples[channel] += (count - parity + 1) / 2;
+            statistics.clipped[channel] += clipped[parity];
+            for (uint32_t bin = 0; bin < kRawStatisticsBins; bin++)
+                statistics.histogram[channel][bin] += histograms[parity][bin] + histograms[parity + 2][bin];
+        }
+    }
+
+    // Gathers the samples of a width wide block of the frame at (originX, originY) in the order they are decoded.
+    // The block's samples are numbered row by row, so rows of a stream shaped differently to the block can be added as they are.
+    class RawStatisticsRows
+    {
+    public:
+        RawStatisticsRows(sRawStatistics* pStatistics = nullptr, uint32_t originX = 0, uint32_t originY = 0, uint32_t width = 0, uint64_t firstSample = 0)
+            : m_pStatistics(width ? pStatistics : nullptr)
+            , m_originX(originX)
+            , m_originY(originY)
+            , m_width(width)
+            , m_nextSample(firstSample)
+        {
+        }
+
+        bool Enabled() const { return m_pStatistics != nullptr; }
+
+        sRawStatistics* Statistics() const { return m_pStatistics; }
+
+        // The same block from another sample, gathered in other statistics, such as those of one of the workers of a parallel decode
+        RawStatisticsRows From(uint64_t firstSample, sRawStatistics* pStatistics) const
+        {
+            return RawStatisticsRows(pStatistics, m_originX, m_originY, m_width, firstSample);
+        }
+
+        // Adds the next count samples of the block
+        template<typename T>
+        void Accumulate(const T* pSamples, uint64_t count)
+        {
+            while (count)
+            {
+                const auto x = (uint32_t)(m_nextSample % m_width);
+                const auto y = (uint32_t)(m_nextSample / m_width);
+                const auto runLength = (uint32_t)std::min<uint64_t>(count, m_width - x);
+                AccumulateRawStatistics(*m_pStatistics, pSamples, runLength, m_originX + x, m_originY + y);
+                pSamples += runLength;
+                count -= runLength;
+                m_nextSample += runLength;
+            }
+        }
+
+    private:
+        sRawStatistics* m_pStatistics;
+        uint32_t m_originX;
+        uint32_t m_originY;
+        uint32_t m_width;
+        uint64_t m_nextSample;
+    };
+
+    // Statistics of each worker of a parallel decode, merged into the frame's once the workers are done.
+    // Nothing is gathered when the frame has no statistics.
+    class RawStatisticsPartials
+    {
+    public:
+        RawStatisticsPartials(sRawStatistics* pStatistics, uint32_t count)
+            : m_pStatistics(pStatistics)
+            , m_partials(pStatistics ? count : 0)
+        {
+            for (auto& partial : m_partials)
+            {
+                partial = *pStatistics;
+                ClearRawStatistics(partial);
+            }
+        }
+
+        sRawStatistics* operator[](uint32_t index) { return m_pStatistics ? &m_partials[index] : nullptr; }
+
+        void Merge()
+        {
+            for (const auto& partial : m_partials)
+                MergeRawStatistics(*m_pStatistics, partial);
+        }
+
+    private:
+        sRawStatistics* m_pStatistics;
+        std::vector<sRawStatistics> m_partials;
+    };
+}
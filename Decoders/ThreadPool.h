@@ -0,0 +1,134 @@
+#pragma once
+
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Octopus::Player::Decoders
+{
+    // Process wide pool of worker threads shared by the native decoders
+    // The calling thread always takes part in the work, so nested parallel loops cannot deadlock.
+    class ThreadPool
+    {
+    public:
+
+        // Intentionally never destroyed, joining threads while the library unloads can deadlock
+        static ThreadPool& Instance()
+        {
+            static ThreadPool* pInstance = new ThreadPool();
+            return *pInstance;
+        }
+
+        // Number of threads available to a parallel loop, including the calling thread
+        uint32_t ThreadCount() const
+        {
+            const auto threadCount = (uint32_t)m_workers.size() + 1;
+            const auto limit = m_threadLimit.load();
+            return limit ? std::min(limit, threadCount) : threadCount;
+        }
+
+        // Caps the threads used by every parallel loop (0 = all of them), for measuring how the decoders scale
+        void SetThreadLimit(uint32_t limit) { m_threadLimit = limit; }
+
+        // Runs function(index) for every index in [0, count), using at most maxThreads threads (0 = all)
+        void ParallelFor(uint32_t count, const std::function<void(uint32_t)>& function, uint32_t maxThreads = 0)
+        {
+            if (count == 0)
+                return;
+
+            const auto threadCount = std::min(count, maxThreads ? std::min(maxThreads, ThreadCount()) : ThreadCount());
+            if (threadCount <= 1)
+            {
+                for (uint32_t i = 0; i < count; i++)
+                    function(i);
+                return;
+            }
+
+            auto job = std::make_shared<Job>(function, count);
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                for (uint32_t i = 1; i < threadCount; i++)
+                    m_queue.push_back(job);
+            }
+            if (threadCount > 2)
+                m_wake.notify_all();
+            else
+                m_wake.notify_one();
+
+            job->Run();
+
+            std::unique_lock<std::mutex> lock(job->mutex);
+            job->finished.wait(lock, [&job]() { return job->completed == job->count; });
+        }
+
+    private:
+
+        struct Job
+        {
+            Job(const std::function<void(uint32_t)>& function, uint32_t count)
+                : function(function)
+                , count(count)
+                , next(0)
+                , completed(0)
+            {}
+
+            void Run()
+            {
+                uint32_t ran = 0;
+                for (uint32_t i = next++; i < count; i = next++, ran++)
+                    function(i);
+
+                if (ran)
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    completed += ran;
+                    if (completed == count)
+                        finished.notify_all();
+                }
+            }
+
+            const std::function<void(uint32_t)>& function;
+            const uint32_t count;
+            std::atomic<uint32_t> next;
+            uint32_t completed;
+            std::mutex mutex;
+            std::condition_variable finished;
+        };
+
+        ThreadPool()
+            : m_threadLimit(0)
+        {
+            const auto hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+            for (uint32_t i = 1; i < hardwareThreads; i++)
+                m_workers.emplace_back([this]() { WorkerMain(); });
+        }
+
+        void WorkerMain()
+        {
+            while (true)
+            {
+                std::shared_ptr<Job> job;
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    m_wake.wait(lock, [this]() { return !m_queue.empty(); });
+                    job = std::move(m_queue.front());
+                    m_queue.pop_front();
+                }
+                job->Run();
+            }
+        }
+
+        std::vector<std::thread> m_workers;
+        std::deque<std::shared_ptr<Job>> m_queue;
+        std::mutex m_mutex;
+        std::condition_variable m_wake;
+        std::atomic<uint32_t> m_threadLimit;
+    };
+}
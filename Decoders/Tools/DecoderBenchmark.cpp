@@ -0,0 +1,569 @@
+// Measures the throughput of the native decoders at 1..N threads, so it can be tracked across releases.
+//
+// Usage: DecoderBenchmark [options]
+//   --threads N             Highest thread count, counts double from 1 up to it (default all hardware threads)
+//   --size WxH              Frame dimensions, multiples of 16 and 2 (default 4096x2160)
+//   --bits N                Bit depth of the lossless and unpacked frames, 10 to 16 (default 14)
+//   --seconds N             Minimum measuring time of each result (default 0.25)
+//   --filter TEXT           Only runs the benchmarks whose name contains TEXT
+//   --csv                   Prints comma separated values
+//
+// MB/s is measured against the compressed or packed input, Mpixel/s against the decoded samples.
+// Lossless frames are encoded with every predictor, component count and restart layout and decoded by each lossless
+// backend, lossy frames as 256x256 tiles of 12-bit baseline JPEG. Lossy decoding and the libjpeg-turbo backend are
+// measured when built with libjpeg-turbo 3.0 or later.
+
+#include "../Jpeg/LosslessJpeg.h"
+#include "../Jpeg/LosslessJpegEncoder.h"
+#ifndef DECODERS_WITHOUT_LIBJPEG_TURBO
+#include "../Jpeg/LossyJpeg.h"
+#include <jpeglib.h>
+#endif
+#include "../Unpack/Unpack.h"
+#include "../ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+using namespace Octopus::Player;
+using namespace Octopus::Player::Decoders;
+
+namespace
+{
+	struct sOptions
+	{
+		uint32_t maxThreads = 0;
+		uint32_t width = 4096;
+		uint32_t height = 2160;
+		uint32_t bits = 14;
+		double seconds = 0.25;
+		std::string filter;
+		bool csv = false;
+	};
+
+	static const uint32_t kTileSize = 256;
+
+	// Lossless backends, each measured on its own
+	struct sLosslessBackend
+	{
+		Jpeg::eLosslessBackend backend;
+		const char* pName;
+	};
+
+	static const sLosslessBackend kLosslessBackends[] =
+	{
+		{ Jpeg::eLosslessBackend::DngSdk, "dng-sdk" },
+#ifndef DECODERS_WITHOUT_LIBJPEG_TURBO
+		{ Jpeg::eLosslessBackend::LibJpegTurbo, "libjpeg-turbo" },
+#endif
+	};
+
+
+	// Same shape as sensor data, smooth gradients with a little noise, so predictors and entropy coding see realistic residuals
+	std::vector<uint16_t> RenderFrame(uint32_t width, uint32_t height, uint32_t bits)
+	{
+		std::vector<uint16_t> frame((size_t)width * height);
+		const auto maxValue = (1u << bits) - 1;
+		uint32_t noiseState = 0x9E3779B9u;
+		for (uint32_t y = 0; y < height; y++)
+		{
+			for (uint32_t x = 0; x < width; x++)
+			{
+				noiseState ^= noiseState << 13;
+				noiseState ^= noiseState >> 17;
+				noiseState ^= noiseState << 5;
+				const auto level = ((x >> 1) * 3 + (y >> 1) * 2 + ((x & 1) + (y & 1)) * 200) % (maxValue / 2) + maxValue / 8;
+				frame[(size_t)y * width + x] = (uint16_t)std::min<uint32_t>(level + (noiseState & 15), maxValue);
+			}
+		}
+		return frame;
+	}
+
+	class Benchmark
+	{
+	public:
+
+		Benchmark(const sOptions& options)
+			: m_options(options)
+		{
+			const auto hardwareThreads = ThreadPool::Instance().ThreadCount();
+			const auto maxThreads = options.maxThreads ? std::min(options.maxThreads, hardwareThreads) : hardwareThreads;
+			for (uint32_t threads = 1; threads < maxThreads; threads *= 2)
+				m_threadCounts.push_back(threads);
+			m_threadCounts.push_back(maxThreads);
+
+			if (options.csv)
+				printf("benchmark,threads,mb_per_s,mpixel_per_s,scaling\n");
+			else
+				printf("%-72s %8s %10s %12s %8s\n", "Benchmark", "Threads", "MB/s", "Mpixel/s", "Scaling");
+		}
+
+		~Benchmark()
+		{
+			ThreadPool::Instance().SetThreadLimit(0);
+		}
+
+		bool Selected(const std::string& name) const
+		{
+			return m_options.filter.empty() || name.find(m_options.filter) != std::string::npos;
+		}
+
+		// Runs decode at every thread count, inputBytes and pixels are the work done by a single call
+		void Measure(const std::string& name, uint64_t inputBytes, uint64_t pixels, const std::function<bool()>& decode)
+		{
+			double singleThreadSeconds = 0.0;
+			for (auto threads : m_threadCounts)
+			{
+				ThreadPool::Instance().SetThreadLimit(threads);
+				if (!decode())
+				{
+					printf("%s failed to decode\n", name.c_str());
+					m_failed = true;
+					return;
+				}
+
+				uint32_t iterations = 0;
+				const auto start = std::chrono::steady_clock::now();
+				double elapsed = 0.0;
+				do
+				{
+					decode();
+					iterations++;
+					elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+				} while (elapsed < m_options.seconds);
+
+				const auto callSeconds = elapsed / iterations;
+				if (threads == 1)
+					singleThreadSeconds = callSeconds;
+				const auto megabytesPerSecond = inputBytes / callSeconds / 1e6;
+				const auto megapixelsPerSecond = pixels / callSeconds / 1e6;
+				const auto scaling = singleThreadSeconds / callSeconds;
+				if (m_options.csv)
+					printf("%s,%u,%.1f,%.1f,%.2f\n", name.c_str(), threads, megabytesPerSecond, megapixelsPerSecond, scaling);
+				else
+					printf("%-72s %8u %10.1f %12.1f %7.2fx\n", name.c_str(), threads, megabytesPerSecond, megapixelsPerSecond, scaling);
+				fflush(stdout);
+			}
+		}
+
+		bool Failed() const { return m_failed; }
+
+	private:
+
+		const sOptions& m_options;
+		std::vector<uint32_t> m_threadCounts;
+		bool m_failed = false;
+	};
+
+	std::string LosslessBackendName(const std::string& name, const sLosslessBackend& backend)
+	{
+		return name + " backend=" + backend.pName;
+	}
+
+	bool LosslessSelected(const Benchmark& benchmark, const std::string& name)
+	{
+		for (const auto& backend : kLosslessBackends)
+		{
+			if (benchmark.Selected(LosslessBackendName(name, backend)))
+				return true;
+		}
+		return false;
+	}
+
+	// Measures decode with each selected lossless backend
+	void MeasureLosslessBackends(Benchmark& benchmark, const std::string& name, uint64_t inputBytes, uint64_t pixels, const std::function<bool()>& decode)
+	{
+		for (const auto& backend : kLosslessBackends)
+		{
+			const auto backendName = LosslessBackendName(name, backend);
+			if (!benchmark.Selected(backendName))
+				continue;
+			Jpeg::SetLosslessBackend(backend.backend);
+			benchmark.Measure(backendName, inputBytes, pixels, decode);
+		}
+		Jpeg::SetLosslessBackend(Jpeg::eLosslessBackend::Auto);
+	}
+
+	// Whole frames as a single stream, restarts are the only parallelism a stream offers the decoder
+	void BenchmarkLossless(Benchmark& benchmark, const sOptions& options, Jpeg::LosslessJpegContext* pContext)
+	{
+		const auto frame = RenderFrame(options.width, options.height, options.bits);
+		std::vector<uint16_t> decoded(frame.size());
+		std::vector<uint8_t> compressed;
+
+		for (uint32_t components = 1; components <= 4; components++)
+		{
+			const auto width = options.width - options.width % components;
+			const auto columns = width / components;
+			for (uint32_t predictor = 1; predictor <= 7; predictor++)
+			{
+				for (uint32_t restartRows : { 0u, 1u, 16u })
+				{
+					// Restart intervals are counted in MCUs, which must fit the 16 bits of the DRI marker
+					if (restartRows * columns > 0xFFFF)
+						continue;
+
+					char name[128];
+					if (restartRows)
+						snprintf(name, sizeof(name), "DecodeLossless components=%u predictor=%u restart=%u", components, predictor, restartRows);
+					else
+						snprintf(name, sizeof(name), "DecodeLossless components=%u predictor=%u", components, predictor);
+					if (!LosslessSelected(benchmark, name))
+						continue;
+
+					compressed.resize(Jpeg::EncodeLosslessMaxSizeBytes(width, options.height) + Jpeg::DecodeLosslessInputPaddingBytes());
+					uint32_t compressedSizeBytes = 0;
+					if (Jpeg::EncodeLossless(compressed.data(), (uint32_t)compressed.size(), &compressedSizeBytes, (const uint8_t*)frame.data(),
+						options.width * sizeof(uint16_t), width, options.height, options.bits, components, predictor, restartRows) != Core::eError::None)
+					{
+						printf("%s failed to encode\n", name);
+						continue;
+					}
+
+					MeasureLosslessBackends(benchmark, name, compressedSizeBytes, (uint64_t)width * options.height, [&]()
+					{
+						return Jpeg::DecodeLossless(pContext, (uint8_t*)decoded.data(), options.width * sizeof(uint16_t), 0, 0, compressed.data(),
+							compressedSizeBytes, width, options.height, options.bits, nullptr) == Core::eError::None;
+					});
+				}
+			}
+		}
+	}
+
+	// Tiled frames as DNG stores them, two component Bayer tiles decoded in parallel
+	void BenchmarkLosslessTiles(Benchmark& benchmark, const sOptions& options, Jpeg::LosslessJpegContext* pContext)
+	{
+		char name[128];
+		snprintf(name, sizeof(name), "DecodeLosslessTiles tile=%ux%u", kTileSize, kTileSize);
+		const auto tilesAcross = options.width / kTileSize;
+		const auto tilesDown = options.height / kTileSize;
+		if (!LosslessSelected(benchmark, name) || tilesAcross == 0 || tilesDown == 0)
+			return;
+
+		const auto frame = RenderFrame(options.width, options.height, options.bits);
+		const auto tileCount = tilesAcross * tilesDown;
+		const auto maxTileSizeBytes = Jpeg::EncodeLosslessMaxSizeBytes(kTileSize, kTileSize);
+		std::vector<uint8_t> compressed((size_t)tileCount * maxTileSizeBytes + Jpeg::DecodeLosslessInputPaddingBytes());
+		std::vector<uint64_t> tileOffsets(tileCount);
+		std::vector<uint32_t> tileSizeBytes(tileCount);
+		uint64_t compressedSizeBytes = 0;
+		for (uint32_t tile = 0; tile < tileCount; tile++)
+		{
+			const auto pTile = frame.data() + (size_t)(tile / tilesAcross) * kTileSize * options.width + (tile % tilesAcross) * kTileSize;
+			tileOffsets[tile] = compressedSizeBytes;
+			if (Jpeg::EncodeLossless(compressed.data() + compressedSizeBytes, maxTileSizeBytes, &tileSizeBytes[tile], (const uint8_t*)pTile,
+				options.width * sizeof(uint16_t), kTileSize, kTileSize, options.bits, 2, 1, 0) != Core::eError::None)
+			{
+				printf("%s failed to encode\n", name);
+				return;
+			}
+			compressedSizeBytes += tileSizeBytes[tile];
+		}
+
+		std::vector<uint16_t> decoded(frame.size());
+		std::vector<Core::eError> tileErrors(tileCount);
+		MeasureLosslessBackends(benchmark, name, compressedSizeBytes, (uint64_t)tileCount * kTileSize * kTileSize, [&]()
+		{
+			return Jpeg::DecodeLosslessTiles(pContext, (uint8_t*)decoded.data(), options.width * sizeof(uint16_t), compressed.data(), tileOffsets.data(),
+				tileSizeBytes.data(), tileCount, tilesAcross, kTileSize, kTileSize, options.bits, false, tileErrors.data(), nullptr) == Core::eError::None;
+		});
+	}
+
+	// The cost of gathering raw statistics while decoding, against the plain DecodeLossless benchmark of the same stream
+	void BenchmarkLosslessStatistics(Benchmark& benchmark, const sOptions& options, Jpeg::LosslessJpegContext* pContext)
+	{
+		const std::string name = "DecodeLossless components=2 predictor=1 statistics";
+		if (!LosslessSelected(benchmark, name))
+			return;
+
+		const auto frame = RenderFrame(options.width, options.height, options.bits);
+		std::vector<uint8_t> compressed(Jpeg::EncodeLosslessMaxSizeBytes(options.width, options.height) + Jpeg::DecodeLosslessInputPaddingBytes());
+		uint32_t compressedSizeBytes = 0;
+		if (Jpeg::EncodeLossless(compressed.data(), (uint32_t)compressed.size(), &compressedSizeBytes, (const uint8_t*)frame.data(),
+			options.width * sizeof(uint16_t), options.width, options.height, options.bits, 2, 1, 0) != Core::eError::None)
+		{
+			printf("%s failed to encode\n", name.c_str());
+			return;
+		}
+
+		std::vector<uint16_t> decoded(frame.size());
+		sRawStatistics statistics;
+		MeasureLosslessBackends(benchmark, name, compressedSizeBytes, (uint64_t)options.width * options.height, [&]()
+		{
+			ResetRawStatistics(statistics, (1u << options.bits) - 1, options.bits);
+			return Jpeg::DecodeLossless(pContext, (uint8_t*)decoded.data(), options.width * sizeof(uint16_t), 0, 0, compressed.data(),
+				compressedSizeBytes, options.width, options.height, options.bits, &statistics) == Core::eError::None;
+		});
+	}
+
+	// Single strip frames without restart markers, decoded from a checkpoint index made by an earlier decode
+	void BenchmarkLosslessIndexed(Benchmark& benchmark, const sOptions& options, Jpeg::LosslessJpegContext* pContext)
+	{
+		const char* pName = "DecodeLosslessIndexed components=2 predictor=1";
+		if (!benchmark.Selected(pName))
+			return;
+
+		const auto frame = RenderFrame(options.width, options.height, options.bits);
+		std::vector<uint8_t> compressed(Jpeg::EncodeLosslessMaxSizeBytes(options.width, options.height) + Jpeg::DecodeLosslessInputPaddingBytes());
+		uint32_t compressedSizeBytes = 0;
+		if (Jpeg::EncodeLossless(compressed.data(), (uint32_t)compressed.size(), &compressedSizeBytes, (const uint8_t*)frame.data(),
+			options.width * sizeof(uint16_t), options.width, options.height, options.bits, 2, 1, 0) != Core::eError::None)
+		{
+			printf("%s failed to encode\n", pName);
+			return;
+		}
+
+		std::vector<uint16_t> decoded(frame.size());
+		std::vector<uint8_t> index(Jpeg::LosslessCheckpointIndexSizeBytes(compressed.data(), compressedSizeBytes));
+		if (Jpeg::DecodeLosslessIndexing(pContext, (uint8_t*)decoded.data(), options.width * sizeof(uint16_t), 0, 0, compressed.data(), compressedSizeBytes,
+			options.width, options.height, options.bits, index.data(), (uint32_t)index.size(), nullptr) != Core::eError::None)
+		{
+			printf("%s failed to index\n", pName);
+			return;
+		}
+
+		benchmark.Measure(pName, compressedSizeBytes, (uint64_t)options.width * options.height, [&]()
+		{
+			return Jpeg::DecodeLosslessIndexed(pContext, (uint8_t*)decoded.data(), options.width * sizeof(uint16_t), 0, 0, compressed.data(), compressedSizeBytes,
+				options.width, options.height, options.bits, index.data(), (uint32_t)index.size(), nullptr) == Core::eError::None;
+		});
+	}
+
+#ifndef DECODERS_WITHOUT_LIBJPEG_TURBO
+	// 12-bit greyscale baseline JPEG of a tile, the precision DNG stores lossy frames with
+	bool EncodeLossyTile(std::vector<uint8_t>& compressed, const uint16_t* pTile, uint32_t strideSamples)
+	{
+		jpeg_compress_struct context;
+		jpeg_error_mgr errorManager;
+		context.err = jpeg_std_error(&errorManager);
+		jpeg_create_compress(&context);
+
+		unsigned char* pCompressed = nullptr;
+		unsigned long compressedSizeBytes = 0;
+		jpeg_mem_dest(&context, &pCompressed, &compressedSizeBytes);
+
+		context.image_width = kTileSize;
+		context.image_height = kTileSize;
+		context.input_components = 1;
+		context.in_color_space = JCS_GRAYSCALE;
+		context.data_precision = 12;
+		jpeg_set_defaults(&context);
+		jpeg_set_quality(&context, 95, TRUE);
+		jpeg_start_compress(&context, TRUE);
+
+		std::vector<J12SAMPLE> row(kTileSize);
+		while (context.next_scanline < context.image_height)
+		{
+			const auto pRow = pTile + (size_t)context.next_scanline * strideSamples;
+			for (uint32_t x = 0; x < kTileSize; x++)
+				row[x] = (J12SAMPLE)(pRow[x] & 0xFFF);
+			J12SAMPROW rows[1] = { row.data() };
+			jpeg12_write_scanlines(&context, rows, 1);
+		}
+
+		jpeg_finish_compress(&context);
+		jpeg_destroy_compress(&context);
+		compressed.assign(pCompressed, pCompressed + compressedSizeBytes);
+		free(pCompressed);
+		return !compressed.empty();
+	}
+
+	// Tiles decoded in parallel, as the DNG reader does for lossy frames, at full resolution or binned to drafts
+	void BenchmarkLossy(Benchmark& benchmark, const sOptions& options, bool draft)
+	{
+		char name[128];
+		snprintf(name, sizeof(name), "DecodeLossy%s tile=%ux%u", draft ? "Draft" : "", kTileSize, kTileSize);
+		const auto tilesAcross = options.width / kTileSize;
+		const auto tilesDown = options.height / kTileSize;
+		if (!benchmark.Selected(name) || tilesAcross == 0 || tilesDown == 0)
+			return;
+
+		const auto frame = RenderFrame(options.width, options.height, 12);
+		const auto tileCount = tilesAcross * tilesDown;
+		std::vector<std::vector<uint8_t>> tiles(tileCount);
+		uint64_t compressedSizeBytes = 0;
+		for (uint32_t tile = 0; tile < tileCount; tile++)
+		{
+			const auto pTile = frame.data() + (size_t)(tile / tilesAcross) * kTileSize * options.width + (tile % tilesAcross) * kTileSize;
+			if (!EncodeLossyTile(tiles[tile], pTile, options.width))
+			{
+				printf("%s failed to encode\n", name);
+				return;
+			}
+			compressedSizeBytes += tiles[tile].size();
+		}
+
+		// One decompressor per worker, kept across frames as the reader's threads keep theirs
+		std::vector<uint16_t> decoded(frame.size());
+		std::vector<Jpeg::LossyJpegContext*> contexts;
+		benchmark.Measure(name, compressedSizeBytes, (uint64_t)tileCount * kTileSize * kTileSize, [&]()
+		{
+			const auto workerCount = std::min(tileCount, ThreadPool::Instance().ThreadCount());
+			while (contexts.size() < workerCount)
+				contexts.push_back(Jpeg::CreateLossyContext());
+
+			std::atomic<bool> decodedAll(true);
+			ThreadPool::Instance().ParallelFor(workerCount, [&](uint32_t worker)
+			{
+				for (uint32_t tile = worker; tile < tileCount; tile += workerCount)
+				{
+					const auto originX = (tile % tilesAcross) * kTileSize;
+					const auto originY = (tile / tilesAcross) * kTileSize;
+					const auto error = draft
+						? Jpeg::DecodeLossyDraft(contexts[worker], (uint8_t*)decoded.data(), options.width / 2 * sizeof(uint16_t), originX / 2, originY / 2,
+							tiles[tile].data(), (uint32_t)tiles[tile].size(), kTileSize, kTileSize, 12)
+						: Jpeg::DecodeLossy(contexts[worker], (uint8_t*)decoded.data(), options.width * sizeof(uint16_t), originX, originY,
+							tiles[tile].data(), (uint32_t)tiles[tile].size(), kTileSize, kTileSize, 12, nullptr, nullptr);
+					if (error != Core::eError::None)
+						decodedAll = false;
+				}
+			});
+			return decodedAll.load();
+		});
+		for (auto pContext : contexts)
+			Jpeg::DestroyLossyContext(pContext);
+	}
+
+	// The same tiles to a DC only thumbnail, laid out back to back as a batch of one frame
+	void BenchmarkLossyThumbnails(Benchmark& benchmark, const sOptions& options)
+	{
+		char name[128];
+		snprintf(name, sizeof(name), "DecodeLossyThumbnails tile=%ux%u", kTileSize, kTileSize);
+		const auto tilesAcross = options.width / kTileSize;
+		const auto tilesDown = options.height / kTileSize;
+		if (!benchmark.Selected(name) || tilesAcross == 0 || tilesDown == 0)
+			return;
+
+		const auto frame = RenderFrame(options.width, options.height, 12);
+		const auto tileCount = tilesAcross * tilesDown;
+		std::vector<uint8_t> compressed;
+		std::vector<uint64_t> tileOffsets(tileCount);
+		std::vector<uint32_t> tileSizeBytes(tileCount);
+		std::vector<uint8_t> tile;
+		for (uint32_t i = 0; i < tileCount; i++)
+		{
+			const auto pTile = frame.data() + (size_t)(i / tilesAcross) * kTileSize * options.width + (i % tilesAcross) * kTileSize;
+			if (!EncodeLossyTile(tile, pTile, options.width))
+			{
+				printf("%s failed to encode\n", name);
+				return;
+			}
+			tileOffsets[i] = compressed.size();
+			tileSizeBytes[i] = (uint32_t)tile.size();
+			compressed.insert(compressed.end(), tile.begin(), tile.end());
+		}
+
+		std::vector<uint16_t> thumbnail((size_t)tileCount * (kTileSize / 8) * (kTileSize / 8));
+		benchmark.Measure(name, compressed.size(), (uint64_t)tileCount * kTileSize * kTileSize, [&]()
+		{
+			return Jpeg::DecodeLossyThumbnails((uint8_t*)thumbnail.data(), compressed.data(), tileOffsets.data(), tileSizeBytes.data(), tileCount, tileCount,
+				tilesAcross, kTileSize, kTileSize, 12, nullptr) == Core::eError::None;
+		});
+	}
+#endif
+
+	// Packed uncompressed frames, unpacked in bands of rows across the pool
+	void BenchmarkUnpack(Benchmark& benchmark, const sOptions& options, const char* pName, uint32_t bits,
+		void (*unpack)(uint8_t*, const uint8_t*, uint32_t), uint32_t inputOffsetBytes)
+	{
+		if (!benchmark.Selected(pName))
+			return;
+
+		static const uint32_t kBandRows = 16;
+		const auto rowSizeBytes = options.width * bits / 8;
+		const auto bandCount = (options.height + kBandRows - 1) / kBandRows;
+		std::vector<uint8_t> packed(inputOffsetBytes + (size_t)rowSizeBytes * options.height);
+		uint32_t state = 0x2545F491u;
+		for (auto& byte : packed)
+		{
+			state = state * 1664525u + 1013904223u;
+			byte = (uint8_t)(state >> 24);
+		}
+
+		std::vector<uint16_t> unpacked((size_t)options.width * options.height);
+		benchmark.Measure(pName, (uint64_t)rowSizeBytes * options.height, (uint64_t)options.width * options.height, [&]()
+		{
+			ThreadPool::Instance().ParallelFor(bandCount, [&](uint32_t band)
+			{
+				const auto firstRow = band * kBandRows;
+				const auto rows = std::min(kBandRows, options.height - firstRow);
+				unpack((uint8_t*)(unpacked.data() + (size_t)firstRow * options.width), packed.data() + inputOffsetBytes + (size_t)firstRow * rowSizeBytes,
+					rows * rowSizeBytes);
+			});
+			return true;
+		});
+	}
+
+	bool ParseOptions(int argc, char** argv, sOptions& options)
+	{
+		for (int i = 1; i < argc; i++)
+		{
+			const std::string option = argv[i];
+			if (option == "--csv")
+			{
+				options.csv = true;
+				continue;
+			}
+			if (i + 1 >= argc)
+				return false;
+			const char* pValue = argv[++i];
+
+			if (option == "--threads")
+				options.maxThreads = (uint32_t)atoi(pValue);
+			else if (option == "--size")
+			{
+				if (sscanf(pValue, "%ux%u", &options.width, &options.height) != 2)
+					return false;
+			}
+			else if (option == "--bits")
+				options.bits = (uint32_t)atoi(pValue);
+			else if (option == "--seconds")
+				options.seconds = atof(pValue);
+			else if (option == "--filter")
+				options.filter = pValue;
+			else
+				return false;
+		}
+
+		return options.width != 0 && options.width % 16 == 0 && options.height != 0 && options.height % 2 == 0
+			&& options.bits >= 10 && options.bits <= 16 && options.seconds > 0.0;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	sOptions options;
+	if (!ParseOptions(argc, argv, options))
+	{
+		fprintf(stderr, "Usage: DecoderBenchmark [--threads N] [--size WxH] [--bits N] [--seconds N] [--filter TEXT] [--csv]\n");
+		return 1;
+	}
+
+	auto pContext = Jpeg::CreateLosslessContext();
+	bool failed = false;
+	{
+		Benchmark benchmark(options);
+		BenchmarkLossless(benchmark, options, pContext);
+		BenchmarkLosslessTiles(benchmark, options, pContext);
+		BenchmarkLosslessIndexed(benchmark, options, pContext);
+		BenchmarkLosslessStatistics(benchmark, options, pContext);
+#ifndef DECODERS_WITHOUT_LIBJPEG_TURBO
+		BenchmarkLossy(benchmark, options, false);
+		BenchmarkLossy(benchmark, options, true);
+		BenchmarkLossyThumbnails(benchmark, options);
+#endif
+		BenchmarkUnpack(benchmark, options, "Unpack10to16Bit", 10, Unpack::Unpack10to16Bit, 0);
+		BenchmarkUnpack(benchmark, options, "Unpack12to16Bit", 12, Unpack::Unpack12to16Bit, Unpack::Unpack12InputOffsetBytes());
+		BenchmarkUnpack(benchmark, options, "Unpack14to16Bit", 14, Unpack::Unpack14to16Bit, 0);
+		failed = benchmark.Failed();
+	}
+	Jpeg::DestroyLosslessContext(pContext);
+	return failed ? 1 : 0;
+}
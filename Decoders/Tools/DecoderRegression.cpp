@@ -0,0 +1,216 @@
+// Feeds the lossless decoder damaged streams, checking it reports them rather than reading outside its input.
+// Meant to be run under AddressSanitizer as well as on its own, it is registered with CTest.
+//
+// Usage: DecoderRegression
+//
+// Streams are encoded with EncodeLossless, then truncated or have bytes flipped, and are copied to buffers exactly as large
+// as the decoder asks for (the stream and DecodeLosslessInputPaddingBytes of zeroes), so any read past them is caught.
+// Every entry point that positions the bit reader is covered: whole streams, restart intervals and speculative chunks
+// decoded in parallel, tiles decoded in lockstep, and bands decoded from a checkpoint index. The parallel paths are only
+// taken with more than one hardware thread.
+
+#include "../Jpeg/LosslessJpeg.h"
+#include "../Jpeg/LosslessJpegEncoder.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+using namespace Octopus::Player;
+using namespace Octopus::Player::Decoders;
+
+namespace
+{
+	struct sStream
+	{
+		std::vector<uint8_t> compressed;
+		uint32_t width;
+		uint32_t height;
+		uint32_t bits;
+	};
+
+	uint32_t g_failures = 0;
+
+	void Fail(const char* pCase, uint32_t sizeBytes)
+	{
+		printf("FAILED %s (%u bytes)\n", pCase, sizeBytes);
+		g_failures++;
+	}
+
+	// Noise over a gradient, so every category of difference turns up
+	bool EncodeStream(sStream& stream, uint32_t width, uint32_t height, uint32_t bits, uint32_t components, uint32_t predictor, uint32_t restartRows)
+	{
+		std::vector<uint16_t> image((size_t)width * height);
+		uint32_t state = 0x2545F491u;
+		for (uint32_t y = 0; y < height; y++)
+		{
+			for (uint32_t x = 0; x < width; x++)
+			{
+				state = state * 1664525u + 1013904223u;
+				image[(size_t)y * width + x] = (uint16_t)(((x + y) * 7 + (state >> 24)) & ((1u << bits) - 1));
+			}
+		}
+
+		stream.width = width;
+		stream.height = height;
+		stream.bits = bits;
+		stream.compressed.resize(Jpeg::EncodeLosslessMaxSizeBytes(width, height));
+		uint32_t compressedSizeBytes = 0;
+		if (Jpeg::EncodeLossless(stream.compressed.data(), (uint32_t)stream.compressed.size(), &compressedSizeBytes, (const uint8_t*)image.data(),
+			width * sizeof(uint16_t), width, height, bits, components, predictor, restartRows) != Core::eError::None)
+			return false;
+		stream.compressed.resize(compressedSizeBytes);
+		return true;
+	}
+
+	// The first sizeBytes of a stream, followed by the zeroes the decoder requires and nothing else
+	std::vector<uint8_t> PaddedInput(const uint8_t* pCompressed, uint32_t sizeBytes)
+	{
+		std::vector<uint8_t> input(sizeBytes + Jpeg::DecodeLosslessInputPaddingBytes(), 0);
+		memcpy(input.data(), pCompressed, sizeBytes);
+		return input;
+	}
+
+	Core::eError Decode(Jpeg::LosslessJpegContext* pContext, const sStream& stream, std::vector<uint8_t>& input, uint32_t sizeBytes)
+	{
+		std::vector<uint16_t> decoded((size_t)stream.width * stream.height);
+		return Jpeg::DecodeLossless(pContext, (uint8_t*)decoded.data(), stream.width * sizeof(uint16_t), 0, 0, input.data(), sizeBytes, stream.width,
+			stream.height, stream.bits, nullptr);
+	}
+
+	// Truncations to every length from a quarter of the stream, which must fail once too little is left to hold the image,
+	// and a byte flipped at every position after the headers, which only must not crash
+	void CheckDamagedStreams(Jpeg::LosslessJpegContext* pContext, const char* pCase, const sStream& stream, uint32_t step)
+	{
+		const auto sizeBytes = (uint32_t)stream.compressed.size();
+		for (uint32_t truncated = sizeBytes / 4; truncated < sizeBytes; truncated += step)
+		{
+			auto input = PaddedInput(stream.compressed.data(), truncated);
+			const auto error = Decode(pContext, stream, input, truncated);
+			if (truncated <= sizeBytes / 2 && error == Core::eError::None)
+				Fail(pCase, truncated);
+		}
+
+		for (uint32_t position = std::min(sizeBytes, 256u); position < sizeBytes; position += step)
+		{
+			auto input = PaddedInput(stream.compressed.data(), sizeBytes);
+			input[position] ^= 0x5A;
+			Decode(pContext, stream, input, sizeBytes);
+		}
+	}
+
+	// Whole streams decoded on one thread, the shape that first showed the bit reader running off the end of its input
+	void CheckStreams(Jpeg::LosslessJpegContext* pContext)
+	{
+		sStream stream;
+		if (!EncodeStream(stream, 50, 39, 11, 2, 5, 0))
+			return Fail("encode 50x39", 0);
+		CheckDamagedStreams(pContext, "truncated 50x39 components=2 predictor=5", stream, 1);
+
+		for (uint32_t predictor = 1; predictor <= 7; predictor++)
+		{
+			if (!EncodeStream(stream, 256, 64, 14, 4, predictor, 0))
+				return Fail("encode 256x64", 0);
+			CheckDamagedStreams(pContext, "truncated 256x64 components=4", stream, 17);
+		}
+	}
+
+	// Restart intervals and speculative chunks are decoded in parallel from positions within the stream
+	void CheckParallelStreams(Jpeg::LosslessJpegContext* pContext)
+	{
+		sStream stream;
+		if (!EncodeStream(stream, 1024, 512, 14, 2, 1, 16))
+			return Fail("encode restarts", 0);
+		CheckDamagedStreams(pContext, "truncated restarts", stream, (uint32_t)stream.compressed.size() / 16);
+
+		if (!EncodeStream(stream, 2048, 1024, 16, 2, 1, 0))
+			return Fail("encode speculative", 0);
+		CheckDamagedStreams(pContext, "truncated speculative", stream, (uint32_t)stream.compressed.size() / 8);
+	}
+
+	// Tiles of the same shape are decoded in lockstep, each truncated to a different length
+	void CheckTiles(Jpeg::LosslessJpegContext* pContext)
+	{
+		const uint32_t tileCount = 8;
+		sStream tile;
+		if (!EncodeStream(tile, 64, 64, 12, 2, 1, 0))
+			return Fail("encode tiles", 0);
+
+		const auto paddingBytes = Jpeg::DecodeLosslessInputPaddingBytes();
+		std::vector<uint64_t> tileOffsets(tileCount);
+		std::vector<uint32_t> tileSizeBytes(tileCount);
+		std::vector<uint8_t> compressed;
+		for (uint32_t i = 0; i < tileCount; i++)
+		{
+			tileOffsets[i] = compressed.size();
+			tileSizeBytes[i] = (uint32_t)tile.compressed.size() * (i + 1) / (tileCount + 1);
+			compressed.insert(compressed.end(), tile.compressed.begin(), tile.compressed.begin() + tileSizeBytes[i]);
+			compressed.resize(compressed.size() + paddingBytes, 0);
+		}
+
+		std::vector<uint16_t> decoded((size_t)tileCount * 64 * 64);
+		std::vector<Core::eError> tileErrors(tileCount);
+		Jpeg::DecodeLosslessTiles(pContext, (uint8_t*)decoded.data(), tileCount * 64 * sizeof(uint16_t), compressed.data(), tileOffsets.data(),
+			tileSizeBytes.data(), tileCount, tileCount, 64, 64, 12, false, tileErrors.data(), nullptr);
+		for (uint32_t i = 0; i < tileCount; i++)
+		{
+			if (tileSizeBytes[i] <= tile.compressed.size() / 2 && tileErrors[i] == Core::eError::None)
+				Fail("truncated tiles", tileSizeBytes[i]);
+		}
+	}
+
+	// Bands decoded from the bit positions of a checkpoint index, here pointing past the end of the stream
+	void CheckIndexed(Jpeg::LosslessJpegContext* pContext)
+	{
+		sStream stream;
+		if (!EncodeStream(stream, 512, 256, 14, 2, 1, 0))
+			return Fail("encode indexed", 0);
+
+		const auto sizeBytes = (uint32_t)stream.compressed.size();
+		auto input = PaddedInput(stream.compressed.data(), sizeBytes);
+		std::vector<uint16_t> decoded((size_t)stream.width * stream.height);
+		std::vector<uint8_t> index(Jpeg::LosslessCheckpointIndexSizeBytes(input.data(), sizeBytes));
+		if (index.empty() || Jpeg::DecodeLosslessIndexing(pContext, (uint8_t*)decoded.data(), stream.width * sizeof(uint16_t), 0, 0, input.data(), sizeBytes,
+			stream.width, stream.height, stream.bits, index.data(), (uint32_t)index.size(), nullptr) != Core::eError::None)
+			return Fail("index", sizeBytes);
+
+		// The index header is 40 bytes, its checkpoint count at byte 24, and is followed by a bit position per checkpoint
+		const size_t headerSizeBytes = 40;
+		uint32_t checkpointCount;
+		memcpy(&checkpointCount, index.data() + 24, sizeof(checkpointCount));
+		if (checkpointCount == 0)
+			return Fail("index checkpoints", sizeBytes);
+		for (const uint64_t corrupt : { (uint64_t)sizeBytes * 8 + 1, (uint64_t)sizeBytes * 8 + 4096, UINT64_MAX })
+		{
+			auto corruptIndex = index;
+			for (uint32_t i = 0; i < checkpointCount; i++)
+				memcpy(corruptIndex.data() + headerSizeBytes + i * sizeof(uint64_t), &corrupt, sizeof(corrupt));
+			if (Jpeg::DecodeLosslessIndexed(pContext, (uint8_t*)decoded.data(), stream.width * sizeof(uint16_t), 0, 0, input.data(), sizeBytes, stream.width,
+				stream.height, stream.bits, corruptIndex.data(), (uint32_t)corruptIndex.size(), nullptr) == Core::eError::None)
+				Fail("index past the end", sizeBytes);
+		}
+	}
+}
+
+int main(int, char**)
+{
+	// Only the decoder this checks, whatever the environment asks for
+	Jpeg::SetLosslessBackend(Jpeg::eLosslessBackend::DngSdk);
+
+	auto pContext = Jpeg::CreateLosslessContext();
+	for (auto pCaseContext : { (Jpeg::LosslessJpegContext*)nullptr, pContext })
+	{
+		CheckStreams(pCaseContext);
+		CheckParallelStreams(pCaseContext);
+		CheckTiles(pCaseContext);
+		CheckIndexed(pCaseContext);
+	}
+	Jpeg::DestroyLosslessContext(pContext);
+
+	if (g_failures)
+		printf("%u damaged streams decoded without an error\n", g_failures);
+	else
+		printf("Damaged streams reported\n");
+	return g_failures ? 1 : 0;
+}
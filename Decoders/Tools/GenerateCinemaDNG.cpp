@@ -0,0 +1,487 @@
+// Writes a synthetic CinemaDNG sequence, so decoder throughput can be measured and reproduced without camera footage.
+//
+// Usage: GenerateCinemaDNG <output folder> [options]
+//   --frames N              Number of frames (default 24)
+//   --size WxH              Frame dimensions, multiples of 2 (default 4096x2160)
+//   --bits N                Bit depth, 8, 10, 12, 14 or 16 (default 12)
+//   --compression MODE      none or lossless (default lossless)
+//   --tile WxH              Tile dimensions, strips are written when not given
+//   --rows-per-strip N      Rows per strip (default the whole frame)
+//   --predictor N           Lossless JPEG predictor 1-7 (default 1)
+//   --restart-rows N        Lossless JPEG restart interval in rows (default none)
+//   --noise N               Standard deviation of the sensor noise in code values (default 8)
+//   --crop X,Y,W,H          DefaultCrop rectangle
+//   --fps N                 Frame rate (default 24)
+//   --seed N                Random seed (default 1)
+//
+// Frames are numbered <folder name>_000000.dng onwards.
+
+#include "../Jpeg/LosslessJpegEncoder.h"
+#include "../ThreadPool.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+using namespace Octopus::Player;
+using namespace Octopus::Player::Decoders;
+
+namespace
+{
+	struct sOptions
+	{
+		std::string folder;
+		uint32_t frames = 24;
+		uint32_t width = 4096;
+		uint32_t height = 2160;
+		uint32_t bits = 12;
+		bool compressed = true;
+		uint32_t tileWidth = 0;
+		uint32_t tileHeight = 0;
+		uint32_t rowsPerStrip = 0;
+		uint32_t predictor = 1;
+		uint32_t restartRows = 0;
+		double noise = 8.0;
+		bool crop = false;
+		uint32_t cropX = 0, cropY = 0, cropWidth = 0, cropHeight = 0;
+		uint32_t fps = 24;
+		uint32_t seed = 1;
+	};
+
+	enum eTiffType : uint16_t
+	{
+		Byte = 1,
+		Ascii = 2,
+		Short = 3,
+		Long = 4,
+		Rational = 5,
+		SRational = 10
+	};
+
+	// Little endian TIFF image file directory, entries are written in tag order with their values after the directory
+	class TiffDirectory
+	{
+	public:
+
+		void Add(uint16_t tag, eTiffType type, const std::vector<uint32_t>& values)
+		{
+			m_entries.push_back({ tag, type, values });
+		}
+
+		void AddAscii(uint16_t tag, const char* pText)
+		{
+			std::vector<uint32_t> values(pText, pText + strlen(pText) + 1);
+			Add(tag, eTiffType::Ascii, values);
+		}
+
+		// Directory at offset 8, straight after the header, followed by the out of line values. Returns the end offset.
+		uint32_t Write(std::vector<uint8_t>& file) const
+		{
+			auto entries = m_entries;
+			std::stable_sort(entries.begin(), entries.end(), [](const sEntry& a, const sEntry& b) { return a.tag < b.tag; });
+
+			file.assign({ 'I', 'I', 42, 0 });
+			Put32(file, 8);
+			Put16(file, (uint16_t)entries.size());
+
+			auto valueOffset = (uint32_t)(8 + 2 + entries.size() * 12 + 4);
+			std::vector<uint8_t> values;
+			for (const auto& entry : entries)
+			{
+				std::vector<uint8_t> data;
+				for (auto value : entry.values)
+				{
+					switch (entry.type)
+					{
+					case eTiffType::Byte:
+					case eTiffType::Ascii:
+						data.push_back((uint8_t)value);
+						break;
+					case eTiffType::Short:
+						Put16(data, (uint16_t)value);
+						break;
+					default:
+						Put32(data, value);
+						break;
+					}
+				}
+				const auto count = (entry.type == eTiffType::Rational || entry.type == eTiffType::SRational) ? entry.values.size() / 2 : entry.values.size();
+
+				Put16(file, entry.tag);
+				Put16(file, entry.type);
+				Put32(file, (uint32_t)count);
+				if (data.size() <= 4)
+				{
+					data.resize(4, 0);
+					file.insert(file.end(), data.begin(), data.end());
+				}
+				else
+				{
+					Put32(file, valueOffset + (uint32_t)values.size());
+					values.insert(values.end(), data.begin(), data.end());
+					if (values.size() & 1)
+						values.push_back(0);
+				}
+			}
+			Put32(file, 0);
+			file.insert(file.end(), values.begin(), values.end());
+			return (uint32_t)file.size();
+		}
+
+		static void Put16(std::vector<uint8_t>& data, uint16_t value)
+		{
+			data.push_back((uint8_t)value);
+			data.push_back((uint8_t)(value >> 8));
+		}
+
+		static void Put32(std::vector<uint8_t>& data, uint32_t value)
+		{
+			Put16(data, (uint16_t)value);
+			Put16(data, (uint16_t)(value >> 16));
+		}
+
+	private:
+
+		struct sEntry
+		{
+			uint16_t tag;
+			eTiffType type;
+			std::vector<uint32_t> values;
+		};
+
+		std::vector<sEntry> m_entries;
+	};
+
+	// Fast repeatable noise, a shared table of normally distributed values indexed by a xorshift generator
+	static const uint32_t kNoiseTableSize = 1 << 16;
+
+	uint32_t XorShift(uint32_t& state)
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	}
+
+	std::vector<int16_t> BuildNoiseTable(double sigma, uint32_t seed)
+	{
+		std::vector<int16_t> table(kNoiseTableSize);
+		uint32_t state = seed * 2654435761u + 1;
+		for (auto& value : table)
+		{
+			const auto u1 = (XorShift(state) + 1.0) / 4294967297.0;
+			const auto u2 = XorShift(state) / 4294967296.0;
+			value = (int16_t)lround(sigma * sqrt(-2.0 * log(u1)) * cos(6.283185307179586 * u2));
+		}
+		return table;
+	}
+
+	// Moving colour gradients and bars on an RGGB mosaic, with sensor noise
+	void RenderFrame(std::vector<uint16_t>& frame, const sOptions& options, const std::vector<int16_t>& noiseTable, uint32_t frameIndex)
+	{
+		const auto maxValue = (int32_t)((1u << options.bits) - 1);
+		const auto blackLevel = maxValue / 16;
+		const auto shift = (int32_t)frameIndex * 8;
+		auto& threadPool = ThreadPool::Instance();
+		const auto bandRows = 64u;
+		const auto bandCount = (options.height + bandRows - 1) / bandRows;
+
+		threadPool.ParallelFor(bandCount, [&](uint32_t band)
+		{
+			uint32_t noiseState = (options.seed * 7919u + frameIndex * 104729u + band) | 1;
+			const auto endRow = std::min(options.height, (band + 1) * bandRows);
+			for (uint32_t y = band * bandRows; y < endRow; y++)
+			{
+				auto pRow = frame.data() + (size_t)y * options.width;
+				for (uint32_t x = 0; x < options.width; x++)
+				{
+					const auto colour = (y & 1) + (x & 1);	// 0 red, 1 green, 2 blue
+					const auto u = (double)((int32_t)x + shift) / options.width;
+					const auto v = (double)y / options.height;
+					const auto bar = (((int32_t)x + shift) / 256) % 8;
+					auto level = 0.25 + 0.5 * (colour == 0 ? u : colour == 1 ? 1.0 - v : v * (1.0 - u));
+					if ((bar >> colour) & 1)
+						level *= 0.6;
+					const auto value = blackLevel + (int32_t)(level * (maxValue - blackLevel)) + noiseTable[XorShift(noiseState) & (kNoiseTableSize - 1)];
+					pRow[x] = (uint16_t)std::min(maxValue, std::max(0, value));
+				}
+			}
+		});
+	}
+
+	// Big endian bit packing of a block of rows, as uncompressed DNG stores them
+	void PackRows(std::vector<uint8_t>& out, const uint16_t* pRows, uint32_t width, uint32_t rows, uint32_t bits)
+	{
+		const auto count = (size_t)width * rows;
+		if (bits == 8)
+		{
+			for (size_t i = 0; i < count; i++)
+				out.push_back((uint8_t)pRows[i]);
+			return;
+		}
+		if (bits == 16)
+		{
+			for (size_t i = 0; i < count; i++)
+				TiffDirectory::Put16(out, pRows[i]);
+			return;
+		}
+
+		uint64_t buffer = 0;
+		uint32_t bufferBits = 0;
+		for (size_t i = 0; i < count; i++)
+		{
+			buffer = (buffer << bits) | pRows[i];
+			bufferBits += bits;
+			while (bufferBits >= 8)
+			{
+				bufferBits -= 8;
+				out.push_back((uint8_t)(buffer >> bufferBits));
+			}
+		}
+		if (bufferBits)
+			out.push_back((uint8_t)(buffer << (8 - bufferBits)));
+	}
+
+	// Encodes one strip or tile, which may hang over the frame edge and is then padded by repeating the last row and column
+	bool EncodeSegment(std::vector<uint8_t>& out, const std::vector<uint16_t>& frame, const sOptions& options, uint32_t x, uint32_t y,
+		uint32_t width, uint32_t height)
+	{
+		std::vector<uint16_t> samples((size_t)width * height);
+		for (uint32_t row = 0; row < height; row++)
+		{
+			const auto sourceRow = std::min(y + row, options.height - 1);
+			for (uint32_t column = 0; column < width; column++)
+			{
+				const auto sourceColumn = std::min(x + column, options.width - 1);
+				samples[(size_t)row * width + column] = frame[(size_t)sourceRow * options.width + sourceColumn];
+			}
+		}
+
+		if (!options.compressed)
+		{
+			PackRows(out, samples.data(), width, height, options.bits);
+			return true;
+		}
+
+		// DNG codes Bayer data as two component pixels
+		out.resize(Jpeg::EncodeLosslessMaxSizeBytes(width, height));
+		uint32_t sizeBytes = 0;
+		const auto result = Jpeg::EncodeLossless(out.data(), (uint32_t)out.size(), &sizeBytes, (const uint8_t*)samples.data(), width * sizeof(uint16_t),
+			width, height, options.bits, 2, options.predictor, options.restartRows);
+		out.resize(sizeBytes);
+		return result == Core::eError::None;
+	}
+
+	bool WriteFrame(const sOptions& options, const std::vector<uint16_t>& frame, uint32_t frameIndex, const std::string& path)
+	{
+		const bool tiled = options.tileWidth != 0;
+		const auto segmentWidth = tiled ? options.tileWidth : options.width;
+		const auto segmentHeight = tiled ? options.tileHeight : (options.rowsPerStrip ? options.rowsPerStrip : options.height);
+		const auto across = (options.width + segmentWidth - 1) / segmentWidth;
+		const auto down = (options.height + segmentHeight - 1) / segmentHeight;
+		const auto segmentCount = across * down;
+
+		// Strips end at the frame edge, tiles are always whole
+		std::vector<std::vector<uint8_t>> segments(segmentCount);
+		std::vector<bool> encoded(segmentCount);
+		ThreadPool::Instance().ParallelFor(segmentCount, [&](uint32_t segment)
+		{
+			const auto x = (segment % across) * segmentWidth;
+			const auto y = (segment / across) * segmentHeight;
+			const auto height = tiled ? segmentHeight : std::min(segmentHeight, options.height - y);
+			encoded[segment] = EncodeSegment(segments[segment], frame, options, x, y, segmentWidth, height);
+		});
+		for (uint32_t i = 0; i < segmentCount; i++)
+		{
+			if (!encoded[i])
+				return false;
+		}
+
+		const auto maxValue = (1u << options.bits) - 1;
+		TiffDirectory directory;
+		directory.Add(254, eTiffType::Long, { 0 });										// NewSubfileType
+		directory.Add(256, eTiffType::Long, { options.width });							// ImageWidth
+		directory.Add(257, eTiffType::Long, { options.height });							// ImageLength
+		directory.Add(258, eTiffType::Short, { options.bits });							// BitsPerSample
+		directory.Add(259, eTiffType::Short, { options.compressed ? 7u : 1u });			// Compression
+		directory.Add(262, eTiffType::Short, { 32803 });									// PhotometricInterpretation, CFA
+		directory.Add(274, eTiffType::Short, { 1 });										// Orientation
+		directory.Add(277, eTiffType::Short, { 1 });										// SamplesPerPixel
+		directory.Add(284, eTiffType::Short, { 1 });										// PlanarConfiguration
+		directory.Add(33421, eTiffType::Short, { 2, 2 });									// CFARepeatPatternDim
+		directory.Add(33422, eTiffType::Byte, { 0, 1, 1, 2 });							// CFAPattern, RGGB
+		directory.Add(50706, eTiffType::Byte, { 1, 4, 0, 0 });							// DNGVersion
+		directory.Add(50707, eTiffType::Byte, { 1, 1, 0, 0 });							// DNGBackwardVersion
+		directory.AddAscii(50708, "Octopus Synthetic");									// UniqueCameraModel
+		directory.Add(50714, eTiffType::Long, { maxValue / 16 });							// BlackLevel
+		directory.Add(50717, eTiffType::Long, { maxValue });								// WhiteLevel
+		directory.Add(50721, eTiffType::SRational, {										// ColorMatrix1, sRGB primaries
+			(uint32_t)3240, 10000, (uint32_t)-1537, 10000, (uint32_t)-499, 10000,
+			(uint32_t)-969, 10000, (uint32_t)1876, 10000, (uint32_t)42, 10000,
+			(uint32_t)56, 10000, (uint32_t)-204, 10000, (uint32_t)1057, 10000 });
+		directory.Add(50728, eTiffType::Rational, { 1, 2, 1, 1, 2, 3 });					// AsShotNeutral
+		directory.Add(50778, eTiffType::Short, { 21 });									// CalibrationIlluminant1, D65
+		directory.Add(51044, eTiffType::SRational, { options.fps, 1 });					// FrameRate
+
+		// TimeCodes, BCD frames/seconds/minutes/hours
+		const auto seconds = frameIndex / options.fps;
+		const auto ToBcd = [](uint32_t value) { return ((value / 10) << 4) | (value % 10); };
+		directory.Add(51043, eTiffType::Byte, { ToBcd(frameIndex % options.fps), ToBcd(seconds % 60), ToBcd(seconds / 60 % 60), ToBcd(seconds / 3600 % 24), 0, 0, 0, 0 });
+
+		if (options.crop)
+		{
+			directory.Add(50719, eTiffType::Long, { options.cropX, options.cropY });		// DefaultCropOrigin
+			directory.Add(50720, eTiffType::Long, { options.cropWidth, options.cropHeight });	// DefaultCropSize
+		}
+
+		// Segment offsets depend on the directory size, which doesn't depend on their values
+		std::vector<uint32_t> offsets(segmentCount, 0);
+		std::vector<uint32_t> byteCounts(segmentCount);
+		for (uint32_t i = 0; i < segmentCount; i++)
+			byteCounts[i] = (uint32_t)segments[i].size();
+
+		const auto AddSegmentTags = [&](TiffDirectory& target)
+		{
+			if (tiled)
+			{
+				target.Add(322, eTiffType::Long, { options.tileWidth });					// TileWidth
+				target.Add(323, eTiffType::Long, { options.tileHeight });					// TileLength
+				target.Add(324, eTiffType::Long, offsets);									// TileOffsets
+				target.Add(325, eTiffType::Long, byteCounts);								// TileByteCounts
+			}
+			else
+			{
+				target.Add(273, eTiffType::Long, offsets);									// StripOffsets
+				target.Add(278, eTiffType::Long, { segmentHeight });						// RowsPerStrip
+				target.Add(279, eTiffType::Long, byteCounts);								// StripByteCounts
+			}
+		};
+
+		std::vector<uint8_t> file;
+		auto sizingDirectory = directory;
+		AddSegmentTags(sizingDirectory);
+		auto offset = sizingDirectory.Write(file);
+		for (uint32_t i = 0; i < segmentCount; i++)
+		{
+			offsets[i] = offset;
+			offset += byteCounts[i];
+		}
+		AddSegmentTags(directory);
+		directory.Write(file);
+		for (const auto& segment : segments)
+			file.insert(file.end(), segment.begin(), segment.end());
+
+		auto pFile = fopen(path.c_str(), "wb");
+		if (!pFile)
+			return false;
+		const bool written = fwrite(file.data(), 1, file.size(), pFile) == file.size();
+		return fclose(pFile) == 0 && written;
+	}
+
+	bool ParsePair(const char* pText, uint32_t& a, uint32_t& b)
+	{
+		return sscanf(pText, "%ux%u", &a, &b) == 2;
+	}
+
+	bool ParseOptions(int argc, char** argv, sOptions& options)
+	{
+		if (argc < 2)
+			return false;
+		options.folder = argv[1];
+
+		for (int i = 2; i < argc; i++)
+		{
+			const std::string option = argv[i];
+			if (i + 1 >= argc)
+				return false;
+			const char* pValue = argv[++i];
+
+			if (option == "--frames")
+				options.frames = (uint32_t)atoi(pValue);
+			else if (option == "--size")
+			{
+				if (!ParsePair(pValue, options.width, options.height))
+					return false;
+			}
+			else if (option == "--bits")
+				options.bits = (uint32_t)atoi(pValue);
+			else if (option == "--compression")
+				options.compressed = strcmp(pValue, "none") != 0;
+			else if (option == "--tile")
+			{
+				if (!ParsePair(pValue, options.tileWidth, options.tileHeight))
+					return false;
+			}
+			else if (option == "--rows-per-strip")
+				options.rowsPerStrip = (uint32_t)atoi(pValue);
+			else if (option == "--predictor")
+				options.predictor = (uint32_t)atoi(pValue);
+			else if (option == "--restart-rows")
+				options.restartRows = (uint32_t)atoi(pValue);
+			else if (option == "--noise")
+				options.noise = atof(pValue);
+			else if (option == "--crop")
+			{
+				options.crop = sscanf(pValue, "%u,%u,%u,%u", &options.cropX, &options.cropY, &options.cropWidth, &options.cropHeight) == 4;
+				if (!options.crop)
+					return false;
+			}
+			else if (option == "--fps")
+				options.fps = (uint32_t)atoi(pValue);
+			else if (option == "--seed")
+				options.seed = (uint32_t)atoi(pValue);
+			else
+				return false;
+		}
+
+		const bool validBits = options.bits == 8 || options.bits == 10 || options.bits == 12 || options.bits == 14 || options.bits == 16;
+		const bool validTile = options.tileWidth == 0 || (options.tileWidth % 2 == 0 && options.tileHeight % 2 == 0 && options.tileHeight != 0);
+		return validBits && validTile && options.width % 2 == 0 && options.height % 2 == 0 && options.fps != 0
+			&& (options.rowsPerStrip % 2 == 0) && (!options.compressed || (options.predictor >= 1 && options.predictor <= 7));
+	}
+}
+
+int main(int argc, char** argv)
+{
+	sOptions options;
+	if (!ParseOptions(argc, argv, options))
+	{
+		fprintf(stderr, "Usage: GenerateCinemaDNG <output folder> [--frames N] [--size WxH] [--bits N] [--compression none|lossless] [--tile WxH]\n"
+			"    [--rows-per-strip N] [--predictor N] [--restart-rows N] [--noise N] [--crop X,Y,W,H] [--fps N] [--seed N]\n");
+		return 1;
+	}
+
+	// Sequencing field follows the folder name, as cameras name their frames
+	auto folderName = options.folder;
+	while (!folderName.empty() && (folderName.back() == '/' || folderName.back() == '\\'))
+		folderName.pop_back();
+	const auto separator = folderName.find_last_of("/\\");
+	const auto clipName = separator == std::string::npos ? folderName : folderName.substr(separator + 1);
+
+	std::error_code error;
+	std::filesystem::create_directories(folderName, error);
+
+	const auto noiseTable = BuildNoiseTable(options.noise, options.seed);
+	std::vector<uint16_t> frame((size_t)options.width * options.height);
+	for (uint32_t i = 0; i < options.frames; i++)
+	{
+		RenderFrame(frame, options, noiseTable, i);
+
+		char fileName[64];
+		snprintf(fileName, sizeof(fileName), "_%06u.dng", i);
+		const auto path = folderName + "/" + clipName + fileName;
+		if (!WriteFrame(options, frame, i, path))
+		{
+			fprintf(stderr, "Failed to write %s\n", path.c_str());
+			return 1;
+		}
+	}
+
+	printf("Wrote %u frames to %s\n", options.frames, folderName.c_str());
+	return 0;
+}
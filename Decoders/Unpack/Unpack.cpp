@@ -1,4 +1,8 @@
 #include "Unpack.h"
+#include "../Draft.h"
+#include "../RawStatistics.h"
+
+#include <vector>
 
 #ifdef __AVX2__
 #include <immintrin.h>
@@ -164,4 +168,97 @@ namespace Octopus::Player::Decoders::Unpack
 			*p16BitOut++ = (0x3fff & (b1 << 8)) | b0;
 		}
 	}
+
+	// Unpacks a block of samples at a time, adding each to the statistics while it is still in the cache
+	template<typename UnpackFunction>
+	static inline void UnpackStatistics(uint8_t* pOut, const uint8_t* pPacked, uint32_t sizeBytes, uint32_t bitsPerSample, uint32_t width,
+		uint64_t firstSample, sRawStatistics* pStatistics, UnpackFunction unpack)
+	{
+		// Whole packing groups of every bit depth
+		constexpr uint32_t kBlockSamples = 4096;
+		const auto blockSizeBytes = (kBlockSamples * bitsPerSample) / 8;
+
+		RawStatisticsRows statistics(pStatistics, 0, 0, width, firstSample);
+		for (uint32_t offset = 0; offset < sizeBytes; offset += blockSizeBytes)
+		{
+			const auto packedSizeBytes = std::min(blockSizeBytes, sizeBytes - offset);
+			const auto pBlockOut = pOut + ((uint64_t)offset * 16) / bitsPerSample;
+			unpack(pBlockOut, pPacked + offset, packedSizeBytes);
+			if (statistics.Enabled())
+				statistics.Accumulate((const uint16_t*)pBlockOut, ((uint64_t)packedSizeBytes * 8) / bitsPerSample);
+		}
+	}
+
+	extern "C" void Unpack10to16BitStatistics(uint8_t* pOut, const uint8_t* p10BitPacked, uint32_t sizeBytes, uint32_t width, uint64_t firstSample,
+		sRawStatistics* pStatistics)
+	{
+		UnpackStatistics(pOut, p10BitPacked, sizeBytes, 10, width, firstSample, pStatistics, Unpack10to16Bit);
+	}
+
+	extern "C" void Unpack12to16BitStatistics(uint8_t* pOut, const uint8_t* p12BitPacked, uint32_t sizeBytes, uint32_t width, uint64_t firstSample,
+		sRawStatistics* pStatistics)
+	{
+		UnpackStatistics(pOut, p12BitPacked, sizeBytes, 12, width, firstSample, pStatistics, Unpack12to16Bit);
+	}
+
+	extern "C" void Unpack14to16BitStatistics(uint8_t* pOut, const uint8_t* p14BitPacked, uint32_t sizeBytes, uint32_t width, uint64_t firstSample,
+		sRawStatistics* pStatistics)
+	{
+		UnpackStatistics(pOut, p14BitPacked, sizeBytes, 14, width, firstSample, pStatistics, Unpack14to16Bit);
+	}
+
+	extern "C" void RawStatistics8Bit(const uint8_t* p8Bit, uint32_t sizeBytes, uint32_t width, uint64_t firstSample, sRawStatistics* pStatistics)
+	{
+		RawStatisticsRows statistics(pStatistics, 0, 0, width, firstSample);
+		if (statistics.Enabled())
+			statistics.Accumulate(p8Bit, sizeBytes);
+	}
+
+	extern "C" void RawStatistics16Bit(const uint8_t* p16Bit, uint32_t sizeBytes, uint32_t width, uint64_t firstSample, sRawStatistics* pStatistics)
+	{
+		RawStatisticsRows statistics(pStatistics, 0, 0, width, firstSample);
+		if (statistics.Enabled())
+			statistics.Accumulate((const uint16_t*)p16Bit, sizeBytes / sizeof(uint16_t));
+	}
+
+	// Unpacks four rows at a time, then bins them to two rows of the draft output
+	template<typename T, typename UnpackFunction>
+	static inline void UnpackDraft(uint8_t* pOut, uint32_t outputStrideBytes, const uint8_t* pPacked, uint32_t width, uint32_t height,
+		uint32_t bitsPerSample, UnpackFunction unpack)
+	{
+		const auto packedRowSizeBytes = (width * bitsPerSample) / 8;
+		const auto rowSizeBytes = width * (uint32_t)sizeof(T);
+		std::vector<uint8_t> rows(4 * rowSizeBytes);
+
+		for (uint32_t y = 0; y + 4 <= height; y += 4)
+		{
+			unpack(rows.data(), pPacked + y * packedRowSizeBytes, 4 * packedRowSizeBytes);
+			BinBayerDraft<T>(pOut + (y / 2) * outputStrideBytes, outputStrideBytes, rows.data(), rowSizeBytes, width, 4);
+		}
+	}
+
+	extern "C" void Unpack8to8BitDraft(uint8_t* pOut, uint32_t outputStrideBytes, const uint8_t* p8Bit, uint32_t width, uint32_t height)
+	{
+		BinBayerDraft<uint8_t>(pOut, outputStrideBytes, p8Bit, width, width, height);
+	}
+
+	extern "C" void Unpack10to16BitDraft(uint8_t* pOut, uint32_t outputStrideBytes, const uint8_t* p10BitPacked, uint32_t width, uint32_t height)
+	{
+		UnpackDraft<uint16_t>(pOut, outputStrideBytes, p10BitPacked, width, height, 10, Unpack10to16Bit);
+	}
+
+	extern "C" void Unpack12to16BitDraft(uint8_t* pOut, uint32_t outputStrideBytes, const uint8_t* p12BitPacked, uint32_t width, uint32_t height)
+	{
+		UnpackDraft<uint16_t>(pOut, outputStrideBytes, p12BitPacked, width, height, 12, Unpack12to16Bit);
+	}
+
+	extern "C" void Unpack14to16BitDraft(uint8_t* pOut, uint32_t outputStrideBytes, const uint8_t* p14BitPacked, uint32_t width, uint32_t height)
+	{
+		UnpackDraft<uint16_t>(pOut, outputStrideBytes, p14BitPacked, width, height, 14, Unpack14to16Bit);
+	}
+
+	extern "C" void Unpack16to16BitDraft(uint8_t* pOut, uint32_t outputStrideBytes, const uint8_t* p16Bit, uint32_t width, uint32_t height)
+	{
+		BinBayerDraft<uint16_t>(pOut, outputStrideBytes, p16Bit, width * sizeof(uint16_t), width, height);
+	}
 }
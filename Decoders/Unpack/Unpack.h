@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../Api.h"
+#include "../RawStatistics.h"
 
 #include <stdint.h>
 #include <cstddef>
@@ -12,5 +13,26 @@ DECODER_EXPORT_BEGIN
     DECODER_EXPORT uint32_t Unpack12InputOffsetBytes();
     DECODER_EXPORT void Unpack12to16Bit(uint8_t* pOut, const uint8_t* p12BitPacked, uint32_t sizeBytes);
     DECODER_EXPORT void Unpack14to16Bit(uint8_t* pOut, const uint8_t* p14BitPacked, uint32_t sizeBytes);
+
+    // As the above, adding the samples to pStatistics as they are unpacked. The samples are those of a width wide frame,
+    // the first being sample firstSample of the frame counting row by row.
+    DECODER_EXPORT void Unpack10to16BitStatistics(uint8_t* pOut, const uint8_t* p10BitPacked, uint32_t sizeBytes, uint32_t width, uint64_t firstSample,
+        sRawStatistics* pStatistics);
+    DECODER_EXPORT void Unpack12to16BitStatistics(uint8_t* pOut, const uint8_t* p12BitPacked, uint32_t sizeBytes, uint32_t width, uint64_t firstSample,
+        sRawStatistics* pStatistics);
+    DECODER_EXPORT void Unpack14to16BitStatistics(uint8_t* pOut, const uint8_t* p14BitPacked, uint32_t sizeBytes, uint32_t width, uint64_t firstSample,
+        sRawStatistics* pStatistics);
+
+    // Statistics of samples that need no unpacking, straight after they are read
+    DECODER_EXPORT void RawStatistics8Bit(const uint8_t* p8Bit, uint32_t sizeBytes, uint32_t width, uint64_t firstSample, sRawStatistics* pStatistics);
+    DECODER_EXPORT void RawStatistics16Bit(const uint8_t* p16Bit, uint32_t sizeBytes, uint32_t width, uint64_t firstSample, sRawStatistics* pStatistics);
+
+    // Draft unpacking of a width x height Bayer image, each 4x4 block is binned to one 2x2 CFA quad
+    // of the half width, half height output
+    DECODER_EXPORT void Unpack8to8BitDraft(uint8_t* pOut, uint32_t outputStrideBytes, const uint8_t* p8Bit, uint32_t width, uint32_t height);
+    DECODER_EXPORT void Unpack10to16BitDraft(uint8_t* pOut, uint32_t outputStrideBytes, const uint8_t* p10BitPacked, uint32_t width, uint32_t height);
+    DECODER_EXPORT void Unpack12to16BitDraft(uint8_t* pOut, uint32_t outputStrideBytes, const uint8_t* p12BitPacked, uint32_t width, uint32_t height);
+    DECODER_EXPORT void Unpack14to16BitDraft(uint8_t* pOut, uint32_t outputStrideBytes, const uint8_t* p14BitPacked, uint32_t width, uint32_t height);
+    DECODER_EXPORT void Unpack16to16BitDraft(uint8_t* pOut, uint32_t outputStrideBytes, const uint8_t* p16Bit, uint32_t width, uint32_t height);
 DECODER_EXPORT_END
 }
@@ -46,7 +46,7 @@ namespace Octopus.Player.GPU.OpenCL.Compute
             Debug.CheckError(Context.Handle.Flush(NativeHandle));
         }
 
-        public void ModifyImage(IImage2D image, Vector2i origin, Vector2i size, byte[] imageData, uint imageDataOffset = 0)
+        public void ModifyImage(IImage2D image, Vector2i origin, Vector2i size, byte[] imageData, uint imageDataOffset = 0, uint imageDataRowPitchBytes = 0)
         {
             var imageCL = (Image2D)image;
             if (imageCL == null)
@@ -61,7 +61,7 @@ namespace Octopus.Player.GPU.OpenCL.Compute
                 {
                     fixed (byte* pImageData = imageData)
                     {
-                        Debug.CheckError(Context.Handle.EnqueueWriteImage(NativeHandle, imageCL.NativeHandle, true, pOrigin, pSize, 0, 0, pImageData + imageDataOffset, 0, null, null));
+                        Debug.CheckError(Context.Handle.EnqueueWriteImage(NativeHandle, imageCL.NativeHandle, true, pOrigin, pSize, imageDataRowPitchBytes, 0, pImageData + imageDataOffset, 0, null, null));
                     }
                 }
             }